@@ -1,2 +1,4 @@
 glslc shaders/simple_shader.vert -o shaders/simple_shader.vert.spv
-glslc shaders/simple_shader.frag -o shaders/simple_shader.frag.spv
\ No newline at end of file
+glslc shaders/simple_shader.frag -o shaders/simple_shader.frag.spv
+glslc shaders/hiz_reduce.comp -o shaders/hiz_reduce.comp.spv
+glslc shaders/occlusion_cull.comp -o shaders/occlusion_cull.comp.spv
\ No newline at end of file
@@ -1,18 +1,45 @@
 #version 450
 
+// Shader options, see SimpleRenderSystem::ShaderOption. The untaken paths
+// are folded away when the pipeline is compiled.
+layout(constant_id = 0) const bool OBJECT_COLOR = false;
+layout(constant_id = 1) const bool LIGHTING = false;
+
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
 
 layout(location = 0) out vec3 fragColor;
 
-layout(push_constant) uniform Push {
-    mat4 transform;
-    vec3 color;
-} push;
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionView;
+} ubo;
+
+struct ObjectData {
+    mat4 modelMatrix;
+    mat3 normalMatrix;
+    vec4 color;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
+const float AMBIENT = 0.02;
 
 void main() {
-    // gl_Position = vec4(push.transform * position + push.offset, 0.0, 1.0);
-    gl_Position = push.transform * vec4(position, 1.f);
+    // firstInstance of each draw selects the object's slot
+    ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+    gl_Position = ubo.projectionView * object.modelMatrix * vec4(position, 1.0);
 
-    fragColor = color;
-}
\ No newline at end of file
+    fragColor = OBJECT_COLOR ? object.color.rgb : color;
+    if (LIGHTING) {
+        // inverse transpose of the model matrix, exact for non-uniform
+        // scaling as well
+        vec3 normalWorldSpace = normalize(object.normalMatrix * normal);
+        float lightIntensity =
+            AMBIENT + max(dot(normalWorldSpace, DIRECTION_TO_LIGHT), 0.0);
+        fragColor *= lightIntensity;
+    }
+}
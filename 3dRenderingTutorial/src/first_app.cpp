@@ -3,10 +3,17 @@
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <iostream>
 #include <stdexcept>
 
 #include "keyboard_movement_controller.hpp"
+#include "lve_async_compute.hpp"
+#include "lve_buffer.hpp"
 #include "lve_camera.hpp"
+#include "lve_cpu_profiler.hpp"
+#include "lve_frame_info.hpp"
+#include "lve_occlusion_culler.hpp"
+#include "lve_shader_library.hpp"
 #include "simple_render_system.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -16,13 +23,95 @@
 
 namespace lve {
 
-FirstApp::FirstApp() { loadGameObjects(); }
+FirstApp::FirstApp(const Options& options) : options{options} {
+    lveDevice.shaderLibrary().setCompiler(&shaderCompiler);
+    shaderCompiler.startWatching();
+    globalPool =
+        LveDescriptorPool::Builder(lveDevice)
+            .setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                         LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                         LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+    loadGameObjects();
+}
 
 FirstApp::~FirstApp() {}
 
 void FirstApp::run() {
-    SimpleRenderSystem simpleRenderSystem{lveDevice,
-                                          lveRenderer.getSwapChainRenderPass()};
+    std::vector<std::unique_ptr<LveBuffer>> uboBuffers(
+        LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (auto& uboBuffer : uboBuffers) {
+        uboBuffer = std::make_unique<LveBuffer>(
+            lveDevice,
+            sizeof(GlobalUbo),
+            1,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+            lveDevice.properties.limits.minUniformBufferOffsetAlignment);
+        uboBuffer->map();
+    }
+
+    std::vector<std::unique_ptr<LveBuffer>> objectBuffers(
+        LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (auto& objectBuffer : objectBuffers) {
+        objectBuffer =
+            std::make_unique<LveBuffer>(lveDevice,
+                                        sizeof(ObjectData),
+                                        MAX_OBJECTS,
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        objectBuffer->map();
+    }
+
+    auto globalSetLayout =
+        LveDescriptorSetLayout::Builder(lveDevice)
+            .addBinding(0,
+                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                        VK_SHADER_STAGE_VERTEX_BIT)
+            .addBinding(1,
+                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+    std::vector<VkDescriptorSet> globalDescriptorSets(
+        LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < globalDescriptorSets.size(); i++) {
+        auto uboInfo = uboBuffers[i]->descriptorInfo();
+        auto objectInfo = objectBuffers[i]->descriptorInfo();
+        LveDescriptorWriter(*globalSetLayout, *globalPool)
+            .writeBuffer(0, &uboInfo)
+            .writeBuffer(1, &objectInfo)
+            .build(globalDescriptorSets[i]);
+    }
+
+    SimpleRenderSystem simpleRenderSystem{
+        lveDevice,
+        pipelineRegistry,
+        lveRenderer.getSwapChainRenderTarget(),
+        globalSetLayout->getDescriptorSetLayout()};
+    std::cout << "rendering with "
+              << (lveRenderer.usesDynamicRendering() ? "dynamic rendering"
+                                                     : "render passes")
+              << std::endl;
+    std::cout << "pipeline registry: " << pipelineRegistry.getStats().hits
+              << " hits, " << pipelineRegistry.getStats().misses
+              << " misses, " << pipelineRegistry.size() << " pipelines on "
+              << pipelineRegistry.getCompiler().getWorkerCount()
+              << " compiler threads" << std::endl;
+    auto shaderStats = lveDevice.shaderLibrary().getStats();
+    std::cout << "shader library: " << shaderStats.filesLoaded
+              << " files loaded, " << shaderStats.modulesCreated
+              << " modules created, " << shaderStats.modulesShared
+              << " shared" << std::endl;
+    auto compilerStats = shaderCompiler.getStats();
+    std::cout << "shader compiler: "
+              << (LveShaderCompiler::isRuntimeCompilationAvailable()
+                      ? "runtime GLSL, "
+                      : "offline SPIR-V, ")
+              << compilerStats.compiled << " compiled, "
+              << compilerStats.cacheHits << " cache hits" << std::endl;
     LveCamera camera{};
     camera.setViewTarget(glm::vec3{-1.f, -2.f, 2.f}, glm::vec3{0.f, 0.f, 2.5f});
 
@@ -31,8 +120,41 @@ void FirstApp::run() {
 
     auto currentTime = std::chrono::high_resolution_clock::now();
 
-    while (!lveWindow.shouldClose()) {
-        glfwPollEvents();
+    // the early occlusion cull runs on the compute queue
+    LveAsyncCompute asyncCompute{lveDevice, lveRenderer};
+    std::cout << "async compute: "
+              << (asyncCompute.isAsync() ? "separate compute queue"
+                                         : "serialized on the graphics queue")
+              << std::endl;
+    LveOcclusionCuller occlusionCuller{lveDevice, MAX_OBJECTS, &asyncCompute};
+
+    if (options.occluderTest) {
+        occlusionCulling = true;
+        lveRenderer.setDepthUsage(DepthUsage::STORED);
+    }
+    FrameStatsReporter reporter{
+        lveDevice, lveRenderer, pipelineRegistry, REPORT_INTERVAL};
+
+    if (lveRenderer.supportsResolutionScaling()) {
+        lveRenderer.setResolutionScaling(RESOLUTION_SCALING);
+    } else {
+        std::cout << "resolution scaling: not supported by the device\n";
+    }
+
+    if (LveCpuProfiler::isEnabled()) LveCpuProfiler::setThreadName("main");
+    uint32_t renderedFrames = 0;
+    while (!lveWindow.shouldClose() &&
+           (options.frameLimit == 0 || renderedFrames < options.frameLimit)) {
+        LVE_CPU_ZONE("frame");
+        // nothing is rendered while minimized, so sleep until an event
+        LVE_CPU_ZONE_NAMED(inputZone, "poll input");
+        auto windowExtent = lveWindow.getExtent();
+        if (windowExtent.width == 0 || windowExtent.height == 0) {
+            glfwWaitEvents();
+        } else {
+            glfwPollEvents();
+        }
+        LVE_CPU_ZONE_END(inputZone);
 
         auto newTime = std::chrono::high_resolution_clock::now();
 
@@ -45,10 +167,23 @@ void FirstApp::run() {
 
         currentTime = newTime;
 
+        // frame boundary: nothing is being recorded, earlier frames may
+        // still be executing and keep their pipelines alive
+        auto changedShaders = shaderCompiler.takeChangedShaders();
+        if (!changedShaders.empty()) {
+            for (auto& path : changedShaders) {
+                lveDevice.shaderLibrary().invalidate(path);
+            }
+            simpleRenderSystem.reloadShaders(changedShaders);
+        }
+
+        handleInput(simpleRenderSystem, reporter);
+
+        LVE_CPU_ZONE_NAMED(cameraZone, "update camera");
         cameraController.moveInPlaneXZ(
             lveWindow.getGLFWwindow(), frameTime, viewerObject);
-        camera.setViewYXZ(viewerObject.transform.translation,
-                          viewerObject.transform.rotation);
+        camera.setViewYXZ(viewerObject.transform.getTranslation(),
+                          viewerObject.transform.getRotation());
 
         float aspectRatio = lveRenderer.getAspectRatio();
         // camera.setOrthographicProjection(
@@ -56,30 +191,331 @@ void FirstApp::run() {
 
         camera.setPerspectiveProjection(
             glm::radians(50.f), aspectRatio, 0.1f, 10.f);
+        LVE_CPU_ZONE_END(cameraZone);
 
         if (auto commandBuffer = lveRenderer.beginFrame()) {
-            lveRenderer.beginSwapChainRenderPass(commandBuffer);
-            simpleRenderSystem.renderGameObjects(
-                commandBuffer, gameObjects, camera);
-            lveRenderer.endSwapChainRenderPass(commandBuffer);
+            int frameIndex = lveRenderer.getFrameIndex();
+            FrameInfo frameInfo{frameIndex,
+                                frameTime,
+                                commandBuffer,
+                                camera,
+                                globalDescriptorSets[frameIndex],
+                                *objectBuffers[frameIndex]};
+
+            // update
+            GlobalUbo ubo{};
+            ubo.projectionView =
+                camera.getProjectionMatrix() * camera.getViewMatrix();
+            uboBuffers[frameIndex]->writeToBuffer(&ubo);
+            uboBuffers[frameIndex]->flush();
+
+            // render
+            auto recordStart = std::chrono::high_resolution_clock::now();
+            LVE_CPU_ZONE_NAMED(recordZone, "record");
+            renderScene(
+                frameInfo, simpleRenderSystem, occlusionCuller, asyncCompute);
+            float recordMilliseconds =
+                std::chrono::duration<float, std::chrono::milliseconds::period>(
+                    std::chrono::high_resolution_clock::now() - recordStart)
+                    .count();
+            LVE_CPU_ZONE_END(recordZone);
             lveRenderer.endFrame();
+            renderedFrames++;
+            reporter.addRenderedFrame(
+                recordMilliseconds,
+                simpleRenderSystem.getCullingStats(),
+                occlusionCulling ? &occlusionCuller.getStats() : nullptr);
         }
+
+        reporter.endFrame(
+            frameTime,
+            std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - newTime)
+                .count(),
+            {occlusionCulling,
+             replayRecordedScene,
+             simpleRenderSystem.isUsingFallbackPipeline()});
     }
 
     vkDeviceWaitIdle(lveDevice.device());
+
+    if (options.occluderTest) {
+        // read back framesInFlight frames late, so a run needs a few more
+        // frames than that
+        auto& stats = occlusionCuller.getStats();
+        const uint32_t vases = OCCLUDER_TEST_GRID * OCCLUDER_TEST_GRID;
+        std::cout << "occluder test: " << stats.occluded << " of " << vases
+                  << " vases occluded (" << stats.tested << " tested, "
+                  << stats.earlyVisible << " drawn early, "
+                  << stats.disoccluded << " disoccluded)" << std::endl;
+        if (!occlusionCulling || stats.occluded != vases) {
+            throw std::runtime_error(
+                "occluder test failed: not every vase was reported occluded");
+        }
+    }
+
+    if (!options.tracePath.empty()) {
+        size_t zones = LveCpuProfiler::exportChromeTrace(options.tracePath);
+        std::cout << "trace: " << zones << " zones written to "
+                  << options.tracePath
+                  << (LveCpuProfiler::isEnabled()
+                          ? "\n"
+                          : " (built without LVE_CPU_PROFILING)\n");
+    }
+}
+
+bool FirstApp::wasKeyPressed(int key) {
+    bool down = glfwGetKey(lveWindow.getGLFWwindow(), key) == GLFW_PRESS;
+    bool pressed = down && !keysWereDown[key];
+    keysWereDown[key] = down;
+    return pressed;
+}
+
+// R toggles between recording the scene every frame and replaying secondary
+// command buffers recorded once, O toggles two-phase occlusion culling
+// (which always records), C toggles back-face culling, V and L toggle the
+// object color and lighting shader options. F and P cycle the frames in
+// flight and the present mode policy, G toggles dynamic resolution scaling.
+void FirstApp::handleInput(SimpleRenderSystem& simpleRenderSystem,
+                           FrameStatsReporter& reporter) {
+    if (wasKeyPressed(TOGGLE_RECORDING_KEY)) {
+        replayRecordedScene = !replayRecordedScene;
+        reporter.reset();
+    }
+    if (wasKeyPressed(TOGGLE_OCCLUSION_KEY)) {
+        occlusionCulling = !occlusionCulling;
+        // the Hi-Z pyramid is built from the depth of the early pass
+        lveRenderer.setDepthUsage(occlusionCulling ? DepthUsage::STORED
+                                                   : DepthUsage::TRANSIENT);
+        reporter.reset();
+    }
+    if (wasKeyPressed(TOGGLE_BACKFACE_CULLING_KEY)) {
+        simpleRenderSystem.setBackFaceCulling(
+            !simpleRenderSystem.isBackFaceCulling());
+    }
+    if (wasKeyPressed(TOGGLE_OBJECT_COLOR_KEY)) {
+        simpleRenderSystem.setShaderOptions(
+            simpleRenderSystem.getShaderOptions() ^
+            SimpleRenderSystem::SHADER_OPTION_OBJECT_COLOR);
+    }
+    if (wasKeyPressed(TOGGLE_LIGHTING_KEY)) {
+        simpleRenderSystem.setShaderOptions(
+            simpleRenderSystem.getShaderOptions() ^
+            SimpleRenderSystem::SHADER_OPTION_LIGHTING);
+    }
+
+    if (wasKeyPressed(CYCLE_FRAMES_IN_FLIGHT_KEY)) {
+        FramePacing pacing = lveRenderer.getFramePacing();
+        pacing.framesInFlight =
+            pacing.framesInFlight % LveSwapChain::MAX_FRAMES_IN_FLIGHT + 1;
+        lveRenderer.setFramePacing(pacing);
+        reporter.reset();
+    }
+    if (wasKeyPressed(CYCLE_PRESENT_MODE_KEY)) {
+        FramePacing pacing = lveRenderer.getFramePacing();
+        pacing.presentModePolicy = static_cast<PresentModePolicy>(
+            (static_cast<int>(pacing.presentModePolicy) + 1) %
+            (static_cast<int>(PresentModePolicy::POWER_SAVING) + 1));
+        lveRenderer.setFramePacing(pacing);
+        reporter.reset();
+    }
+    if (wasKeyPressed(TOGGLE_RESOLUTION_SCALING_KEY) &&
+        lveRenderer.supportsResolutionScaling()) {
+        ResolutionScaling scaling = lveRenderer.getResolutionScaling();
+        scaling.enabled = !scaling.enabled;
+        lveRenderer.setResolutionScaling(scaling);
+        reporter.reset();
+    }
+}
+
+void FirstApp::renderScene(FrameInfo& frameInfo,
+                           SimpleRenderSystem& simpleRenderSystem,
+                           LveOcclusionCuller& occlusionCuller,
+                           LveAsyncCompute& asyncCompute) {
+    int frameIndex = frameInfo.frameIndex;
+    VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+    if (occlusionCulling) {
+        // sized for the swapchain, a resolution scale step only reduces a
+        // smaller region of the same pyramid
+        occlusionCuller.beginFrame(frameIndex,
+                                   lveRenderer.getSwapChainExtent(),
+                                   lveRenderer.getRenderExtent());
+    }
+    if (lveRenderer.supportsFrameGraph()) {
+        // the passes below with their barriers and attachment transitions
+        // derived from what each pass uses
+        auto& graph = lveRenderer.getFrameGraph();
+        auto color = graph.getResource(LveRenderer::FRAME_COLOR);
+        auto depth = graph.getResource(LveRenderer::FRAME_DEPTH);
+        VkExtent2D renderExtent = lveRenderer.getRenderExtent();
+        if (occlusionCulling) {
+            graph.addPass("early cull")
+                .sideEffects()
+                .execute([&](VkCommandBuffer) {
+                    asyncCompute.begin();
+                    simpleRenderSystem.prepareOcclusionCulling(
+                        frameInfo, gameObjects, occlusionCuller);
+                    asyncCompute.submit();
+                });
+            graph.addPass("early geometry")
+                .renderArea(renderExtent)
+                .color(color,
+                       VK_ATTACHMENT_LOAD_OP_CLEAR,
+                       LveRenderer::CLEAR_COLOR)
+                .depth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR)
+                .execute([&](VkCommandBuffer) {
+                    simpleRenderSystem.renderOcclusionCulled(
+                        frameInfo,
+                        gameObjects,
+                        occlusionCuller.getEarlyDrawBuffer());
+                });
+            graph.addPass("late cull")
+                .read(depth, LveRenderGraph::Usage::SAMPLED_COMPUTE)
+                .sideEffects()
+                .execute([&](VkCommandBuffer passCommandBuffer) {
+                    occlusionCuller.cullLate(
+                        passCommandBuffer,
+                        graph.getImage(depth),
+                        graph.getImageView(depth),
+                        lveRenderer.getSwapChainDepthFormat(),
+                        false);
+                });
+            graph.addPass("late geometry")
+                .renderArea(renderExtent)
+                .color(color, VK_ATTACHMENT_LOAD_OP_LOAD)
+                .depth(depth, VK_ATTACHMENT_LOAD_OP_LOAD)
+                .execute([&](VkCommandBuffer) {
+                    simpleRenderSystem.renderOcclusionCulled(
+                        frameInfo,
+                        gameObjects,
+                        occlusionCuller.getLateDrawBuffer());
+                });
+            graph.addPass("cull handoff")
+                .sideEffects()
+                .execute([&](VkCommandBuffer passCommandBuffer) {
+                    occlusionCuller.endFrame(passCommandBuffer);
+                });
+        } else {
+            auto scene =
+                graph.addPass("scene")
+                    .renderArea(renderExtent)
+                    .color(color,
+                           VK_ATTACHMENT_LOAD_OP_CLEAR,
+                           LveRenderer::CLEAR_COLOR)
+                    .depth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+            if (replayRecordedScene) {
+                scene.secondaryCommandBuffers().execute([&](VkCommandBuffer) {
+                    simpleRenderSystem.renderGameObjectsRecorded(
+                        frameInfo, gameObjects, VK_NULL_HANDLE, renderExtent);
+                });
+            } else {
+                scene.execute([&](VkCommandBuffer) {
+                    simpleRenderSystem.renderGameObjects(frameInfo,
+                                                         gameObjects);
+                });
+            }
+        }
+        lveRenderer.executeFrameGraph(commandBuffer);
+    } else if (occlusionCulling) {
+        // timed under the names of the frame graph passes
+        auto& profiler = lveRenderer.getGpuProfiler();
+        asyncCompute.begin();
+        simpleRenderSystem.prepareOcclusionCulling(
+            frameInfo, gameObjects, occlusionCuller);
+        asyncCompute.submit();
+        {
+            LveGpuProfiler::Scope scope{
+                profiler, commandBuffer, "early geometry"};
+            lveRenderer.beginSwapChainRenderPass(commandBuffer);
+            simpleRenderSystem.renderOcclusionCulled(
+                frameInfo,
+                gameObjects,
+                occlusionCuller.getEarlyDrawBuffer());
+            lveRenderer.endSwapChainRenderPass(commandBuffer);
+        }
+        {
+            LveGpuProfiler::Scope scope{profiler, commandBuffer, "late cull"};
+            occlusionCuller.cullLate(
+                commandBuffer,
+                lveRenderer.getCurrentDepthImage(),
+                lveRenderer.getCurrentDepthImageView(),
+                lveRenderer.getSwapChainDepthFormat());
+        }
+        {
+            LveGpuProfiler::Scope scope{
+                profiler, commandBuffer, "late geometry"};
+            lveRenderer.resumeSwapChainRenderPass(commandBuffer);
+            simpleRenderSystem.renderOcclusionCulled(
+                frameInfo,
+                gameObjects,
+                occlusionCuller.getLateDrawBuffer());
+            lveRenderer.endSwapChainRenderPass(commandBuffer);
+        }
+        occlusionCuller.endFrame(commandBuffer);
+    } else if (replayRecordedScene) {
+        LveGpuProfiler::Scope scope{
+            lveRenderer.getGpuProfiler(), commandBuffer, "scene"};
+        lveRenderer.beginSwapChainRenderPass(
+            commandBuffer,
+            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        simpleRenderSystem.renderGameObjectsRecorded(
+            frameInfo,
+            gameObjects,
+            lveRenderer.getSwapChainRenderPass(),
+            lveRenderer.getRenderExtent());
+        lveRenderer.endSwapChainRenderPass(commandBuffer);
+    } else {
+        LveGpuProfiler::Scope scope{
+            lveRenderer.getGpuProfiler(), commandBuffer, "scene"};
+        lveRenderer.beginSwapChainRenderPass(commandBuffer);
+        simpleRenderSystem.renderGameObjects(frameInfo, gameObjects);
+        lveRenderer.endSwapChainRenderPass(commandBuffer);
+    }
 }
 
 void FirstApp::loadGameObjects() {
+    if (options.occluderTest) {
+        loadOccluderTestScene();
+        return;
+    }
+
     std::shared_ptr<LveModel> lveModel =
         LveModel::createModelFromFile(lveDevice, "models/smooth_vase.obj");
 
     auto gameObj = LveGameObject::createGameObject();
     gameObj.model = lveModel;
-    gameObj.transform.translation = {0.f, 0.f, 2.5f};
-    gameObj.transform.scale = glm::vec3{3.f};
+    gameObj.color = {0.8f, 0.5f, 0.2f};
+    gameObj.transform.setTranslation({0.f, 0.f, 2.5f});
+    gameObj.transform.setScale(glm::vec3{3.f});
     gameObjects.push_back(std::move(gameObj));
 }
 
+void FirstApp::loadOccluderTestScene() {
+    // A wall filling the view from the start position, with a grid of vases
+    // behind it that should all be occluded.
+    std::shared_ptr<LveModel> cubeModel =
+        LveModel::createModelFromFile(lveDevice, "models/cube.obj");
+    auto wall = LveGameObject::createGameObject();
+    wall.model = cubeModel;
+    wall.color = {0.5f, 0.5f, 0.5f};
+    wall.transform.setTranslation({0.f, 0.f, 1.5f});
+    wall.transform.setScale({3.f, 3.f, 0.05f});
+    gameObjects.push_back(std::move(wall));
+
+    std::shared_ptr<LveModel> vaseModel =
+        LveModel::createModelFromFile(lveDevice, "models/smooth_vase.obj");
+    for (uint32_t x = 0; x < OCCLUDER_TEST_GRID; x++) {
+        for (uint32_t z = 0; z < OCCLUDER_TEST_GRID; z++) {
+            auto vase = LveGameObject::createGameObject();
+            vase.model = vaseModel;
+            vase.transform.setTranslation(
+                {-0.9f + 0.2f * x, 0.3f, 3.f + 0.4f * z});
+            vase.transform.setScale(glm::vec3{0.5f});
+            gameObjects.push_back(std::move(vase));
+        }
+    }
+}
+
 void FirstApp::sierpinski(std::vector<LveModel::Vertex>& vertices,
                           int depth,
                           LveModel::Vertex left,
@@ -1,12 +1,22 @@
 #pragma once
 
+#include <array>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "frame_stats_reporter.hpp"
+#include "lve_async_compute.hpp"
+#include "lve_descriptors.hpp"
 #include "lve_device.hpp"
+#include "lve_frame_info.hpp"
 #include "lve_game_object.hpp"
+#include "lve_occlusion_culler.hpp"
+#include "lve_pipeline_registry.hpp"
 #include "lve_renderer.hpp"
+#include "lve_shader_compiler.hpp"
 #include "lve_window.hpp"
+#include "simple_render_system.hpp"
 
 namespace lve {
 class FirstApp {
@@ -14,8 +24,50 @@ class FirstApp {
     static constexpr int WIDTH = 800;
     static constexpr int HEIGHT = 600;
     static constexpr float MAX_FRAME_TIME = 0.10;
+    static constexpr uint32_t MAX_OBJECTS = 1000;
+    static constexpr int TOGGLE_RECORDING_KEY = GLFW_KEY_R;
+    static constexpr int TOGGLE_OCCLUSION_KEY = GLFW_KEY_O;
+    static constexpr int TOGGLE_BACKFACE_CULLING_KEY = GLFW_KEY_C;
+    static constexpr int TOGGLE_OBJECT_COLOR_KEY = GLFW_KEY_V;
+    static constexpr int TOGGLE_LIGHTING_KEY = GLFW_KEY_L;
+    static constexpr int CYCLE_FRAMES_IN_FLIGHT_KEY = GLFW_KEY_F;
+    static constexpr int CYCLE_PRESENT_MODE_KEY = GLFW_KEY_P;
+    static constexpr int TOGGLE_RESOLUTION_SCALING_KEY = GLFW_KEY_G;
+    // Vases of the occluder test scene, in a square grid behind the wall
+    static constexpr uint32_t OCCLUDER_TEST_GRID = 10;
+    // Renders with VK_KHR_dynamic_rendering when the device supports it,
+    // otherwise falls back to the swapchain render passes.
+    static constexpr bool PREFER_DYNAMIC_RENDERING = true;
+    // Startup frame pacing; F and P cycle through the alternatives
+    static constexpr int FRAMES_IN_FLIGHT = 2;
+    static constexpr PresentModePolicy PRESENT_MODE_POLICY =
+        PresentModePolicy::MAX_THROUGHPUT;
+    // Lowers the render resolution while GPU frames take longer than the
+    // target instead of dropping frames, when the device supports it
+    static constexpr ResolutionScaling RESOLUTION_SCALING{
+        true, 0.5f, 1.f, 1000.f / 60.f};
+    // seconds between CPU frame time reports
+    static constexpr float REPORT_INTERVAL = 2.f;
 
-    FirstApp();
+    // Settings from the command line, see main.cpp
+    struct Options {
+        // Renders without a display, see LveWindow; for batch jobs such as
+        // benchmarks, usually together with frameLimit
+        bool headless = false;
+        // Frames to render before run returns, 0 renders until the window
+        // is closed
+        uint32_t frameLimit = 0;
+        // Chrome trace of the last frames' CPU zones and GPU scopes,
+        // written when run returns; empty for none
+        std::string tracePath;
+        // Replaces the scene with a wall hiding a grid of vases and starts
+        // with occlusion culling on, e.g. to check the occlusion counters
+        // on lavapipe. run throws unless the last culled frame reported
+        // every vase occluded.
+        bool occluderTest = false;
+    };
+
+    explicit FirstApp(const Options& options);
     ~FirstApp();
     FirstApp(const FirstApp&) = delete;
     FirstApp& operator=(const FirstApp&) = delete;
@@ -23,7 +75,19 @@ class FirstApp {
     void run();
 
    private:
+    // Whether key went down since the last call for it
+    bool wasKeyPressed(int key);
+    // Applies the toggle keys, see first_app.cpp
+    void handleInput(SimpleRenderSystem& simpleRenderSystem,
+                     FrameStatsReporter& reporter);
+    // Records the frame's passes into frameInfo.commandBuffer, as the
+    // toggles select
+    void renderScene(FrameInfo& frameInfo,
+                     SimpleRenderSystem& simpleRenderSystem,
+                     LveOcclusionCuller& occlusionCuller,
+                     LveAsyncCompute& asyncCompute);
     void loadGameObjects();
+    void loadOccluderTestScene();
     void sierpinski(std::vector<LveModel::Vertex>& vertices,
                     int depth,
                     LveModel::Vertex left,
@@ -32,10 +96,23 @@ class FirstApp {
     std::unique_ptr<LveModel> createCubeModel(LveDevice& device,
                                               glm::vec3 offset);
 
-    LveWindow lveWindow{WIDTH, HEIGHT, "Hello Vulkan!"};
+    Options options;
+    // before lveDevice, whose shader library uses it until destroyed
+    LveShaderCompiler shaderCompiler{};
+    LveWindow lveWindow{WIDTH, HEIGHT, "Hello Vulkan!", options.headless};
     LveDevice lveDevice{lveWindow};
-    LveRenderer lveRenderer{lveWindow, lveDevice};
+    LveRenderer lveRenderer{lveWindow,
+                            lveDevice,
+                            PREFER_DYNAMIC_RENDERING,
+                            {FRAMES_IN_FLIGHT, PRESENT_MODE_POLICY}};
+    LvePipelineRegistry pipelineRegistry{lveDevice};
 
+    std::unique_ptr<LveDescriptorPool> globalPool{};
     std::vector<LveGameObject> gameObjects;
+
+    // toggled by handleInput
+    bool replayRecordedScene = false;
+    bool occlusionCulling = false;
+    std::array<bool, GLFW_KEY_LAST + 1> keysWereDown{};
 };
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "frame_stats_reporter.hpp"
+
+#include <iostream>
+
+namespace lve {
+
+FrameStatsReporter::FrameStatsReporter(LveDevice& device,
+                                       LveRenderer& renderer,
+                                       LvePipelineRegistry& pipelineRegistry,
+                                       float interval)
+    : lveDevice{device},
+      lveRenderer{renderer},
+      pipelineRegistry{pipelineRegistry},
+      interval{interval} {}
+
+void FrameStatsReporter::addRenderedFrame(
+    float recordMilliseconds,
+    const SimpleRenderSystem::CullingStats& culling,
+    const LveOcclusionCuller::Stats* occlusionStats) {
+    recordTimeTotal += recordMilliseconds;
+    visibleTotal += culling.visible;
+    culledTotal += culling.culled;
+    if (occlusionStats != nullptr) {
+        occludedTotal += occlusionStats->occluded;
+        disoccludedTotal += occlusionStats->disoccluded;
+    }
+
+    auto& frameStats = lveRenderer.getFrameStats();
+    countersTotal += frameStats.counters;
+    countedFrames++;
+    if (frameStats.pipelineStatistics) {
+        pipelineStatisticsTotal += *frameStats.pipelineStatistics;
+        pipelineStatisticsFrames++;
+    }
+}
+
+void FrameStatsReporter::endFrame(float frameTime,
+                                  float cpuMilliseconds,
+                                  const Mode& mode) {
+    frameTimeTotal += cpuMilliseconds;
+    if (!pipelineCreationReported &&
+        pipelineRegistry.getCompiler().getPendingCount() == 0) {
+        auto creation = lveDevice.getPipelineCreationStats();
+        std::cout << "pipeline creation: " << creation.pipelines
+                  << " pipelines in " << creation.totalMilliseconds
+                  << " ms (max " << creation.maxMilliseconds << " ms), "
+                  << (lveDevice.isPipelineCacheWarm() ? "warm" : "cold")
+                  << " cache" << std::endl;
+        pipelineCreationReported = true;
+    }
+    reportFrames++;
+    reportTimer += frameTime;
+    if (reportTimer >= interval) {
+        printReport(mode);
+        reset();
+    }
+}
+
+void FrameStatsReporter::reset() {
+    reportTimer = recordTimeTotal = frameTimeTotal = 0.f;
+    reportFrames = 0;
+    visibleTotal = culledTotal = occludedTotal = disoccludedTotal = 0;
+    countersTotal = {};
+    countedFrames = 0;
+    pipelineStatisticsTotal = {};
+    pipelineStatisticsFrames = 0;
+    lveRenderer.takeLatencyStats();
+    lveRenderer.takeResizeStats();
+    lveRenderer.getGpuProfiler().resetStats();
+}
+
+void FrameStatsReporter::printReport(const Mode& mode) {
+    std::cout << (mode.occlusionCulling ? "occlusion culled"
+                  : mode.replayedScene  ? "replayed"
+                                        : "recorded")
+              << " scene: cpu frame " << frameTimeTotal / reportFrames
+              << " ms, command recording " << recordTimeTotal / reportFrames
+              << " ms, objects " << visibleTotal / reportFrames
+              << " visible / " << culledTotal / reportFrames << " culled";
+    if (mode.occlusionCulling) {
+        // counted on the GPU, framesInFlight frames late
+        std::cout << " / " << occludedTotal / reportFrames << " occluded, "
+                  << disoccludedTotal / reportFrames << " disoccluded";
+    }
+    if (mode.fallbackPipeline) {
+        std::cout << " (fallback pipeline)";
+    }
+    std::cout << "\n";
+
+    auto& pacing = lveRenderer.getFramePacing();
+    auto latency = lveRenderer.takeLatencyStats();
+    std::cout << "frame pacing: " << pacing.framesInFlight
+              << " frames in flight, "
+              << presentModePolicyName(pacing.presentModePolicy) << ": "
+              << reportFrames / reportTimer << " fps, input to GPU completion "
+              << (latency.samples > 0
+                      ? latency.totalMilliseconds / latency.samples
+                      : 0.f)
+              << " ms (max " << latency.maxMilliseconds << " ms)\n";
+    // while dragging the window edge, the frame times above are the resize
+    // responsiveness
+    auto resize = lveRenderer.takeResizeStats();
+    if (resize.recreations > 0) {
+        std::cout << "swapchain: " << resize.recreations << " recreations in "
+                  << resize.totalMilliseconds / resize.recreations
+                  << " ms (max " << resize.maxMilliseconds << " ms), "
+                  << lveRenderer.getRetiredSwapChainCount()
+                  << " retired waiting for their last frames\n";
+    }
+    auto resolution = lveRenderer.getResolutionStats();
+    if (resolution.gpuMilliseconds > 0.f) {
+        auto renderExtent = lveRenderer.getRenderExtent();
+        auto& scaling = lveRenderer.getResolutionScaling();
+        std::cout << "resolution: " << renderExtent.width << "x"
+                  << renderExtent.height << " (scale " << resolution.scale
+                  << ", " << (scaling.enabled ? "dynamic " : "fixed ")
+                  << scaling.minScale << " to " << scaling.maxScale << ", "
+                  << resolution.scaleChanges << " changes), gpu frame "
+                  << resolution.gpuMilliseconds << " ms (target "
+                  << scaling.targetFrameMilliseconds << " ms)\n";
+    }
+    printAttachmentMemory();
+    if (lveRenderer.supportsFrameGraph()) {
+        auto graph = lveRenderer.getFrameGraphStats();
+        std::cout << "render graph: " << graph.passes << " passes, "
+                  << graph.culledPasses << " culled, " << graph.mergedPasses
+                  << " merged, " << graph.imageBarriers << " image and "
+                  << graph.memoryBarriers << " memory barriers";
+        if (graph.transientBytes > 0) {
+            // aliasing places transients with disjoint lifetimes at the
+            // same memory
+            std::cout << ", transients " << graph.transientBytes / 1024
+                      << " KiB in " << graph.allocatedBytes / 1024 << " KiB";
+        }
+        std::cout << "\n";
+    }
+    printGpuStats();
+    printPipelineLibrary();
+}
+
+void FrameStatsReporter::printAttachmentMemory() {
+    auto attachments = lveRenderer.getAttachmentMemory();
+    if (attachments.depthImages == reportedAttachments.depthImages &&
+        attachments.depthBytes == reportedAttachments.depthBytes &&
+        attachments.committedBytes == reportedAttachments.committedBytes &&
+        attachments.sceneColorBytes == reportedAttachments.sceneColorBytes) {
+        return;
+    }
+
+    auto mebibytes = [](VkDeviceSize bytes) {
+        return static_cast<float>(bytes) / (1024.f * 1024.f);
+    };
+    // the depth buffers used to exist once per swapchain image
+    std::cout << "depth attachments: " << attachments.depthImages << " for "
+              << attachments.swapChainImages << " swapchain images, "
+              << mebibytes(attachments.depthBytes) << " MiB instead of "
+              << mebibytes(attachments.depthBytes / attachments.depthImages *
+                           attachments.swapChainImages)
+              << " MiB";
+    if (attachments.sceneColorBytes > 0) {
+        std::cout << ", scene target " << mebibytes(attachments.sceneColorBytes)
+                  << " MiB";
+    }
+    if (attachments.lazilyAllocated) {
+        std::cout << ", lazily allocated, "
+                  << mebibytes(attachments.committedBytes) << " MiB committed";
+    }
+    std::cout << "\n";
+    reportedAttachments = attachments;
+}
+
+void FrameStatsReporter::printGpuStats() {
+    if (countedFrames > 0) {
+        // recorded commands, a replayed scene is counted once
+        std::cout << "counters per frame:";
+        for (int i = 0; i < LveCounters::COUNTER_COUNT; i++) {
+            auto counter = static_cast<LveCounters::Counter>(i);
+            std::cout << (i > 0 ? ", " : " ") << LveCounters::getName(counter)
+                      << " " << countersTotal[counter] / countedFrames;
+        }
+        std::cout << "\n";
+    }
+    if (pipelineStatisticsFrames > 0) {
+        auto perFrame = [&](uint64_t total) {
+            return total / pipelineStatisticsFrames;
+        };
+        auto& total = pipelineStatisticsTotal;
+        std::cout << "pipeline statistics per frame: "
+                  << perFrame(total.inputAssemblyVertices) << " vertices and "
+                  << perFrame(total.inputAssemblyPrimitives)
+                  << " primitives assembled, "
+                  << perFrame(total.vertexShaderInvocations)
+                  << " vertex shader invocations, "
+                  << perFrame(total.clippingInvocations)
+                  << " primitives clipped to "
+                  << perFrame(total.clippingPrimitives) << ", "
+                  << perFrame(total.fragmentShaderInvocations)
+                  << " fragment and "
+                  << perFrame(total.computeShaderInvocations)
+                  << " compute shader invocations\n";
+    }
+    auto& profiler = lveRenderer.getGpuProfiler();
+    if (profiler.isSupported()) {
+        // scopes overlap at their ends, so they need not add up to the frame
+        std::cout << "gpu (avg / p99 / max ms):";
+        for (auto& scope : profiler.getStats()) {
+            if (scope.samples == 0) continue;
+            std::cout << " " << scope.name << " " << scope.averageMilliseconds
+                      << " / " << scope.p99Milliseconds << " / "
+                      << scope.maxMilliseconds << ",";
+        }
+        std::cout << " " << profiler.getDroppedScopes() << " scopes dropped\n";
+    }
+}
+
+void FrameStatsReporter::printPipelineLibrary() {
+    auto library = pipelineRegistry.getLibrary();
+    if (library == nullptr ||
+        library->getStats().optimizedLinks == reportedOptimizedLinks) {
+        return;
+    }
+
+    auto libraryStats = library->getStats();
+    auto average = [](float total, uint32_t count) {
+        return count > 0 ? total / count : 0.f;
+    };
+    std::cout << "pipeline library: " << libraryStats.partsCreated
+              << " parts compiled in "
+              << average(libraryStats.partMilliseconds,
+                         libraryStats.partsCreated)
+              << " ms, " << libraryStats.fastLinks << " fast links in "
+              << average(libraryStats.fastLinkMilliseconds,
+                         libraryStats.fastLinks)
+              << " ms, " << libraryStats.optimizedLinks
+              << " optimized links in "
+              << average(libraryStats.optimizedLinkMilliseconds,
+                         libraryStats.optimizedLinks)
+              << " ms (averages)\n";
+    reportedOptimizedLinks = libraryStats.optimizedLinks;
+}
+
+}  // namespace lve
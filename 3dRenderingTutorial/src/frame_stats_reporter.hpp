@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+#include "lve_counters.hpp"
+#include "lve_device.hpp"
+#include "lve_gpu_profiler.hpp"
+#include "lve_occlusion_culler.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_renderer.hpp"
+#include "lve_swap_chain.hpp"
+#include "simple_render_system.hpp"
+
+namespace lve {
+
+// Prints the frame statistics of FirstApp to stdout: averages over every
+// interval seconds of frames, and reports that change rarely, such as the
+// attachment memory or the pipeline creation times, once they are known.
+class FrameStatsReporter {
+   public:
+    // How the scene was rendered, for the first line of a report
+    struct Mode {
+        bool occlusionCulling = false;
+        bool replayedScene = false;
+        bool fallbackPipeline = false;
+    };
+
+    FrameStatsReporter(LveDevice& device,
+                       LveRenderer& renderer,
+                       LvePipelineRegistry& pipelineRegistry,
+                       float interval);
+
+    FrameStatsReporter(const FrameStatsReporter&) = delete;
+    FrameStatsReporter& operator=(const FrameStatsReporter&) = delete;
+
+    // After LveRenderer::endFrame of a rendered frame. occlusionStats is
+    // nullptr when the frame was not occlusion culled.
+    void addRenderedFrame(float recordMilliseconds,
+                          const SimpleRenderSystem::CullingStats& culling,
+                          const LveOcclusionCuller::Stats* occlusionStats);
+    // Once per loop iteration, rendered or not; prints a report when the
+    // interval has passed
+    void endFrame(float frameTime, float cpuMilliseconds, const Mode& mode);
+    // Drops the samples so far, e.g. after a setting changed
+    void reset();
+
+   private:
+    void printReport(const Mode& mode);
+    void printAttachmentMemory();
+    void printGpuStats();
+    void printPipelineLibrary();
+
+    LveDevice& lveDevice;
+    LveRenderer& lveRenderer;
+    LvePipelineRegistry& pipelineRegistry;
+    float interval;
+
+    float reportTimer = 0.f;
+    float recordTimeTotal = 0.f;
+    float frameTimeTotal = 0.f;
+    int reportFrames = 0;
+    uint64_t visibleTotal = 0;
+    uint64_t culledTotal = 0;
+    uint64_t occludedTotal = 0;
+    uint64_t disoccludedTotal = 0;
+    // per rendered frame: what was recorded, and what the GPU ran
+    LveCounters::Values countersTotal{};
+    uint32_t countedFrames = 0;
+    LveGpuProfiler::PipelineStatistics pipelineStatisticsTotal{};
+    uint32_t pipelineStatisticsFrames = 0;
+
+    // link latencies are reported whenever an optimized link finished
+    uint32_t reportedOptimizedLinks = 0;
+    // attachment memory is reported whenever the swapchain changed it
+    LveSwapChain::AttachmentMemory reportedAttachments{};
+    // pipeline creation times are reported once the startup pipelines
+    // have compiled, to compare a cold with a warm cache
+    bool pipelineCreationReported = false;
+};
+
+}  // namespace lve
@@ -0,0 +1,250 @@
+#include "lve_async_compute.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+LveAsyncCompute::LveAsyncCompute(LveDevice& device, LveRenderer& renderer)
+    : lveDevice{device},
+      lveRenderer{renderer},
+      timeline_{std::make_unique<LveTimeline>(device)} {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = lveDevice.computeQueueFamily();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                     VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    if (vkCreateCommandPool(
+            lveDevice.device(), &poolInfo, nullptr, &commandPool) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute command pool!");
+    }
+
+    commandBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount =
+        static_cast<uint32_t>(commandBuffers.size());
+    if (vkAllocateCommandBuffers(
+            lveDevice.device(), &allocInfo, commandBuffers.data()) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate compute command buffers!");
+    }
+}
+
+LveAsyncCompute::~LveAsyncCompute() {
+    // submissions finish before the graphics frames waiting for them
+    vkFreeCommandBuffers(lveDevice.device(),
+                         commandPool,
+                         static_cast<uint32_t>(commandBuffers.size()),
+                         commandBuffers.data());
+    vkDestroyCommandPool(lveDevice.device(), commandPool, nullptr);
+}
+
+VkCommandBuffer LveAsyncCompute::begin() {
+    assert(lveRenderer.isFrameInProgress() &&
+           "Cannot begin compute work when frame is not in progress");
+    assert(recording == VK_NULL_HANDLE && "Compute work already recording");
+
+    // LveRenderer::beginFrame waited for the graphics frame that last used
+    // the slot, which waited for the compute work recorded into it
+    recording = commandBuffers[lveRenderer.getFrameIndex()];
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(recording, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin compute command buffer!");
+    }
+
+    handoffStages = 0;
+    graphicsWaitValue = 0;
+    graphicsWaitStages = 0;
+    if (!pendingBuffers.empty() || !pendingImages.empty()) {
+        // released by frames that were all submitted before this one began
+        graphicsWaitValue = lveDevice.timeline().getSubmittedValue();
+        for (const auto& buffer : pendingBuffers) {
+            graphicsWaitStages |= buffer.dstStages;
+        }
+        for (const auto& image : pendingImages) {
+            graphicsWaitStages |= image.dstStages;
+        }
+        recordHandoffs(recording,
+                       pendingBuffers,
+                       pendingImages,
+                       lveDevice.graphicsQueueFamily(),
+                       lveDevice.computeQueueFamily(),
+                       true);
+        pendingBuffers.clear();
+        pendingImages.clear();
+    }
+    return recording;
+}
+
+void LveAsyncCompute::submit(VkPipelineStageFlags waitStages) {
+    assert(recording != VK_NULL_HANDLE && "Compute work is not recording");
+    if (vkEndCommandBuffer(recording) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record compute command buffer!");
+    }
+
+    uint64_t signalValue = timeline_->advance();
+    VkSemaphore signalSemaphore = timeline_->getSemaphore();
+    VkSemaphore waitSemaphore = lveDevice.timeline().getSemaphore();
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &recording;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
+    if (graphicsWaitValue > 0) {
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &graphicsWaitValue;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &waitSemaphore;
+        submitInfo.pWaitDstStageMask = &graphicsWaitStages;
+    }
+
+    if (vkQueueSubmit(
+            lveDevice.computeQueue(), 1, &submitInfo, VK_NULL_HANDLE) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to submit compute command buffer!");
+    }
+    recording = VK_NULL_HANDLE;
+
+    // without stages to go by, the whole graphics frame waits
+    VkPipelineStageFlags stages = handoffStages | waitStages;
+    lveRenderer.addSubmitWait(
+        {signalSemaphore,
+         signalValue,
+         stages != 0 ? stages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT});
+}
+
+void LveAsyncCompute::handOffToGraphics(
+    const std::vector<BufferHandoff>& buffers,
+    const std::vector<ImageHandoff>& images) {
+    assert(recording != VK_NULL_HANDLE && "Compute work is not recording");
+    recordHandoffs(recording,
+                   buffers,
+                   images,
+                   lveDevice.computeQueueFamily(),
+                   lveDevice.graphicsQueueFamily(),
+                   false);
+    if (!isAsync()) return;
+
+    recordHandoffs(lveRenderer.getCurrentCommandBuffer(),
+                   buffers,
+                   images,
+                   lveDevice.computeQueueFamily(),
+                   lveDevice.graphicsQueueFamily(),
+                   true);
+    for (const auto& buffer : buffers) handoffStages |= buffer.dstStages;
+    for (const auto& image : images) handoffStages |= image.dstStages;
+}
+
+void LveAsyncCompute::handOffToCompute(
+    VkCommandBuffer graphicsCommandBuffer,
+    const std::vector<BufferHandoff>& buffers,
+    const std::vector<ImageHandoff>& images) {
+    assert(recording == VK_NULL_HANDLE &&
+           "Hand resources to compute after submitting this frame's work");
+    recordHandoffs(graphicsCommandBuffer,
+                   buffers,
+                   images,
+                   lveDevice.graphicsQueueFamily(),
+                   lveDevice.computeQueueFamily(),
+                   false);
+    if (!isAsync()) return;
+
+    pendingBuffers.insert(pendingBuffers.end(), buffers.begin(), buffers.end());
+    pendingImages.insert(pendingImages.end(), images.begin(), images.end());
+}
+
+void LveAsyncCompute::cancelHandoffs(VkImage image) {
+    pendingImages.erase(
+        std::remove_if(pendingImages.begin(),
+                       pendingImages.end(),
+                       [&](const ImageHandoff& handoff) {
+                           return handoff.image == image;
+                       }),
+        pendingImages.end());
+}
+
+void LveAsyncCompute::recordHandoffs(VkCommandBuffer commandBuffer,
+                                     const std::vector<BufferHandoff>& buffers,
+                                     const std::vector<ImageHandoff>& images,
+                                     uint32_t srcFamily,
+                                     uint32_t dstFamily,
+                                     bool acquire) {
+    if (buffers.empty() && images.empty()) return;
+
+    // The release only makes the writes available, the acquire makes them
+    // visible; the semaphore between the two orders them. On one queue the
+    // release half is an ordinary barrier and there is no acquire.
+    const bool transfer = srcFamily != dstFamily;
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    for (const auto& handoff : buffers) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = acquire ? 0 : handoff.srcAccess;
+        barrier.dstAccessMask =
+            acquire || !transfer ? handoff.dstAccess : 0;
+        barrier.srcQueueFamilyIndex =
+            transfer ? srcFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex =
+            transfer ? dstFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = handoff.buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        bufferBarriers.push_back(barrier);
+        srcStages |= acquire ? handoff.dstStages : handoff.srcStages;
+        dstStages |= handoff.dstStages;
+    }
+
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    for (const auto& handoff : images) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = acquire ? 0 : handoff.srcAccess;
+        barrier.dstAccessMask =
+            acquire || !transfer ? handoff.dstAccess : 0;
+        barrier.oldLayout = handoff.oldLayout;
+        barrier.newLayout = handoff.newLayout;
+        barrier.srcQueueFamilyIndex =
+            transfer ? srcFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex =
+            transfer ? dstFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = handoff.image;
+        barrier.subresourceRange = handoff.range;
+        imageBarriers.push_back(barrier);
+        srcStages |= acquire ? handoff.dstStages : handoff.srcStages;
+        dstStages |= handoff.dstStages;
+    }
+
+    // the acquiring queue may not support the releasing queue's stages
+    if (transfer && !acquire) dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         srcStages,
+                         dstStages,
+                         0,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(bufferBarriers.size()),
+                         bufferBarriers.data(),
+                         static_cast<uint32_t>(imageBarriers.size()),
+                         imageBarriers.data());
+}
+
+}  // namespace lve
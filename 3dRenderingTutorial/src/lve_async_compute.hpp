@@ -0,0 +1,114 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_renderer.hpp"
+#include "lve_timeline.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Compute work of a frame for LveDevice::computeQueue. On devices with a
+// compute-only queue family it runs next to the graphics queue; otherwise
+// it is submitted to the graphics queue with the same synchronization, so
+// the results do not change. Each frame, between LveRenderer::beginFrame
+// and endFrame:
+//   VkCommandBuffer commandBuffer = asyncCompute.begin();
+//   ... record, hand over what the graphics commands use next ...
+//   asyncCompute.submit();
+// The frame's graphics submission waits for the compute submission, which
+// in turn waits for the graphics frames that handed resources to it.
+//
+// Exclusive resources used on both queues must be handed over: the
+// release is recorded on the queue that used them last, the acquire on
+// the queue that uses them next. On a single queue a handoff is a plain
+// barrier.
+class LveAsyncCompute {
+   public:
+    // srcStages and srcAccess are the last use on the releasing queue,
+    // dstStages and dstAccess the first use on the acquiring one
+    struct BufferHandoff {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkPipelineStageFlags srcStages = 0;
+        VkAccessFlags srcAccess = 0;
+        VkPipelineStageFlags dstStages = 0;
+        VkAccessFlags dstAccess = 0;
+    };
+    struct ImageHandoff {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageSubresourceRange range{};
+        VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags srcStages = 0;
+        VkAccessFlags srcAccess = 0;
+        VkPipelineStageFlags dstStages = 0;
+        VkAccessFlags dstAccess = 0;
+    };
+
+    LveAsyncCompute(LveDevice& device, LveRenderer& renderer);
+    ~LveAsyncCompute();
+
+    LveAsyncCompute(const LveAsyncCompute&) = delete;
+    LveAsyncCompute& operator=(const LveAsyncCompute&) = delete;
+
+    // Whether the work runs on a queue of its own
+    bool isAsync() { return lveDevice.hasAsyncCompute(); }
+    // Signaled by every submit
+    LveTimeline& timeline() { return *timeline_; }
+
+    // Starts this frame's compute commands with the acquires of what
+    // earlier graphics frames handed over
+    VkCommandBuffer begin();
+    VkCommandBuffer getCommandBuffer() {
+        assert(recording != VK_NULL_HANDLE &&
+               "Cannot get command buffer when compute is not recording");
+        return recording;
+    }
+    // The frame's graphics submission waits for the work at the stages of
+    // the handoffs to graphics and at graphicsWaitStages
+    void submit(VkPipelineStageFlags graphicsWaitStages = 0);
+
+    // Between begin and submit, after the last compute use: releases the
+    // resources in the compute command buffer and acquires them in the
+    // renderer's current command buffer, which must not have used them yet
+    void handOffToGraphics(const std::vector<BufferHandoff>& buffers,
+                           const std::vector<ImageHandoff>& images);
+    // After submit, once the graphics commands of this frame are done with
+    // the resources: releases them in graphicsCommandBuffer, the next begin
+    // acquires them and makes its submission wait for this frame
+    void handOffToCompute(VkCommandBuffer graphicsCommandBuffer,
+                          const std::vector<BufferHandoff>& buffers,
+                          const std::vector<ImageHandoff>& images);
+    // Forgets handoffs to compute of an image that is being destroyed
+    void cancelHandoffs(VkImage image);
+
+   private:
+    // Release (acquire false) or acquire half of the handoffs, or a plain
+    // barrier when both queues are the same
+    void recordHandoffs(VkCommandBuffer commandBuffer,
+                        const std::vector<BufferHandoff>& buffers,
+                        const std::vector<ImageHandoff>& images,
+                        uint32_t srcFamily,
+                        uint32_t dstFamily,
+                        bool acquire);
+
+    LveDevice& lveDevice;
+    LveRenderer& lveRenderer;
+    std::unique_ptr<LveTimeline> timeline_;
+    VkCommandPool commandPool;
+    // one per frame slot, free again once the slot's graphics frame is
+    std::vector<VkCommandBuffer> commandBuffers;
+    VkCommandBuffer recording = VK_NULL_HANDLE;
+    // stages of this frame's handoffs to graphics
+    VkPipelineStageFlags handoffStages = 0;
+    // handed over by graphics, acquired by the next begin
+    std::vector<BufferHandoff> pendingBuffers;
+    std::vector<ImageHandoff> pendingImages;
+    // graphics timeline value the recording submission waits for
+    uint64_t graphicsWaitValue = 0;
+    VkPipelineStageFlags graphicsWaitStages = 0;
+};
+
+}  // namespace lve
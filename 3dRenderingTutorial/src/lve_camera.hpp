@@ -4,6 +4,8 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include "lve_frustum_culling.hpp"
+
 namespace lve {
 class LveCamera {
    public:
@@ -31,6 +33,10 @@ class LveCamera {
 
     const glm::mat4& getProjectionMatrix() const { return projectionMatrix; }
     const glm::mat4& getViewMatrix() const { return viewMatrix; };
+    // World-space frustum of the current projection and view
+    Frustum getFrustum() const {
+        return Frustum::fromProjectionView(projectionMatrix * viewMatrix);
+    }
 
    private:
     glm::mat4 projectionMatrix{1.f};
@@ -0,0 +1,90 @@
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace lve {
+
+// Work recorded into command buffers and objects created, counted by the
+// code that records or creates them (LveModel, LvePipeline, the render
+// systems). Counts are taken when commands are recorded, so a secondary
+// command buffer replayed in later frames only counts once, and indirect
+// draws count their calls but not what the GPU reads from the buffer;
+// pipeline statistics queries count what actually ran.
+//
+// Pipelines are created on worker threads, so counting is atomic.
+class LveCounters {
+   public:
+    enum Counter {
+        DRAWS,
+        INDIRECT_DRAWS,
+        // of direct draws; indirect ones pick theirs on the GPU
+        INSTANCES,
+        TRIANGLES,
+        DISPATCHES,
+        PIPELINE_BINDS,
+        VERTEX_BUFFER_BINDS,
+        DESCRIPTOR_SET_BINDS,
+        PUSH_CONSTANT_BYTES,
+        BUFFERS_CREATED,
+        PIPELINES_CREATED,
+        COUNTER_COUNT,
+    };
+
+    struct Values {
+        std::array<uint64_t, COUNTER_COUNT> counts{};
+
+        uint64_t operator[](Counter counter) const { return counts[counter]; }
+        // Counts since earlier
+        Values operator-(const Values& earlier) const {
+            Values difference{};
+            for (size_t i = 0; i < counts.size(); i++) {
+                difference.counts[i] = counts[i] - earlier.counts[i];
+            }
+            return difference;
+        }
+        Values& operator+=(const Values& other) {
+            for (size_t i = 0; i < counts.size(); i++) {
+                counts[i] += other.counts[i];
+            }
+            return *this;
+        }
+    };
+
+    static const char* getName(Counter counter) {
+        static constexpr std::array<const char*, COUNTER_COUNT> names{
+            "draws",
+            "indirect draws",
+            "instances",
+            "triangles",
+            "dispatches",
+            "pipeline binds",
+            "vertex buffer binds",
+            "descriptor set binds",
+            "push constant bytes",
+            "buffers created",
+            "pipelines created",
+        };
+        return names[counter];
+    }
+
+    void add(Counter counter, uint64_t count = 1) {
+        counts[counter].fetch_add(count, std::memory_order_relaxed);
+    }
+    // Totals since the device was created
+    Values get() const {
+        Values values{};
+        for (size_t i = 0; i < counts.size(); i++) {
+            values.counts[i] = counts[i].load(std::memory_order_relaxed);
+        }
+        return values;
+    }
+
+   private:
+    std::array<std::atomic<uint64_t>, COUNTER_COUNT> counts{};
+};
+
+}  // namespace lve
@@ -0,0 +1,202 @@
+#include "lve_cpu_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace lve {
+
+struct LveCpuProfiler::Track {
+    struct Event {
+        const char* name;
+        int64_t beginNanoseconds;
+        int64_t endNanoseconds;
+    };
+
+    // An event the exporting thread may read while the owner overwrites
+    // it: sequence is the index of the event + 1 once it is complete and 0
+    // while it is written, so a copy is only kept when sequence was the
+    // same before and after
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<int64_t> beginNanoseconds{0};
+        std::atomic<int64_t> endNanoseconds{0};
+    };
+
+    std::array<Slot, CAPACITY> slots;
+    // events ever recorded; the last CAPACITY of them are kept
+    std::atomic<uint64_t> written{0};
+    std::string name;
+    uint32_t id;
+};
+
+namespace {
+
+static_assert((LveCpuProfiler::CAPACITY & (LveCpuProfiler::CAPACITY - 1)) ==
+                  0,
+              "CAPACITY must be a power of two");
+
+// Registration only; recording never takes the lock
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<LveCpuProfiler::Track>> tracks;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+std::shared_ptr<LveCpuProfiler::Track> registerTrack(const std::string& name) {
+    auto track = std::make_shared<LveCpuProfiler::Track>();
+    auto& tracks = registry();
+    std::lock_guard<std::mutex> lock{tracks.mutex};
+    track->id = static_cast<uint32_t>(tracks.tracks.size());
+    track->name = name.empty() ? "thread " + std::to_string(track->id) : name;
+    tracks.tracks.push_back(track);
+    return track;
+}
+
+LveCpuProfiler::Track& threadTrack() {
+    // kept by the registry after the thread exits
+    thread_local std::shared_ptr<LveCpuProfiler::Track> track =
+        registerTrack("");
+    return *track;
+}
+
+void writeEscaped(std::ostream& out, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+}
+
+}  // namespace
+
+int64_t LveCpuProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void LveCpuProfiler::setThreadName(const std::string& name) {
+    auto& track = threadTrack();
+    std::lock_guard<std::mutex> lock{registry().mutex};
+    track.name = name;
+}
+
+void LveCpuProfiler::record(const char* name,
+                            int64_t beginNanoseconds,
+                            int64_t endNanoseconds) {
+    record(&threadTrack(), name, beginNanoseconds, endNanoseconds);
+}
+
+LveCpuProfiler::Track* LveCpuProfiler::addTrack(const std::string& name) {
+    return registerTrack(name).get();
+}
+
+void LveCpuProfiler::record(Track* track,
+                            const char* name,
+                            int64_t beginNanoseconds,
+                            int64_t endNanoseconds) {
+    // single writer: the count is only published once the event is there
+    uint64_t index = track->written.load(std::memory_order_relaxed);
+    auto& slot = track->slots[index & (CAPACITY - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    // keeps the field stores below after the sequence store above
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.beginNanoseconds.store(beginNanoseconds, std::memory_order_relaxed);
+    slot.endNanoseconds.store(endNanoseconds, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+    track->written.store(index + 1, std::memory_order_release);
+}
+
+size_t LveCpuProfiler::exportChromeTrace(const std::string& path) {
+    struct Exported {
+        std::string trackName;
+        uint32_t id;
+        std::vector<Track::Event> events;
+    };
+    std::vector<Exported> exported;
+    {
+        std::lock_guard<std::mutex> lock{registry().mutex};
+        for (auto& track : registry().tracks) {
+            uint64_t end = track->written.load(std::memory_order_acquire);
+            uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+            std::vector<Track::Event> events;
+            for (uint64_t i = begin; i < end; i++) {
+                // skips slots the owner overwrote or is writing
+                const auto& slot = track->slots[i & (CAPACITY - 1)];
+                uint64_t sequence =
+                    slot.sequence.load(std::memory_order_acquire);
+                Track::Event event{
+                    slot.name.load(std::memory_order_relaxed),
+                    slot.beginNanoseconds.load(std::memory_order_relaxed),
+                    slot.endNanoseconds.load(std::memory_order_relaxed)};
+                // keeps the field loads above before the sequence load
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence == i + 1 &&
+                    slot.sequence.load(std::memory_order_relaxed) == i + 1) {
+                    events.push_back(event);
+                }
+            }
+            exported.push_back({track->name, track->id, std::move(events)});
+        }
+    }
+
+    int64_t origin = INT64_MAX;
+    for (const auto& track : exported) {
+        for (const auto& event : track.events) {
+            origin = std::min(origin, event.beginNanoseconds);
+        }
+    }
+
+    std::ofstream out{path};
+    if (!out) {
+        throw std::runtime_error("failed to open trace file: " + path);
+    }
+    // complete events in microseconds; the viewer nests them by time
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+    size_t count = 0;
+    bool first = true;
+    for (const auto& track : exported) {
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << track.id << ",\"args\":{\"name\":\"";
+        writeEscaped(out, track.trackName);
+        out << "\"}}";
+        first = false;
+        for (const auto& event : track.events) {
+            out << ",\n{\"name\":\"";
+            writeEscaped(out, event.name);
+            out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track.id
+                << ",\"ts\":" << (event.beginNanoseconds - origin) / 1e3
+                << ",\"dur\":"
+                << (event.endNanoseconds - event.beginNanoseconds) / 1e3
+                << "}";
+            count++;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    if (!out) {
+        throw std::runtime_error("failed to write trace file: " + path);
+    }
+    return count;
+}
+
+}  // namespace lve
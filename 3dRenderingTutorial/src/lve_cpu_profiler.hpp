@@ -0,0 +1,98 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lve {
+
+// Timed zones of CPU threads for a Chrome trace (chrome://tracing or
+// ui.perfetto.dev):
+//   LVE_CPU_ZONE("record");
+// times the rest of the enclosing block, and
+//   LVE_CPU_ZONE_NAMED(recordZone, "record");
+//   ...
+//   LVE_CPU_ZONE_END(recordZone);
+// a part of it. Each thread records into a ring buffer of its own,
+// keeping its last CAPACITY zones, without locks; only a thread's first
+// zone registers its buffer. Zone names must outlive the export, string
+// literals usually.
+//
+// The zones only exist when compiled with LVE_CPU_PROFILING (see the
+// Makefile), otherwise the macros are empty and nothing gets recorded.
+class LveCpuProfiler {
+   public:
+    // Zones kept per track, a power of two
+    static constexpr size_t CAPACITY = size_t{1} << 14;
+
+    // A thread's zones, or zones measured elsewhere such as GPU work
+    struct Track;
+
+    class Zone {
+       public:
+        explicit Zone(const char* name) : name{name}, beginNanoseconds{now()} {}
+        ~Zone() { end(); }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+        // Ends the zone before the end of the block
+        void end() {
+            if (name == nullptr) return;
+            record(name, beginNanoseconds, now());
+            name = nullptr;
+        }
+
+       private:
+        const char* name;
+        int64_t beginNanoseconds;
+    };
+
+    // Whether LVE_CPU_ZONE records anything in this build
+    static constexpr bool isEnabled() {
+#ifdef LVE_CPU_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Time of std::chrono::steady_clock the zones are measured in
+    static int64_t now();
+    // Name of the calling thread's track in the trace
+    static void setThreadName(const std::string& name);
+    // Zone of the calling thread
+    static void record(const char* name,
+                       int64_t beginNanoseconds,
+                       int64_t endNanoseconds);
+
+    // Track for zones that were not measured on a CPU thread, with times
+    // converted to now()'s clock. Only one thread may record into it.
+    static Track* addTrack(const std::string& name);
+    static void record(Track* track,
+                       const char* name,
+                       int64_t beginNanoseconds,
+                       int64_t endNanoseconds);
+
+    // Writes the zones of all tracks as Chrome trace events and returns
+    // how many. Zones a thread overwrites while they are being exported
+    // are left out. Throws when the file cannot be written.
+    static size_t exportChromeTrace(const std::string& path);
+};
+
+}  // namespace lve
+
+#ifdef LVE_CPU_PROFILING
+#define LVE_CPU_ZONE_CONCAT_(a, b) a##b
+#define LVE_CPU_ZONE_VARIABLE_(line) LVE_CPU_ZONE_CONCAT_(lveCpuZone, line)
+#define LVE_CPU_ZONE(name) \
+    ::lve::LveCpuProfiler::Zone LVE_CPU_ZONE_VARIABLE_(__LINE__) { name }
+#define LVE_CPU_ZONE_NAMED(variable, name) \
+    ::lve::LveCpuProfiler::Zone variable { name }
+#define LVE_CPU_ZONE_END(variable) variable.end()
+#else
+#define LVE_CPU_ZONE(name) static_cast<void>(0)
+#define LVE_CPU_ZONE_NAMED(variable, name) static_cast<void>(0)
+#define LVE_CPU_ZONE_END(variable) static_cast<void>(0)
+#endif
@@ -1,8 +1,15 @@
 #include "lve_device.hpp"
 
+#include "lve_shader_library.hpp"
+#include "lve_timeline.hpp"
+
 // std headers
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
 #include <set>
 #include <unordered_set>
 
@@ -51,9 +58,16 @@ LveDevice::LveDevice(LveWindow& window) : window{window} {
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    createPipelineCache();
+    timeline_ = std::make_unique<LveTimeline>(*this);
+    shaderLibrary_ = std::make_unique<LveShaderLibrary>(*this);
 }
 
 LveDevice::~LveDevice() {
+    shaderLibrary_.reset();
+    timeline_.reset();
+    savePipelineCache();
+    vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
     vkDestroyCommandPool(device_, commandPool, nullptr);
     vkDestroyDevice(device_, nullptr);
 
@@ -77,7 +91,8 @@ void LveDevice::createInstance() {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    // 1.2 for timeline semaphores, which frame synchronization is built on
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -139,6 +154,9 @@ void LveDevice::createLogicalDevice() {
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily,
                                               indices.presentFamily};
+    if (indices.computeFamilyHasValue) {
+        uniqueQueueFamilies.insert(indices.computeFamily);
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -152,6 +170,14 @@ void LveDevice::createLogicalDevice() {
 
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // indirect draws pick their object buffer slot through firstInstance
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    pipelineStatisticsEnabled = supportedFeatures.pipelineStatisticsQuery &&
+                                supportedFeatures.inheritedQueries;
+    deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsEnabled;
+    deviceFeatures.inheritedQueries = pipelineStatisticsEnabled;
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -161,9 +187,44 @@ void LveDevice::createLogicalDevice() {
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
     createInfo.pEnabledFeatures = &deviceFeatures;
+
+    // required by isDeviceSuitable
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+    createInfo.pNext = &timelineFeatures;
+
+    // optional features are chained in front of createInfo.pNext
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+    dynamicRenderingFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    if (checkDynamicRenderingSupport(physicalDevice)) {
+        enabledExtensions.insert(enabledExtensions.end(),
+                                 dynamicRenderingExtensions.begin(),
+                                 dynamicRenderingExtensions.end());
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+        dynamicRenderingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &dynamicRenderingFeatures;
+    }
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT
+        graphicsPipelineLibraryFeatures{};
+    graphicsPipelineLibraryFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+    if (checkGraphicsPipelineLibrarySupport(physicalDevice)) {
+        enabledExtensions.insert(enabledExtensions.end(),
+                                 graphicsPipelineLibraryExtensions.begin(),
+                                 graphicsPipelineLibraryExtensions.end());
+        graphicsPipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+        graphicsPipelineLibraryFeatures.pNext =
+            const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &graphicsPipelineLibraryFeatures;
+        graphicsPipelineLibraryEnabled = true;
+    }
     createInfo.enabledExtensionCount =
-        static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // might not really be necessary anymore because device specific validation
     // layers have been deprecated
@@ -182,6 +243,49 @@ void LveDevice::createLogicalDevice() {
 
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+    graphicsQueueFamily_ = indices.graphicsFamily;
+    computeQueueFamily_ = indices.computeFamilyHasValue
+                              ? indices.computeFamily
+                              : indices.graphicsFamily;
+    vkGetDeviceQueue(device_, computeQueueFamily_, 0, &computeQueue_);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physicalDevice, &familyCount, families.data());
+    timestampValidBits_ = families[graphicsQueueFamily_].timestampValidBits;
+
+    if (dynamicRenderingFeatures.dynamicRendering) {
+        vkCmdBeginRenderingKHR_ = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+            vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR"));
+        vkCmdEndRenderingKHR_ = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+            vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR"));
+        dynamicRenderingEnabled = vkCmdBeginRenderingKHR_ != nullptr &&
+                                  vkCmdEndRenderingKHR_ != nullptr;
+    }
+    std::cout << "dynamic rendering: "
+              << (dynamicRenderingEnabled ? "available" : "unavailable")
+              << std::endl;
+
+    if (graphicsPipelineLibraryEnabled) {
+        VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT
+            libraryProperties{};
+        libraryProperties.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &libraryProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        fastPipelineLinking =
+            libraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+    }
+    std::cout << "graphics pipeline library: "
+              << (!graphicsPipelineLibraryEnabled ? "unavailable"
+                  : fastPipelineLinking           ? "available, fast linking"
+                                                  : "available, slow linking")
+              << std::endl;
 }
 
 void LveDevice::createCommandPool() {
@@ -203,10 +307,118 @@ void LveDevice::createSurface() {
     window.createWindowSurface(instance, &surface_);
 }
 
+std::vector<char> LveDevice::readPipelineCacheFile() {
+    std::ifstream file(PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    std::vector<char> data(fileSize);
+    file.seekg(0);
+    file.read(data.data(), fileSize);
+
+    // Header layout (VkPipelineCacheHeaderVersionOne): header size,
+    // header version, vendor id, device id, then the cache UUID. Data from
+    // another driver or GPU is dropped instead of handed to the driver.
+    const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (!file || fileSize < headerSize) {
+        std::cout << "pipeline cache: ignoring truncated "
+                  << PIPELINE_CACHE_PATH << std::endl;
+        return {};
+    }
+
+    uint32_t header[4];
+    memcpy(header, data.data(), sizeof(header));
+    if (header[0] < headerSize ||
+        header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        header[2] != properties.vendorID || header[3] != properties.deviceID ||
+        memcmp(data.data() + sizeof(header),
+               properties.pipelineCacheUUID,
+               VK_UUID_SIZE) != 0) {
+        std::cout << "pipeline cache: " << PIPELINE_CACHE_PATH
+                  << " was written by another device or driver, ignoring it"
+                  << std::endl;
+        return {};
+    }
+
+    return data;
+}
+
+void LveDevice::createPipelineCache() {
+    std::vector<char> initialData = readPipelineCacheFile();
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+
+    pipelineCacheWarm = !initialData.empty();
+    std::cout << "pipeline cache: "
+              << (pipelineCacheWarm
+                      ? "loaded " + std::to_string(initialData.size()) +
+                            " bytes"
+                      : std::string{"cold"})
+              << std::endl;
+}
+
+void LveDevice::addPipelineCreation(float milliseconds) {
+    std::lock_guard<std::mutex> lock{pipelineCreationMutex};
+    pipelineCreationStats.pipelines++;
+    pipelineCreationStats.totalMilliseconds += milliseconds;
+    pipelineCreationStats.maxMilliseconds =
+        std::max(pipelineCreationStats.maxMilliseconds, milliseconds);
+}
+
+LveDevice::PipelineCreationStats LveDevice::getPipelineCreationStats() {
+    std::lock_guard<std::mutex> lock{pipelineCreationMutex};
+    return pipelineCreationStats;
+}
+
+void LveDevice::savePipelineCache() {
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, nullptr) !=
+            VK_SUCCESS ||
+        dataSize == 0) {
+        return;
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(
+            device_, pipelineCache_, &dataSize, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    // Write a temporary file and rename it over the old cache, so a crash
+    // mid-write never leaves a torn cache behind.
+    const std::string tempPath = std::string{PIPELINE_CACHE_PATH} + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(dataSize));
+        file.flush();
+        if (!file) {
+            std::cerr << "pipeline cache: failed to write " << tempPath
+                      << std::endl;
+            std::remove(tempPath.c_str());
+            return;
+        }
+    }
+    if (std::rename(tempPath.c_str(), PIPELINE_CACHE_PATH) != 0) {
+        std::cerr << "pipeline cache: failed to replace "
+                  << PIPELINE_CACHE_PATH << std::endl;
+        std::remove(tempPath.c_str());
+    }
+}
+
 bool LveDevice::isDeviceSuitable(VkPhysicalDevice device) {
     QueueFamilyIndices indices = findQueueFamilies(device);
 
-    bool extensionsSupported = checkDeviceExtensionSupport(device);
+    bool extensionsSupported =
+        checkDeviceExtensionSupport(device, deviceExtensions);
 
     bool swapChainAdequate = false;
     if (extensionsSupported) {
@@ -220,7 +432,9 @@ bool LveDevice::isDeviceSuitable(VkPhysicalDevice device) {
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
     return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-           supportedFeatures.samplerAnisotropy;
+           supportedFeatures.samplerAnisotropy &&
+           supportedFeatures.drawIndirectFirstInstance &&
+           checkTimelineSemaphoreSupport(device);
 }
 
 void LveDevice::populateDebugMessengerCreateInfo(
@@ -273,12 +487,8 @@ bool LveDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char*> LveDevice::getRequiredExtensions() {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char*> extensions(glfwExtensions,
-                                        glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions =
+        window.getRequiredInstanceExtensions();
 
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -311,7 +521,8 @@ void LveDevice::hasGflwRequiredInstanceExtensions() {
     }
 }
 
-bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
+bool LveDevice::checkDeviceExtensionSupport(
+    VkPhysicalDevice device, const std::vector<const char*>& extensions) {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(
         device, nullptr, &extensionCount, nullptr);
@@ -320,8 +531,8 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     vkEnumerateDeviceExtensionProperties(
         device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(),
-                                             deviceExtensions.end());
+    std::set<std::string> requiredExtensions(extensions.begin(),
+                                             extensions.end());
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -330,6 +541,60 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+bool LveDevice::checkTimelineSemaphoreSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timelineFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+bool LveDevice::checkDynamicRenderingSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_1 ||
+        !checkDeviceExtensionSupport(device, dynamicRenderingExtensions)) {
+        return false;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+    dynamicRenderingFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &dynamicRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+}
+
+bool LveDevice::checkGraphicsPipelineLibrarySupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_1 ||
+        !checkDeviceExtensionSupport(device,
+                                     graphicsPipelineLibraryExtensions)) {
+        return false;
+    }
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures{};
+    libraryFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &libraryFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    return libraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+}
+
 QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
     QueueFamilyIndices indices;
 
@@ -341,6 +606,18 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
     vkGetPhysicalDeviceQueueFamilyProperties(
         device, &queueFamilyCount, queueFamilies.data());
 
+    // dedicated compute families are what runs asynchronously to graphics
+    for (uint32_t family = 0; family < queueFamilyCount; family++) {
+        const auto& properties = queueFamilies[family];
+        if (properties.queueCount > 0 &&
+            (properties.queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+            !(properties.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.computeFamily = family;
+            indices.computeFamilyHasValue = true;
+            break;
+        }
+    }
+
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
         if (queueFamily.queueCount > 0 &&
@@ -411,6 +688,17 @@ VkFormat LveDevice::findSupportedFormat(const std::vector<VkFormat>& candidates,
     throw std::runtime_error("failed to find supported format!");
 }
 
+bool LveDevice::hasFormatFeatures(VkFormat format,
+                                  VkImageTiling tiling,
+                                  VkFormatFeatureFlags features) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+    VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR
+                                         ? props.linearTilingFeatures
+                                         : props.optimalTilingFeatures;
+    return (supported & features) == features;
+}
+
 uint32_t LveDevice::findMemoryType(uint32_t typeFilter,
                                    VkMemoryPropertyFlags properties) {
     VkPhysicalDeviceMemoryProperties memProperties;
@@ -426,6 +714,20 @@ uint32_t LveDevice::findMemoryType(uint32_t typeFilter,
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool LveDevice::hasMemoryType(uint32_t typeFilter,
+                              VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) &&
+            (memProperties.memoryTypes[i].propertyFlags & properties) ==
+                properties) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void LveDevice::createBuffer(VkDeviceSize size,
                              VkBufferUsageFlags usage,
                              VkMemoryPropertyFlags properties,
@@ -437,6 +739,7 @@ void LveDevice::createBuffer(VkDeviceSize size,
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    counters_.add(LveCounters::BUFFERS_CREATED);
     if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create vertex buffer!");
     }
@@ -479,13 +782,24 @@ VkCommandBuffer LveDevice::beginSingleTimeCommands() {
 void LveDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     vkEndCommandBuffer(commandBuffer);
 
+    // Waits for this submission only, not for frames still in flight
+    uint64_t signalValue = timeline_->advance();
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+    VkSemaphore timelineSemaphore = timeline_->getSemaphore();
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timelineSemaphore;
 
     vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue_);
+    timeline_->wait(signalValue);
 
     vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
@@ -533,16 +847,25 @@ void LveDevice::copyBufferToImage(VkBuffer buffer,
     endSingleTimeCommands(commandBuffer);
 }
 
-void LveDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo,
+bool LveDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo,
                                     VkMemoryPropertyFlags properties,
                                     VkImage& image,
-                                    VkDeviceMemory& imageMemory) {
+                                    VkDeviceMemory& imageMemory,
+                                    VkMemoryPropertyFlags preferredProperties) {
     if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
     }
 
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device_, image, &memRequirements);
+    // a memory type of the device may still be unusable for this image
+    const bool preferred =
+        preferredProperties != 0 &&
+        hasMemoryType(memRequirements.memoryTypeBits,
+                      properties | preferredProperties);
+    if (preferred) {
+        properties |= preferredProperties;
+    }
 
     VkMemoryAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -558,6 +881,7 @@ void LveDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo,
     if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
         throw std::runtime_error("failed to bind image memory!");
     }
+    return preferred;
 }
 
 }  // namespace lve
\ No newline at end of file
@@ -1,13 +1,19 @@
 #pragma once
 
+#include "lve_counters.hpp"
 #include "lve_window.hpp"
 
 // std lib headers
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace lve {
 
+class LveShaderLibrary;
+class LveTimeline;
+
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +23,11 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    // Optional compute family without graphics support
+    uint32_t computeFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    bool computeFamilyHasValue = false;
     bool isComplete() {
         return graphicsFamilyHasValue && presentFamilyHasValue;
     }
@@ -41,23 +50,80 @@ class LveDevice {
     LveDevice(LveDevice&&) = delete;
     LveDevice& operator=(LveDevice&&) = delete;
 
+    // Written next to the executable's working directory on shutdown
+    static constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
     VkCommandPool getCommandPool() { return commandPool; }
+    // Shared by every pipeline, persisted in PIPELINE_CACHE_PATH
+    VkPipelineCache pipelineCache() { return pipelineCache_; }
+    // Whether the cache was loaded from disk rather than created empty
+    bool isPipelineCacheWarm() { return pipelineCacheWarm; }
+    // Graphics and compute pipelines compiled through the cache since
+    // startup; the milliseconds are wall-clock time spent in
+    // vkCreate*Pipelines, so they tell how much a warm cache saves
+    struct PipelineCreationStats {
+        uint32_t pipelines = 0;
+        float totalMilliseconds = 0.f;
+        float maxMilliseconds = 0.f;
+    };
+    // From any thread creating a pipeline
+    void addPipelineCreation(float milliseconds);
+    PipelineCreationStats getPipelineCreationStats();
+    // SPIR-V and shader modules shared by all pipelines
+    LveShaderLibrary& shaderLibrary() { return *shaderLibrary_; }
+    // Recorded work and created objects of everything using the device
+    LveCounters& counters() { return counters_; }
+    // Signaled by every graphics queue submission
+    LveTimeline& timeline() { return *timeline_; }
     VkDevice device() { return device_; }
     VkSurfaceKHR surface() { return surface_; }
+    // VK_KHR_dynamic_rendering, enabled when the device supports it
+    bool hasDynamicRendering() { return dynamicRenderingEnabled; }
+    void cmdBeginRendering(VkCommandBuffer commandBuffer,
+                           const VkRenderingInfoKHR* renderingInfo) {
+        vkCmdBeginRenderingKHR_(commandBuffer, renderingInfo);
+    }
+    void cmdEndRendering(VkCommandBuffer commandBuffer) {
+        vkCmdEndRenderingKHR_(commandBuffer);
+    }
+    // VK_EXT_graphics_pipeline_library, enabled when the device supports it
+    bool hasGraphicsPipelineLibrary() { return graphicsPipelineLibraryEnabled; }
+    // Whether linking library parts without link-time optimization is
+    // cheap enough to do while rendering a frame
+    bool hasFastPipelineLinking() { return fastPipelineLinking; }
     VkQueue graphicsQueue() { return graphicsQueue_; }
     VkQueue presentQueue() { return presentQueue_; }
+    // Queue of a compute-only family, which can run next to the graphics
+    // queue, when the device has one; the graphics queue otherwise
+    VkQueue computeQueue() { return computeQueue_; }
+    bool hasAsyncCompute() { return computeQueue_ != graphicsQueue_; }
+    uint32_t graphicsQueueFamily() { return graphicsQueueFamily_; }
+    uint32_t computeQueueFamily() { return computeQueueFamily_; }
+    // VK_QUERY_TYPE_PIPELINE_STATISTICS queries, together with inherited
+    // queries so that frames executing secondary command buffers are
+    // counted as well
+    bool hasPipelineStatistics() { return pipelineStatisticsEnabled; }
+    // Bits of the graphics queue's timestamps that count, 0 when it writes
+    // none
+    uint32_t graphicsTimestampValidBits() { return timestampValidBits_; }
 
     SwapChainSupportDetails getSwapChainSupport() {
         return querySwapChainSupport(physicalDevice);
     }
     uint32_t findMemoryType(uint32_t typeFilter,
                             VkMemoryPropertyFlags properties);
+    // Whether findMemoryType would succeed
+    bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     QueueFamilyIndices findPhysicalQueueFamilies() {
         return findQueueFamilies(physicalDevice);
     }
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,
                                  VkImageTiling tiling,
                                  VkFormatFeatureFlags features);
+    // Whether findSupportedFormat would accept format
+    bool hasFormatFeatures(VkFormat format,
+                           VkImageTiling tiling,
+                           VkFormatFeatureFlags features);
 
     // Buffer Helper Functions
     void createBuffer(VkDeviceSize size,
@@ -74,10 +140,13 @@ class LveDevice {
                            uint32_t height,
                            uint32_t layerCount);
 
-    void createImageWithInfo(const VkImageCreateInfo& imageInfo,
+    // Also asks for preferredProperties when one of the memory types the
+    // image supports has them; returns whether the memory has them
+    bool createImageWithInfo(const VkImageCreateInfo& imageInfo,
                              VkMemoryPropertyFlags properties,
                              VkImage& image,
-                             VkDeviceMemory& imageMemory);
+                             VkDeviceMemory& imageMemory,
+                             VkMemoryPropertyFlags preferredProperties = 0);
 
     VkPhysicalDeviceProperties properties;
 
@@ -88,6 +157,9 @@ class LveDevice {
     void pickPhysicalDevice();
     void createLogicalDevice();
     void createCommandPool();
+    void createPipelineCache();
+    void savePipelineCache();
+    std::vector<char> readPipelineCacheFile();
 
     // helper functions
     bool isDeviceSuitable(VkPhysicalDevice device);
@@ -97,7 +169,11 @@ class LveDevice {
     void populateDebugMessengerCreateInfo(
         VkDebugUtilsMessengerCreateInfoEXT& createInfo);
     void hasGflwRequiredInstanceExtensions();
-    bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    bool checkDeviceExtensionSupport(
+        VkPhysicalDevice device, const std::vector<const char*>& extensions);
+    bool checkTimelineSemaphoreSupport(VkPhysicalDevice device);
+    bool checkDynamicRenderingSupport(VkPhysicalDevice device);
+    bool checkGraphicsPipelineLibrarySupport(VkPhysicalDevice device);
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
     VkInstance instance;
@@ -110,11 +186,37 @@ class LveDevice {
     VkSurfaceKHR surface_;
     VkQueue graphicsQueue_;
     VkQueue presentQueue_;
+    VkQueue computeQueue_;
+    uint32_t graphicsQueueFamily_;
+    uint32_t computeQueueFamily_;
+    uint32_t timestampValidBits_ = 0;
+    bool pipelineStatisticsEnabled = false;
+    LveCounters counters_;
+    VkPipelineCache pipelineCache_;
+    bool pipelineCacheWarm = false;
+    std::mutex pipelineCreationMutex;
+    PipelineCreationStats pipelineCreationStats{};
+    std::unique_ptr<LveShaderLibrary> shaderLibrary_;
+    std::unique_ptr<LveTimeline> timeline_;
+    bool dynamicRenderingEnabled = false;
+    PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR_ = nullptr;
+    PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR_ = nullptr;
+    bool graphicsPipelineLibraryEnabled = false;
+    bool fastPipelineLinking = false;
 
     const std::vector<const char*> validationLayers = {
         "VK_LAYER_KHRONOS_validation"};
     const std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    // Optional; multiview and maintenance2, which it also depends on, are
+    // core in Vulkan 1.1
+    const std::vector<const char*> dynamicRenderingExtensions = {
+        VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+        VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+        VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME};
+    const std::vector<const char*> graphicsPipelineLibraryExtensions = {
+        VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+        VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME};
 };
 
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_camera.hpp"
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace lve {
+
+// Per-frame camera data, bound once per frame at set 0, binding 0
+struct GlobalUbo {
+    glm::mat4 projectionView{1.f};
+};
+
+// One entry of the per-frame object storage buffer (set 0, binding 1),
+// indexed in the vertex shader by gl_InstanceIndex. Layout matches std430.
+struct ObjectData {
+    glm::mat4 modelMatrix{1.f};
+    // columns of TransformComponent::normalMatrix, padded to vec4 like a
+    // std430 mat3
+    glm::vec4 normalMatrix[3]{
+        {1.f, 0.f, 0.f, 0.f}, {0.f, 1.f, 0.f, 0.f}, {0.f, 0.f, 1.f, 0.f}};
+    glm::vec4 color{1.f};
+};
+
+struct FrameInfo {
+    int frameIndex;
+    float frameTime;
+    VkCommandBuffer commandBuffer;
+    LveCamera& camera;
+    VkDescriptorSet globalDescriptorSet;
+    LveBuffer& objectBuffer;
+};
+}  // namespace lve
@@ -0,0 +1,191 @@
+#include "lve_frustum_culling.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define LVE_CULLING_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LVE_CULLING_SSE2
+#endif
+
+namespace lve {
+
+namespace {
+
+#if defined(LVE_CULLING_AVX2)
+struct SimdOps {
+    using Float = __m256;
+    static constexpr int width = 8;
+
+    static Float load(const float* p) { return _mm256_loadu_ps(p); }
+    static Float set(float v) { return _mm256_set1_ps(v); }
+    static Float allTrue() {
+        return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    }
+    // a * b + c
+    static Float madd(Float a, Float b, Float c) {
+        return _mm256_fmadd_ps(a, b, c);
+    }
+    static Float neg(Float a) { return _mm256_sub_ps(_mm256_setzero_ps(), a); }
+    static Float greaterEqual(Float a, Float b) {
+        return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+    }
+    static Float bitAnd(Float a, Float b) { return _mm256_and_ps(a, b); }
+    static int mask(Float a) { return _mm256_movemask_ps(a); }
+};
+#elif defined(LVE_CULLING_SSE2)
+struct SimdOps {
+    using Float = __m128;
+    static constexpr int width = 4;
+
+    static Float load(const float* p) { return _mm_loadu_ps(p); }
+    static Float set(float v) { return _mm_set1_ps(v); }
+    static Float allTrue() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+    // a * b + c
+    static Float madd(Float a, Float b, Float c) {
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+    }
+    static Float neg(Float a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+    static Float greaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+    static Float bitAnd(Float a, Float b) { return _mm_and_ps(a, b); }
+    static int mask(Float a) { return _mm_movemask_ps(a); }
+};
+#endif
+
+void cullRange(const CullingBatch& batch,
+               const Frustum& frustum,
+               size_t begin,
+               std::vector<uint32_t>& visible) {
+    for (size_t i = begin; i < batch.size(); i++) {
+        glm::vec3 center{batch.centerX[i], batch.centerY[i], batch.centerZ[i]};
+        if (frustum.intersectsSphere(center, batch.radius[i])) {
+            visible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+}  // namespace
+
+Frustum Frustum::fromProjectionView(const glm::mat4& projectionView) {
+    auto row = [&](int r) {
+        return glm::vec4{projectionView[0][r],
+                         projectionView[1][r],
+                         projectionView[2][r],
+                         projectionView[3][r]};
+    };
+    const glm::vec4 row0 = row(0);
+    const glm::vec4 row1 = row(1);
+    const glm::vec4 row2 = row(2);
+    const glm::vec4 row3 = row(3);
+
+    Frustum frustum{};
+    frustum.planes[PLANE_LEFT] = row3 + row0;
+    frustum.planes[PLANE_RIGHT] = row3 - row0;
+    frustum.planes[PLANE_BOTTOM] = row3 + row1;
+    frustum.planes[PLANE_TOP] = row3 - row1;
+    frustum.planes[PLANE_NEAR] = row2;  // clip z >= 0
+    frustum.planes[PLANE_FAR] = row3 - row2;
+
+    // Normalize so plane distances are in world units and can be compared
+    // against sphere radii.
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3{plane});
+    }
+    return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3{plane}, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CullingBatch::clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+}
+
+void CullingBatch::reserve(size_t count) {
+    centerX.reserve(count);
+    centerY.reserve(count);
+    centerZ.reserve(count);
+    radius.reserve(count);
+}
+
+void CullingBatch::push_back(const glm::vec3& center, float sphereRadius) {
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    radius.push_back(sphereRadius);
+}
+
+size_t CullingBatch::cull(const Frustum& frustum,
+                          std::vector<uint32_t>& visible) const {
+    visible.clear();
+    size_t begin = 0;
+
+#if defined(LVE_CULLING_AVX2) || defined(LVE_CULLING_SSE2)
+    using Ops = SimdOps;
+    using Float = Ops::Float;
+
+    Float planeX[Frustum::PLANE_COUNT];
+    Float planeY[Frustum::PLANE_COUNT];
+    Float planeZ[Frustum::PLANE_COUNT];
+    Float planeW[Frustum::PLANE_COUNT];
+    for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+        planeX[p] = Ops::set(frustum.planes[p].x);
+        planeY[p] = Ops::set(frustum.planes[p].y);
+        planeZ[p] = Ops::set(frustum.planes[p].z);
+        planeW[p] = Ops::set(frustum.planes[p].w);
+    }
+
+    const size_t blockEnd = size() - size() % Ops::width;
+    for (; begin < blockEnd; begin += Ops::width) {
+        const Float x = Ops::load(&centerX[begin]);
+        const Float y = Ops::load(&centerY[begin]);
+        const Float z = Ops::load(&centerZ[begin]);
+        const Float negRadius = Ops::neg(Ops::load(&radius[begin]));
+
+        Float inside = Ops::allTrue();
+        for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+            Float distance = Ops::madd(planeX[p], x, planeW[p]);
+            distance = Ops::madd(planeY[p], y, distance);
+            distance = Ops::madd(planeZ[p], z, distance);
+            inside =
+                Ops::bitAnd(inside, Ops::greaterEqual(distance, negRadius));
+        }
+
+        int bits = Ops::mask(inside);
+        while (bits != 0) {
+            const int lane = __builtin_ctz(static_cast<unsigned>(bits));
+            visible.push_back(static_cast<uint32_t>(begin + lane));
+            bits &= bits - 1;
+        }
+    }
+#endif
+
+    cullRange(*this, frustum, begin, visible);
+    return visible.size();
+}
+
+size_t CullingBatch::cullScalar(const Frustum& frustum,
+                                std::vector<uint32_t>& visible) const {
+    visible.clear();
+    cullRange(*this, frustum, 0, visible);
+    return visible.size();
+}
+
+int CullingBatch::simdWidth() {
+#if defined(LVE_CULLING_AVX2) || defined(LVE_CULLING_SSE2)
+    return SimdOps::width;
+#else
+    return 1;
+#endif
+}
+
+}  // namespace lve
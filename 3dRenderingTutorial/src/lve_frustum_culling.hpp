@@ -0,0 +1,65 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Six world-space planes (left, right, bottom, top, near, far) as
+// (normal, distance) with normals pointing into the frustum, so a point p is
+// inside a plane when dot(normal, p) + distance >= 0.
+struct Frustum {
+    enum Plane {
+        PLANE_LEFT = 0,
+        PLANE_RIGHT,
+        PLANE_BOTTOM,
+        PLANE_TOP,
+        PLANE_NEAR,
+        PLANE_FAR,
+        PLANE_COUNT
+    };
+
+    std::array<glm::vec4, PLANE_COUNT> planes{};
+
+    // Gribb/Hartmann extraction from a projection * view matrix using the
+    // 0..1 clip depth range of GLM_FORCE_DEPTH_ZERO_TO_ONE.
+    static Frustum fromProjectionView(const glm::mat4& projectionView);
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+};
+
+// Structure-of-arrays list of world-space bounding spheres culled against a
+// frustum several at a time, with the same SIMD width selection as
+// TransformBatch. Only needs GLM, so it is checked without a device by
+// make check.
+struct CullingBatch {
+    std::vector<float> centerX{};
+    std::vector<float> centerY{};
+    std::vector<float> centerZ{};
+    std::vector<float> radius{};
+
+    size_t size() const { return centerX.size(); }
+    void clear();
+    void reserve(size_t count);
+    void push_back(const glm::vec3& center, float sphereRadius);
+
+    // Replaces the contents of visible with the indices of all spheres that
+    // intersect the frustum, in ascending order. Returns visible.size().
+    size_t cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+    // One sphere at a time, for the remainder lanes and for checking the
+    // SIMD path.
+    size_t cullScalar(const Frustum& frustum,
+                      std::vector<uint32_t>& visible) const;
+
+    // Number of spheres tested per SIMD iteration in this build.
+    static int simdWidth();
+};
+
+}  // namespace lve
@@ -0,0 +1,51 @@
+#include "lve_game_object.hpp"
+
+namespace lve {
+
+glm::mat4 LveGameObject::TransformComponent::computeMatrix() const {
+    const float c3 = glm::cos(rotation.z);
+    const float s3 = glm::sin(rotation.z);
+    const float c2 = glm::cos(rotation.x);
+    const float s2 = glm::sin(rotation.x);
+    const float c1 = glm::cos(rotation.y);
+    const float s1 = glm::sin(rotation.y);
+    return glm::mat4{
+        {
+            scale.x * (c1 * c3 + s1 * s2 * s3),
+            scale.x * (c2 * s3),
+            scale.x * (c1 * s2 * s3 - c3 * s1),
+            0.0f,
+        },
+        {
+            scale.y * (c3 * s1 * s2 - c1 * s3),
+            scale.y * (c2 * c3),
+            scale.y * (c1 * c3 * s2 + s1 * s3),
+            0.0f,
+        },
+        {
+            scale.z * (c2 * s1),
+            scale.z * (-s2),
+            scale.z * (c1 * c2),
+            0.0f,
+        },
+        {translation.x, translation.y, translation.z, 1.0f}};
+}
+
+void LveGameObject::TransformComponent::updateCache(const glm::mat4& matrix) {
+    worldMatrix = matrix;
+
+    // Column i of the world matrix is scale[i] * R[i], so dividing by
+    // scale[i]^2 gives R[i] / scale[i] without any trig or inverse. A zero
+    // scale has no inverse; its column is left zero instead of Inf/NaN.
+    for (int i = 0; i < 3; i++) {
+        const float scaleSquared = scale[i] * scale[i];
+        normalMatrix_[i] = scaleSquared > 0.f
+                               ? glm::vec3(matrix[i]) / scaleSquared
+                               : glm::vec3{0.f};
+    }
+
+    dirty = false;
+    version++;
+}
+
+}  // namespace lve
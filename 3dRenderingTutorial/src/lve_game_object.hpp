@@ -7,42 +7,64 @@
 
 namespace lve {
 class LveGameObject {
+    // Caches the world and normal matrix; they are only rebuilt after a
+    // setter actually changed translation, rotation or scale. Every rebuild
+    // bumps the version so GPU-side copies can tell when they are stale.
     struct TransformComponent {
-        glm::vec3 translation{};  // position offset
-        glm::vec3 scale{1.f, 1.f, 1.f};
-        glm::vec3 rotation{};
+        const glm::vec3& getTranslation() const { return translation; }
+        const glm::vec3& getRotation() const { return rotation; }
+        const glm::vec3& getScale() const { return scale; }
+
+        void setTranslation(const glm::vec3& value) {
+            if (value != translation) {
+                translation = value;
+                dirty = true;
+            }
+        }
+        void setRotation(const glm::vec3& value) {
+            if (value != rotation) {
+                rotation = value;
+                dirty = true;
+            }
+        }
+        void setScale(const glm::vec3& value) {
+            if (value != scale) {
+                scale = value;
+                dirty = true;
+            }
+        }
 
         // Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
         // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
         // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-        glm::mat4 mat4() {
-            const float c3 = glm::cos(rotation.z);
-            const float s3 = glm::sin(rotation.z);
-            const float c2 = glm::cos(rotation.x);
-            const float s2 = glm::sin(rotation.x);
-            const float c1 = glm::cos(rotation.y);
-            const float s1 = glm::sin(rotation.y);
-            return glm::mat4{
-                {
-                    scale.x * (c1 * c3 + s1 * s2 * s3),
-                    scale.x * (c2 * s3),
-                    scale.x * (c1 * s2 * s3 - c3 * s1),
-                    0.0f,
-                },
-                {
-                    scale.y * (c3 * s1 * s2 - c1 * s3),
-                    scale.y * (c2 * c3),
-                    scale.y * (c1 * c3 * s2 + s1 * s3),
-                    0.0f,
-                },
-                {
-                    scale.z * (c2 * s1),
-                    scale.z * (-s2),
-                    scale.z * (c1 * c2),
-                    0.0f,
-                },
-                {translation.x, translation.y, translation.z, 1.0f}};
+        const glm::mat4& mat4() {
+            if (dirty) updateCache(computeMatrix());
+            return worldMatrix;
+        }
+        // Inverse transpose of the upper 3x3, i.e. R * S^-1
+        const glm::mat3& normalMatrix() {
+            if (dirty) updateCache(computeMatrix());
+            return normalMatrix_;
         }
+
+        bool isDirty() const { return dirty; }
+        uint32_t getVersion() const { return version; }
+
+        // Stores a world matrix built elsewhere (e.g. by TransformBatch)
+        // from the current translation, rotation and scale.
+        void updateCache(const glm::mat4& matrix);
+
+       private:
+        glm::mat4 computeMatrix() const;
+
+        glm::vec3 translation{};  // position offset
+        glm::vec3 scale{1.f, 1.f, 1.f};
+        glm::vec3 rotation{};
+
+        glm::mat4 worldMatrix{1.f};
+        glm::mat3 normalMatrix_{1.f};
+        bool dirty = true;
+        uint32_t version = 0;
     };
 
    public:
@@ -68,4 +90,4 @@ class LveGameObject {
     LveGameObject(id_t objId) : id{objId} {};
     id_t id;
 };
-}  // namespace lve
\ No newline at end of file
+}  // namespace lve
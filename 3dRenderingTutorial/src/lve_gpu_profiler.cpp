@@ -0,0 +1,276 @@
+#include "lve_gpu_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace lve {
+
+LveGpuProfiler::LveGpuProfiler(LveDevice& device, uint32_t maxScopesPerFrame)
+    : lveDevice{device}, queriesPerFrame{2 * (maxScopesPerFrame + 1)} {
+    if (lveDevice.hasPipelineStatistics()) {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+        poolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+        if (vkCreateQueryPool(
+                lveDevice.device(), &poolInfo, nullptr, &statisticsPool) !=
+            VK_SUCCESS) {
+            throw std::runtime_error(
+                "Could not create pipeline statistics query pool");
+        }
+    }
+
+    uint32_t validBits = lveDevice.graphicsTimestampValidBits();
+    if (!lveDevice.properties.limits.timestampComputeAndGraphics ||
+        validBits == 0) {
+        return;
+    }
+    timestampMask = validBits >= 64 ? ~uint64_t{0}
+                                    : (uint64_t{1} << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = calibrationQuery() + 1;
+    if (vkCreateQueryPool(lveDevice.device(), &poolInfo, nullptr, &queryPool) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("Could not create timestamp query pool");
+    }
+
+    if (LveCpuProfiler::isEnabled()) {
+        calibrate();
+        traceTrack = LveCpuProfiler::addTrack("GPU graphics queue");
+    }
+}
+
+LveGpuProfiler::~LveGpuProfiler() {
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(lveDevice.device(), queryPool, nullptr);
+    }
+    if (statisticsPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(lveDevice.device(), statisticsPool, nullptr);
+    }
+}
+
+bool LveGpuProfiler::readResults(int frameIndex) {
+    auto& slot = slots[frameIndex];
+    pipelineStatistics.reset();
+    if (!slot.written) return false;
+    slot.written = false;
+
+    // results in the order of the PIPELINE_STATISTICS bits
+    std::array<uint64_t, 7> statistics{};
+    if (statisticsPool != VK_NULL_HANDLE &&
+        vkGetQueryPoolResults(lveDevice.device(),
+                              statisticsPool,
+                              static_cast<uint32_t>(frameIndex),
+                              1,
+                              sizeof(statistics),
+                              statistics.data(),
+                              sizeof(statistics),
+                              VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        pipelineStatistics = PipelineStatistics{statistics[0],
+                                                statistics[1],
+                                                statistics[2],
+                                                statistics[3],
+                                                statistics[4],
+                                                statistics[5],
+                                                statistics[6]};
+    }
+    if (!isSupported()) return false;
+
+    // the frame has completed, but a query may still be unavailable, e.g.
+    // when its scope was never ended; the frame is skipped then
+    std::vector<uint64_t> timestamps(2 * slot.records.size());
+    if (vkGetQueryPoolResults(lveDevice.device(),
+                              queryPool,
+                              firstQuery(frameIndex),
+                              static_cast<uint32_t>(timestamps.size()),
+                              timestamps.size() * sizeof(uint64_t),
+                              timestamps.data(),
+                              sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return false;
+    }
+
+    const float period = lveDevice.properties.limits.timestampPeriod;
+    std::vector<float> frameTimes(histories.size(), -1.f);
+    for (size_t i = 0; i < slot.records.size(); i++) {
+        uint64_t ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) &
+                         timestampMask;
+        float milliseconds = static_cast<float>(ticks) * period / 1e6f;
+        float& total = frameTimes[slot.records[i].scope];
+        total = std::max(total, 0.f) + milliseconds;
+        if (traceTrack != nullptr) {
+            LveCpuProfiler::record(
+                traceTrack,
+                histories[slot.records[i].scope].name.c_str(),
+                toNanoseconds(timestamps[2 * i]) + gpuToCpuNanoseconds,
+                toNanoseconds(timestamps[2 * i + 1]) + gpuToCpuNanoseconds);
+        }
+    }
+    for (size_t scope = 0; scope < histories.size(); scope++) {
+        if (frameTimes[scope] < 0.f) continue;
+        auto& history = histories[scope];
+        if (history.milliseconds.size() < WINDOW) {
+            history.milliseconds.push_back(frameTimes[scope]);
+        } else {
+            history.milliseconds[history.next] = frameTimes[scope];
+        }
+        history.next = (history.next + 1) % WINDOW;
+    }
+    frameMilliseconds = frameTimes[getScope(FRAME_SCOPE)];
+    return true;
+}
+
+void LveGpuProfiler::beginFrame(VkCommandBuffer commandBuffer,
+                                int frameIndex) {
+    assert(this->frameIndex < 0 && "Profiler frame already in progress");
+    if (!isSupported() && statisticsPool == VK_NULL_HANDLE) return;
+
+    // anything not read back by now is dropped
+    auto& slot = slots[frameIndex];
+    slot.records.clear();
+    slot.written = false;
+    this->frameIndex = frameIndex;
+    if (statisticsPool != VK_NULL_HANDLE) {
+        uint32_t query = static_cast<uint32_t>(frameIndex);
+        vkCmdResetQueryPool(commandBuffer, statisticsPool, query, 1);
+        vkCmdBeginQuery(commandBuffer, statisticsPool, query, 0);
+    }
+    if (isSupported()) {
+        vkCmdResetQueryPool(
+            commandBuffer, queryPool, firstQuery(frameIndex), queriesPerFrame);
+        frameScope = beginScope(commandBuffer, FRAME_SCOPE);
+    }
+}
+
+void LveGpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+    // nothing to query on this device
+    if (frameIndex < 0) return;
+
+    if (statisticsPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery(
+            commandBuffer, statisticsPool, static_cast<uint32_t>(frameIndex));
+    }
+    endScope(commandBuffer, frameScope);
+    slots[frameIndex].written = true;
+    frameIndex = -1;
+}
+
+LveGpuProfiler::ScopeHandle LveGpuProfiler::beginScope(
+    VkCommandBuffer commandBuffer, const std::string& name) {
+    if (!isSupported()) return NO_SCOPE;
+    assert(frameIndex >= 0 && "Cannot begin scope when frame not in progress");
+
+    auto& records = slots[frameIndex].records;
+    uint32_t used = 2 * static_cast<uint32_t>(records.size());
+    if (used + 2 > queriesPerFrame) {
+        droppedScopes++;
+        return NO_SCOPE;
+    }
+    uint32_t query = firstQuery(frameIndex) + used;
+    vkCmdWriteTimestamp(
+        commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, query);
+    records.push_back({getScope(name), query});
+    return static_cast<ScopeHandle>(records.size() - 1);
+}
+
+void LveGpuProfiler::endScope(VkCommandBuffer commandBuffer,
+                              ScopeHandle scope) {
+    if (scope == NO_SCOPE) return;
+    assert(frameIndex >= 0 && "Cannot end scope when frame not in progress");
+
+    auto& record = slots[frameIndex].records[scope];
+    assert(!record.ended && "Scope already ended");
+    record.ended = true;
+    vkCmdWriteTimestamp(commandBuffer,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queryPool,
+                        record.beginQuery + 1);
+}
+
+std::vector<LveGpuProfiler::ScopeStats> LveGpuProfiler::getStats() const {
+    std::vector<ScopeStats> stats;
+    for (const auto& history : histories) {
+        ScopeStats scope{};
+        scope.name = history.name;
+        scope.samples = static_cast<uint32_t>(history.milliseconds.size());
+        if (scope.samples > 0) {
+            std::vector<float> sorted = history.milliseconds;
+            std::sort(sorted.begin(), sorted.end());
+            float total = 0.f;
+            for (float milliseconds : sorted) total += milliseconds;
+            // nearest rank
+            size_t rank = static_cast<size_t>(
+                std::ceil(0.99f * static_cast<float>(sorted.size())));
+            scope.minMilliseconds = sorted.front();
+            scope.averageMilliseconds = total / scope.samples;
+            scope.maxMilliseconds = sorted.back();
+            scope.p99Milliseconds = sorted[std::max<size_t>(rank, 1) - 1];
+        }
+        stats.push_back(scope);
+    }
+    return stats;
+}
+
+void LveGpuProfiler::resetStats() {
+    for (auto& history : histories) {
+        history.milliseconds.clear();
+        history.next = 0;
+    }
+    droppedScopes = 0;
+}
+
+void LveGpuProfiler::calibrate() {
+    int64_t narrowestWindow = INT64_MAX;
+    for (int round = 0; round < CALIBRATION_ROUNDS; round++) {
+        VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+        vkCmdResetQueryPool(commandBuffer, queryPool, calibrationQuery(), 1);
+        vkCmdWriteTimestamp(commandBuffer,
+                            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            queryPool,
+                            calibrationQuery());
+        int64_t before = LveCpuProfiler::now();
+        lveDevice.endSingleTimeCommands(commandBuffer);
+        int64_t after = LveCpuProfiler::now();
+
+        uint64_t ticks = 0;
+        if (vkGetQueryPoolResults(lveDevice.device(),
+                                  queryPool,
+                                  calibrationQuery(),
+                                  1,
+                                  sizeof(ticks),
+                                  &ticks,
+                                  sizeof(ticks),
+                                  VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            continue;
+        }
+        if (after - before < narrowestWindow) {
+            narrowestWindow = after - before;
+            gpuToCpuNanoseconds =
+                before + (after - before) / 2 - toNanoseconds(ticks);
+        }
+    }
+}
+
+int64_t LveGpuProfiler::toNanoseconds(uint64_t ticks) const {
+    return static_cast<int64_t>(static_cast<double>(ticks) *
+                                lveDevice.properties.limits.timestampPeriod);
+}
+
+uint32_t LveGpuProfiler::getScope(const std::string& name) {
+    auto found = scopeIds.find(name);
+    if (found != scopeIds.end()) return found->second;
+
+    uint32_t scope = static_cast<uint32_t>(histories.size());
+    histories.push_back({name, {}, 0});
+    scopeIds.emplace(name, scope);
+    return scope;
+}
+
+}  // namespace lve
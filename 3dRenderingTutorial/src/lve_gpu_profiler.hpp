@@ -0,0 +1,207 @@
+#pragma once
+
+#include "lve_cpu_profiler.hpp"
+#include "lve_device.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// GPU time of named scopes of the frame's command buffer, e.g. render
+// passes or groups of draws:
+//   LveGpuProfiler::Scope scope{profiler, commandBuffer, "scene"};
+// Each frame slot has its own range of timestamp queries, read back when
+// the slot comes around again, i.e. framesInFlight frames later, without
+// waiting. The times are kept for the last WINDOW frames of each scope.
+//
+// A scope starts at the top of the pipe and ends at the bottom, so work
+// recorded before and after it can overlap its ends. Only commands of the
+// frame's primary command buffer are timed, and not inside a render pass
+// that executes secondary command buffers. Without timestamps on the
+// graphics queue every call does nothing.
+//
+// With LVE_CPU_PROFILING the scopes also go to an LveCpuProfiler track,
+// converted to its clock by a calibration at startup: the GPU clock is
+// sampled between two CPU times, so the GPU zones are off by up to half
+// that window and drift slowly over long captures.
+//
+// When the device has pipeline statistics, each frame also counts the
+// PIPELINE_STATISTICS of all its commands, read back with the timestamps.
+class LveGpuProfiler {
+   public:
+    using ScopeHandle = uint32_t;
+    // Returned when a frame has no queries left for another scope
+    static constexpr ScopeHandle NO_SCOPE = UINT32_MAX;
+    // Frames the statistics are taken over
+    static constexpr uint32_t WINDOW = 128;
+    // Clock samples taken at startup, the narrowest window is kept
+    static constexpr int CALIBRATION_ROUNDS = 4;
+    // Scope around the whole frame, from beginFrame to endFrame
+    static constexpr const char* FRAME_SCOPE = "frame";
+    // Counted for each frame; secondary command buffers executed in it
+    // must inherit them
+    static constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    // What the GPU did for one frame
+    struct PipelineStatistics {
+        uint64_t inputAssemblyVertices = 0;
+        uint64_t inputAssemblyPrimitives = 0;
+        uint64_t vertexShaderInvocations = 0;
+        // primitives reaching clipping, and those left after it
+        uint64_t clippingInvocations = 0;
+        uint64_t clippingPrimitives = 0;
+        uint64_t fragmentShaderInvocations = 0;
+        uint64_t computeShaderInvocations = 0;
+
+        PipelineStatistics& operator+=(const PipelineStatistics& other) {
+            inputAssemblyVertices += other.inputAssemblyVertices;
+            inputAssemblyPrimitives += other.inputAssemblyPrimitives;
+            vertexShaderInvocations += other.vertexShaderInvocations;
+            clippingInvocations += other.clippingInvocations;
+            clippingPrimitives += other.clippingPrimitives;
+            fragmentShaderInvocations += other.fragmentShaderInvocations;
+            computeShaderInvocations += other.computeShaderInvocations;
+            return *this;
+        }
+    };
+
+    struct ScopeStats {
+        std::string name;
+        // Frames of the window the scope was recorded in; several scopes
+        // of the same name in one frame count as one sample
+        uint32_t samples = 0;
+        float minMilliseconds = 0.f;
+        float averageMilliseconds = 0.f;
+        float maxMilliseconds = 0.f;
+        float p99Milliseconds = 0.f;
+    };
+
+    class Scope {
+       public:
+        Scope(LveGpuProfiler& profiler,
+              VkCommandBuffer commandBuffer,
+              const std::string& name)
+            : profiler{profiler},
+              commandBuffer{commandBuffer},
+              handle{profiler.beginScope(commandBuffer, name)} {}
+        ~Scope() { profiler.endScope(commandBuffer, handle); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+       private:
+        LveGpuProfiler& profiler;
+        VkCommandBuffer commandBuffer;
+        ScopeHandle handle;
+    };
+
+    explicit LveGpuProfiler(LveDevice& device, uint32_t maxScopesPerFrame = 64);
+    ~LveGpuProfiler();
+
+    LveGpuProfiler(const LveGpuProfiler&) = delete;
+    LveGpuProfiler& operator=(const LveGpuProfiler&) = delete;
+
+    // Whether the graphics queue has timestamps
+    bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+    bool hasPipelineStatistics() const {
+        return statisticsPool != VK_NULL_HANDLE;
+    }
+
+    // Once the frame that last used frameIndex has completed and before
+    // beginFrame records it again. Returns whether that frame's times were
+    // available and added to the statistics.
+    bool readResults(int frameIndex);
+    // Resets the slot's queries and begins FRAME_SCOPE; outside of any
+    // render pass
+    void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+    void endFrame(VkCommandBuffer commandBuffer);
+
+    ScopeHandle beginScope(VkCommandBuffer commandBuffer,
+                           const std::string& name);
+    void endScope(VkCommandBuffer commandBuffer, ScopeHandle scope);
+
+    // GPU time of the frame last read by readResults
+    float getFrameMilliseconds() const { return frameMilliseconds; }
+    // Of the frame the last readResults read, when it had them
+    std::optional<PipelineStatistics> getPipelineStatistics() const {
+        return pipelineStatistics;
+    }
+    // In the order the scopes were first recorded
+    std::vector<ScopeStats> getStats() const;
+    // Forgets the times, e.g. after switching to different rendering
+    void resetStats();
+    // Scopes not timed because their frame ran out of queries
+    uint32_t getDroppedScopes() const { return droppedScopes; }
+
+   private:
+    struct Record {
+        uint32_t scope;
+        // the end timestamp is the query after it
+        uint32_t beginQuery;
+        bool ended = false;
+    };
+
+    // Recorded scopes of one frame slot
+    struct Slot {
+        std::vector<Record> records;
+        bool written = false;
+    };
+
+    // Times of one scope name over the last WINDOW frames
+    struct History {
+        std::string name;
+        std::vector<float> milliseconds;
+        size_t next = 0;
+    };
+
+    uint32_t firstQuery(int frameIndex) const {
+        return static_cast<uint32_t>(frameIndex) * queriesPerFrame;
+    }
+    // after the queries of the frame slots
+    uint32_t calibrationQuery() const {
+        return LveSwapChain::MAX_FRAMES_IN_FLIGHT * queriesPerFrame;
+    }
+    uint32_t getScope(const std::string& name);
+    // Sets gpuToCpuNanoseconds
+    void calibrate();
+    // GPU clock, without the offset to the CPU one
+    int64_t toNanoseconds(uint64_t ticks) const;
+
+    LveDevice& lveDevice;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    // one query per frame slot
+    VkQueryPool statisticsPool = VK_NULL_HANDLE;
+    uint32_t queriesPerFrame;
+    uint64_t timestampMask = 0;
+    std::array<Slot, LveSwapChain::MAX_FRAMES_IN_FLIGHT> slots{};
+    // recording frame, -1 between endFrame and beginFrame
+    int frameIndex = -1;
+    ScopeHandle frameScope = NO_SCOPE;
+
+    // a deque keeps the names in place for the trace track
+    std::deque<History> histories;
+    std::unordered_map<std::string, uint32_t> scopeIds;
+    float frameMilliseconds = 0.f;
+    std::optional<PipelineStatistics> pipelineStatistics;
+    uint32_t droppedScopes = 0;
+    // nullptr without LVE_CPU_PROFILING
+    LveCpuProfiler::Track* traceTrack = nullptr;
+    int64_t gpuToCpuNanoseconds = 0;
+};
+
+}  // namespace lve
@@ -26,7 +26,9 @@ struct hash<lve::LveModel::Vertex> {
 
 namespace lve {
 LveModel::LveModel(LveDevice& device, const Builder& builder)
-    : lveDevice{device} {
+    : lveDevice{device},
+      boundingBox{builder.boundingBox},
+      boundingSphere{builder.boundingSphere} {
     createVertexBuffers(builder.vertices);
     createIndexBuffer(builder.indices);
 }
@@ -122,15 +124,62 @@ void LveModel::createIndexBuffer(const std::vector<uint32_t>& indices) {
     vkFreeMemory(lveDevice.device(), stagingBufferMemory, nullptr);
 }
 
-void LveModel::draw(VkCommandBuffer commandBuffer) {
+void LveModel::draw(VkCommandBuffer commandBuffer,
+                    uint32_t instanceCount,
+                    uint32_t firstInstance) {
+    // triangle lists
+    auto& counters = lveDevice.counters();
+    counters.add(LveCounters::DRAWS);
+    counters.add(LveCounters::INSTANCES, instanceCount);
+    counters.add(LveCounters::TRIANGLES,
+                 uint64_t{hasIndexBuffer ? indexCount : vertexCount} / 3 *
+                     instanceCount);
     if (hasIndexBuffer) {
-        vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+        vkCmdDrawIndexed(
+            commandBuffer, indexCount, instanceCount, 0, 0, firstInstance);
     } else {
-        vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+        vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
+    }
+}
+
+VkDrawIndexedIndirectCommand LveModel::getIndirectCommand(
+    uint32_t firstInstance) const {
+    VkDrawIndexedIndirectCommand command{};
+    if (hasIndexBuffer) {
+        command.indexCount = indexCount;
+        command.instanceCount = 1;
+        command.firstIndex = 0;
+        command.vertexOffset = 0;
+        command.firstInstance = firstInstance;
+    } else {
+        VkDrawIndirectCommand drawCommand{};
+        drawCommand.vertexCount = vertexCount;
+        drawCommand.instanceCount = 1;
+        drawCommand.firstVertex = 0;
+        drawCommand.firstInstance = firstInstance;
+        memcpy(&command, &drawCommand, sizeof(drawCommand));
+    }
+    return command;
+}
+
+void LveModel::drawIndirect(VkCommandBuffer commandBuffer,
+                            VkBuffer buffer,
+                            VkDeviceSize offset) {
+    lveDevice.counters().add(LveCounters::INDIRECT_DRAWS);
+    if (hasIndexBuffer) {
+        vkCmdDrawIndexedIndirect(commandBuffer,
+                                 buffer,
+                                 offset,
+                                 1,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        vkCmdDrawIndirect(
+            commandBuffer, buffer, offset, 1, sizeof(VkDrawIndirectCommand));
     }
 }
 
 void LveModel::bind(VkCommandBuffer commandBuffer) {
+    lveDevice.counters().add(LveCounters::VERTEX_BUFFER_BINDS);
     VkBuffer buffers[] = {vertexBuffer, indexBuffer};
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
@@ -152,7 +201,7 @@ LveModel::Vertex::getBindingDescriptions() {
 
 std::vector<VkVertexInputAttributeDescription>
 LveModel::Vertex::getAttributeDescriptions() {
-    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
     attributeDescriptions[0].binding = 0;
     attributeDescriptions[0].location = 0;
     attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -163,6 +212,11 @@ LveModel::Vertex::getAttributeDescriptions() {
     attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
     attributeDescriptions[1].offset = offsetof(Vertex, color);
 
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(Vertex, normal);
+
     return attributeDescriptions;
 }
 
@@ -230,6 +284,32 @@ void LveModel::Builder::loadModel(const std::string& filePath) {
             indices.push_back(uniqueVertices[vertex]);
         }
     }
+
+    computeBounds();
+}
+
+void LveModel::Builder::computeBounds() {
+    boundingBox = BoundingBox{};
+    boundingSphere = BoundingSphere{};
+    if (vertices.empty()) {
+        return;
+    }
+
+    boundingBox.min = boundingBox.max = vertices[0].position;
+    for (const auto& vertex : vertices) {
+        boundingBox.min = glm::min(boundingBox.min, vertex.position);
+        boundingBox.max = glm::max(boundingBox.max, vertex.position);
+    }
+
+    // Centered on the box, which is tighter than the box's own circumsphere
+    // for most meshes and cheap to compute.
+    boundingSphere.center = 0.5f * (boundingBox.min + boundingBox.max);
+    float radiusSquared = 0.f;
+    for (const auto& vertex : vertices) {
+        glm::vec3 offset = vertex.position - boundingSphere.center;
+        radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+    }
+    boundingSphere.radius = glm::sqrt(radiusSquared);
 }
 
 }  // namespace lve
\ No newline at end of file
@@ -28,11 +28,26 @@ class LveModel {
         }
     };
 
+    // Local-space bounds of the vertex positions
+    struct BoundingBox {
+        glm::vec3 min{0.f};
+        glm::vec3 max{0.f};
+    };
+    struct BoundingSphere {
+        glm::vec3 center{0.f};
+        float radius = 0.f;
+    };
+
     struct Builder {
         std::vector<Vertex> vertices{};
         std::vector<uint32_t> indices{};
+        BoundingBox boundingBox{};
+        BoundingSphere boundingSphere{};
 
         void loadModel(const std::string& filePath);
+        // Fills boundingBox and boundingSphere from vertices; loadModel
+        // calls it, hand-built builders should too.
+        void computeBounds();
     };
 
     LveModel(LveDevice& device, const LveModel::Builder& builder);
@@ -43,8 +58,24 @@ class LveModel {
     static std::unique_ptr<LveModel> createModelFromFile(
         LveDevice& device, const std::string& filePath);
 
+    const BoundingBox& getBoundingBox() const { return boundingBox; }
+    const BoundingSphere& getBoundingSphere() const { return boundingSphere; }
+
     void bind(VkCommandBuffer commandBuffer);
-    void draw(VkCommandBuffer commandBuffer);
+    void draw(VkCommandBuffer commandBuffer,
+              uint32_t instanceCount = 1,
+              uint32_t firstInstance = 0);
+
+    // Parameters for drawing one instance through drawIndirect. Models
+    // without an index buffer fill the leading VkDrawIndirectCommand
+    // fields instead, so instanceCount is at the same offset either way.
+    VkDrawIndexedIndirectCommand getIndirectCommand(
+        uint32_t firstInstance) const;
+    // Draws with the command written at offset, as laid out by
+    // getIndirectCommand.
+    void drawIndirect(VkCommandBuffer commandBuffer,
+                      VkBuffer buffer,
+                      VkDeviceSize offset);
 
    private:
     void createVertexBuffers(const std::vector<Vertex>& vertices);
@@ -59,5 +90,8 @@ class LveModel {
     VkBuffer indexBuffer;
     VkDeviceMemory indexBufferMemory;
     uint32_t indexCount;
+
+    BoundingBox boundingBox;
+    BoundingSphere boundingSphere;
 };
 }  // namespace lve
\ No newline at end of file
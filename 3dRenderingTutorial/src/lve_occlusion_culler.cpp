@@ -0,0 +1,705 @@
+#include "lve_occlusion_culler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include "lve_swap_chain.hpp"
+#include "lve_timeline.hpp"
+
+namespace lve {
+
+namespace {
+
+constexpr uint32_t CULL_GROUP_SIZE = 64;
+constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+
+uint32_t previousPowerOfTwo(uint32_t value) {
+    uint32_t result = 1;
+    while (result * 2 <= value) {
+        result *= 2;
+    }
+    return result;
+}
+
+bool hasStencilComponent(VkFormat format) {
+    return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+           format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+void computeBarrier(VkCommandBuffer commandBuffer,
+                    VkPipelineStageFlags dstStageMask,
+                    VkAccessFlags dstAccessMask) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = dstAccessMask;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         dstStageMask,
+                         0,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+}
+
+}  // namespace
+
+LveOcclusionCuller::LveOcclusionCuller(LveDevice& device,
+                                       uint32_t maxObjects,
+                                       LveAsyncCompute* asyncCompute)
+    : lveDevice{device}, maxObjects{maxObjects}, asyncCompute{asyncCompute} {
+    createBuffers();
+    createDescriptorSetLayouts();
+    createPipelineLayouts();
+    createPipelines();
+    createSampler();
+
+    const uint32_t frames = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+    descriptorPool =
+        LveDescriptorPool::Builder(lveDevice)
+            .setMaxSets(frames * (MAX_PYRAMID_LEVELS + 1))
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                         frames * (MAX_PYRAMID_LEVELS + 1))
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                         frames * MAX_PYRAMID_LEVELS)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames * 4)
+            .build();
+}
+
+LveOcclusionCuller::~LveOcclusionCuller() {
+    destroyPyramid();
+    vkDestroySampler(lveDevice.device(), pyramidSampler, nullptr);
+    vkDestroyPipelineLayout(lveDevice.device(), reducePipelineLayout, nullptr);
+    vkDestroyPipelineLayout(lveDevice.device(), cullPipelineLayout, nullptr);
+}
+
+void LveOcclusionCuller::createBuffers() {
+    const uint32_t frames = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+    candidateBuffers.resize(frames);
+    earlyDrawBuffers.resize(frames);
+    lateDrawBuffers.resize(frames);
+    statsBuffers.resize(frames);
+    statsWritten.resize(frames, false);
+
+    for (uint32_t i = 0; i < frames; i++) {
+        candidateBuffers[i] =
+            std::make_unique<LveBuffer>(lveDevice,
+                                        sizeof(Candidate),
+                                        maxObjects,
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        candidateBuffers[i]->map();
+
+        earlyDrawBuffers[i] = std::make_unique<LveBuffer>(
+            lveDevice,
+            sizeof(VkDrawIndexedIndirectCommand),
+            maxObjects,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        earlyDrawBuffers[i]->map();
+
+        lateDrawBuffers[i] = std::make_unique<LveBuffer>(
+            lveDevice,
+            sizeof(VkDrawIndexedIndirectCommand),
+            maxObjects,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        lateDrawBuffers[i]->map();
+
+        statsBuffers[i] =
+            std::make_unique<LveBuffer>(lveDevice,
+                                        sizeof(Stats),
+                                        1,
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        statsBuffers[i]->map();
+    }
+}
+
+void LveOcclusionCuller::createDescriptorSetLayouts() {
+    reduceSetLayout =
+        LveDescriptorSetLayout::Builder(lveDevice)
+            .addBinding(0,
+                        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(
+                1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+
+    cullSetLayout =
+        LveDescriptorSetLayout::Builder(lveDevice)
+            .addBinding(0,
+                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1,
+                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2,
+                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3,
+                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4,
+                        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+}
+
+void LveOcclusionCuller::createPipelineLayouts() {
+    auto createLayout = [&](VkDescriptorSetLayout setLayout,
+                            uint32_t pushSize,
+                            VkPipelineLayout& layout) {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = pushSize;
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(
+                lveDevice.device(), &pipelineLayoutInfo, nullptr, &layout) !=
+            VK_SUCCESS) {
+            throw std::runtime_error(
+                "Failed to create occlusion culling pipeline layout");
+        }
+    };
+
+    createLayout(reduceSetLayout->getDescriptorSetLayout(),
+                 sizeof(ReducePush),
+                 reducePipelineLayout);
+    createLayout(cullSetLayout->getDescriptorSetLayout(),
+                 sizeof(CullPush),
+                 cullPipelineLayout);
+}
+
+void LveOcclusionCuller::createPipelines() {
+    reducePipeline = std::make_unique<LveComputePipeline>(
+        lveDevice, "shaders/hiz_reduce.comp.spv", reducePipelineLayout);
+    cullPipeline = std::make_unique<LveComputePipeline>(
+        lveDevice, "shaders/occlusion_cull.comp.spv", cullPipelineLayout);
+}
+
+void LveOcclusionCuller::createSampler() {
+    // Only read with texelFetch, the sampler is required by the descriptor
+    // type but never filters.
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = static_cast<float>(MAX_PYRAMID_LEVELS);
+
+    if (vkCreateSampler(
+            lveDevice.device(), &samplerInfo, nullptr, &pyramidSampler) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("Failed to create depth pyramid sampler");
+    }
+}
+
+void LveOcclusionCuller::createPyramid(VkExtent2D extent) {
+    maxExtent = extent;
+    pyramidExtent = {previousPowerOfTwo(extent.width),
+                     previousPowerOfTwo(extent.height)};
+    pyramidLevels = 1;
+    while (pyramidLevels < MAX_PYRAMID_LEVELS &&
+           (pyramidExtent.width >> pyramidLevels) +
+                   (pyramidExtent.height >> pyramidLevels) >
+               0) {
+        pyramidLevels++;
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = pyramidExtent.width;
+    imageInfo.extent.height = pyramidExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = pyramidLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    lveDevice.createImageWithInfo(imageInfo,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                  pyramidImage,
+                                  pyramidImageMemory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = pyramidImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = pyramidLevels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(
+            lveDevice.device(), &viewInfo, nullptr, &pyramidView) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("Failed to create depth pyramid view");
+    }
+
+    pyramidLevelViews.resize(pyramidLevels);
+    for (uint32_t level = 0; level < pyramidLevels; level++) {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        if (vkCreateImageView(lveDevice.device(),
+                              &viewInfo,
+                              nullptr,
+                              &pyramidLevelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error(
+                "Failed to create depth pyramid level view");
+        }
+    }
+
+    // The pyramid stays in GENERAL: it is written as a storage image and
+    // read with texelFetch, level by level.
+    VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pyramidImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = pyramidLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier);
+    lveDevice.endSingleTimeCommands(commandBuffer);
+
+    pyramidValid = false;
+    writeDescriptorSets();
+}
+
+void LveOcclusionCuller::destroyPyramid() {
+    for (auto levelView : pyramidLevelViews) {
+        vkDestroyImageView(lveDevice.device(), levelView, nullptr);
+    }
+    pyramidLevelViews.clear();
+    if (pyramidImage != VK_NULL_HANDLE) {
+        vkDestroyImageView(lveDevice.device(), pyramidView, nullptr);
+        vkDestroyImage(lveDevice.device(), pyramidImage, nullptr);
+        vkFreeMemory(lveDevice.device(), pyramidImageMemory, nullptr);
+        pyramidImage = VK_NULL_HANDLE;
+    }
+}
+
+void LveOcclusionCuller::writeDescriptorSets() {
+    descriptorPool->resetPool();
+
+    const uint32_t frames = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+    reduceDescriptorSets.assign(
+        frames, std::vector<VkDescriptorSet>(pyramidLevels));
+    cullDescriptorSets.resize(frames);
+
+    VkDescriptorImageInfo pyramidInfo{};
+    pyramidInfo.sampler = pyramidSampler;
+    pyramidInfo.imageView = pyramidView;
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        // Level 0 reads the depth attachment of whichever swapchain image
+        // is rendered, its source is rewritten in cullLate.
+        for (uint32_t level = 0; level < pyramidLevels; level++) {
+            VkDescriptorImageInfo srcInfo{};
+            srcInfo.sampler = pyramidSampler;
+            srcInfo.imageView = pyramidLevelViews[level == 0 ? 0 : level - 1];
+            srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            VkDescriptorImageInfo dstInfo{};
+            dstInfo.imageView = pyramidLevelViews[level];
+            dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            if (!LveDescriptorWriter(*reduceSetLayout, *descriptorPool)
+                     .writeImage(0, &srcInfo)
+                     .writeImage(1, &dstInfo)
+                     .build(reduceDescriptorSets[frame][level])) {
+                throw std::runtime_error(
+                    "Failed to allocate depth pyramid descriptor set");
+            }
+        }
+
+        auto candidateInfo = candidateBuffers[frame]->descriptorInfo();
+        auto earlyDrawInfo = earlyDrawBuffers[frame]->descriptorInfo();
+        auto lateDrawInfo = lateDrawBuffers[frame]->descriptorInfo();
+        auto statsInfo = statsBuffers[frame]->descriptorInfo();
+        if (!LveDescriptorWriter(*cullSetLayout, *descriptorPool)
+                 .writeBuffer(0, &candidateInfo)
+                 .writeBuffer(1, &earlyDrawInfo)
+                 .writeBuffer(2, &lateDrawInfo)
+                 .writeBuffer(3, &statsInfo)
+                 .writeImage(4, &pyramidInfo)
+                 .build(cullDescriptorSets[frame])) {
+            throw std::runtime_error(
+                "Failed to allocate occlusion culling descriptor set");
+        }
+    }
+}
+
+void LveOcclusionCuller::beginFrame(int frame,
+                                    VkExtent2D extent,
+                                    VkExtent2D renderedExtent) {
+    assert(frame >= 0 && frame < LveSwapChain::MAX_FRAMES_IN_FLIGHT &&
+           "Frame index out of range");
+    assert(renderedExtent.width <= extent.width &&
+           renderedExtent.height <= extent.height &&
+           "Rendered extent exceeds the depth image");
+    frameIndex = frame;
+    candidateCount = 0;
+    depthExtent = renderedExtent;
+
+    if (pyramidImage == VK_NULL_HANDLE || extent.width != maxExtent.width ||
+        extent.height != maxExtent.height) {
+        // rare (resize), the other frames in flight may still read the
+        // pyramid and its descriptor sets
+        auto& timeline = lveDevice.timeline();
+        timeline.wait(timeline.getSubmittedValue());
+        // the new pyramid holds nothing yet, the compute queue takes it
+        // without an ownership transfer
+        if (asyncCompute != nullptr) asyncCompute->cancelHandoffs(pyramidImage);
+        destroyPyramid();
+        createPyramid(extent);
+    }
+
+    auto& statsBuffer = *statsBuffers[frameIndex];
+    if (statsWritten[frameIndex]) {
+        memcpy(&stats, statsBuffer.getMappedMemory(), sizeof(Stats));
+    }
+    Stats cleared{};
+    statsBuffer.writeToBuffer(&cleared, sizeof(Stats));
+    statsWritten[frameIndex] = false;
+}
+
+void LveOcclusionCuller::addCandidate(uint32_t slot,
+                                      const glm::vec3& center,
+                                      float radius,
+                                      const LveModel& model) {
+    assert(slot < maxObjects && "Object slot exceeds occlusion culler size");
+    assert(candidateCount < maxObjects && "Too many occlusion candidates");
+
+    Candidate candidate{};
+    candidate.sphere = glm::vec4{center, radius};
+    candidate.slot = slot;
+    candidateBuffers[frameIndex]->writeToIndex(&candidate, candidateCount);
+    candidateCount++;
+
+    // The culling pass only writes instanceCount
+    VkDrawIndexedIndirectCommand command = model.getIndirectCommand(slot);
+    command.instanceCount = 0;
+    earlyDrawBuffers[frameIndex]->writeToIndex(&command, slot);
+    lateDrawBuffers[frameIndex]->writeToIndex(&command, slot);
+}
+
+void LveOcclusionCuller::dispatchCull(VkCommandBuffer commandBuffer,
+                                      uint32_t latePhase) {
+    CullPush push{};
+    push.projectionView = projectionView;
+    push.pyramidSize = glm::vec2{static_cast<float>(pyramidRegion.width),
+                                 static_cast<float>(pyramidRegion.height)};
+    push.pyramidLevels = pyramidValid ? pyramidLevels : 0;
+    push.candidateCount = candidateCount;
+    push.latePhase = latePhase;
+
+    cullPipeline->bind(commandBuffer);
+    auto& counters = lveDevice.counters();
+    counters.add(LveCounters::DESCRIPTOR_SET_BINDS);
+    counters.add(LveCounters::PUSH_CONSTANT_BYTES, sizeof(CullPush));
+    counters.add(LveCounters::DISPATCHES);
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            cullPipelineLayout,
+                            0,
+                            1,
+                            &cullDescriptorSets[frameIndex],
+                            0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer,
+                       cullPipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(CullPush),
+                       &push);
+    vkCmdDispatch(commandBuffer,
+                  (candidateCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE,
+                  1,
+                  1);
+}
+
+void LveOcclusionCuller::cullEarly(VkCommandBuffer commandBuffer,
+                                   const glm::mat4& frameProjectionView) {
+    projectionView = frameProjectionView;
+
+    candidateBuffers[frameIndex]->flush();
+    earlyDrawBuffers[frameIndex]->flush();
+    lateDrawBuffers[frameIndex]->flush();
+    statsWritten[frameIndex] = true;
+
+    VkCommandBuffer cullCommandBuffer =
+        asyncCompute != nullptr ? asyncCompute->getCommandBuffer()
+                                : commandBuffer;
+    if (candidateCount > 0) {
+        // pyramid written by the previous frame's cullLate
+        computeBarrier(cullCommandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_ACCESS_SHADER_READ_BIT);
+        dispatchCull(cullCommandBuffer, 0);
+    }
+
+    if (asyncCompute != nullptr) {
+        // acquired by commandBuffer, made visible to the draws there
+        std::vector<LveAsyncCompute::BufferHandoff> buffers;
+        std::vector<LveAsyncCompute::ImageHandoff> images;
+        getHandoffs(true, buffers, images);
+        asyncCompute->handOffToGraphics(buffers, images);
+    } else if (candidateCount > 0) {
+        computeBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+    }
+}
+
+void LveOcclusionCuller::endFrame(VkCommandBuffer commandBuffer) {
+    if (asyncCompute == nullptr) return;
+
+    std::vector<LveAsyncCompute::BufferHandoff> buffers;
+    std::vector<LveAsyncCompute::ImageHandoff> images;
+    getHandoffs(false, buffers, images);
+    asyncCompute->handOffToCompute(commandBuffer, buffers, images);
+}
+
+void LveOcclusionCuller::getHandoffs(
+    bool toGraphics,
+    std::vector<LveAsyncCompute::BufferHandoff>& buffers,
+    std::vector<LveAsyncCompute::ImageHandoff>& images) {
+    // the early phase only runs compute shaders; the graphics queue also
+    // draws indirectly from the draw buffers
+    const VkPipelineStageFlags computeStages =
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkPipelineStageFlags graphicsStages =
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkAccessFlags computeAccess =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    const VkAccessFlags graphicsAccess =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | computeAccess;
+
+    for (auto* buffer : {candidateBuffers[frameIndex].get(),
+                         earlyDrawBuffers[frameIndex].get(),
+                         lateDrawBuffers[frameIndex].get(),
+                         statsBuffers[frameIndex].get()}) {
+        LveAsyncCompute::BufferHandoff handoff{};
+        handoff.buffer = buffer->getBuffer();
+        handoff.srcStages = toGraphics ? computeStages : graphicsStages;
+        handoff.srcAccess = VK_ACCESS_SHADER_WRITE_BIT;
+        handoff.dstStages = toGraphics ? graphicsStages : computeStages;
+        handoff.dstAccess = toGraphics ? graphicsAccess : computeAccess;
+        buffers.push_back(handoff);
+    }
+
+    LveAsyncCompute::ImageHandoff pyramid{};
+    pyramid.image = pyramidImage;
+    pyramid.range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1};
+    pyramid.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    pyramid.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    pyramid.srcStages = computeStages;
+    pyramid.srcAccess = VK_ACCESS_SHADER_WRITE_BIT;
+    pyramid.dstStages = computeStages;
+    pyramid.dstAccess = computeAccess;
+    images.push_back(pyramid);
+}
+
+void LveOcclusionCuller::cullLate(VkCommandBuffer commandBuffer,
+                                  VkImage depthImage,
+                                  VkImageView depthImageView,
+                                  VkFormat depthFormat,
+                                  bool transitionDepth) {
+    VkImageMemoryBarrier depthBarrier{};
+    depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthBarrier.image = depthImage;
+    depthBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (hasStencilComponent(depthFormat)) {
+        depthBarrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    depthBarrier.subresourceRange.baseMipLevel = 0;
+    depthBarrier.subresourceRange.levelCount = 1;
+    depthBarrier.subresourceRange.baseArrayLayer = 0;
+    depthBarrier.subresourceRange.layerCount = 1;
+
+    // Also orders the early cull's pyramid reads before the rebuild below
+    vkCmdPipelineBarrier(commandBuffer,
+                         transitionDepth
+                             ? VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                             : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         transitionDepth ? 1 : 0,
+                         &depthBarrier);
+
+    VkDescriptorImageInfo depthInfo{};
+    depthInfo.sampler = pyramidSampler;
+    depthInfo.imageView = depthImageView;
+    depthInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    LveDescriptorWriter(*reduceSetLayout, *descriptorPool)
+        .writeImage(0, &depthInfo)
+        .overwrite(reduceDescriptorSets[frameIndex][0]);
+
+    // The same share of the pyramid as the scaled depth has of the depth
+    // image, less than 2 source texels per level 0 texel on each axis
+    pyramidRegion = {
+        std::max((pyramidExtent.width * depthExtent.width + maxExtent.width -
+                  1) / maxExtent.width,
+                 1u),
+        std::max((pyramidExtent.height * depthExtent.height +
+                  maxExtent.height - 1) /
+                     maxExtent.height,
+                 1u)};
+
+    reducePipeline->bind(commandBuffer);
+    VkExtent2D srcExtent = depthExtent;
+    for (uint32_t level = 0; level < pyramidLevels; level++) {
+        VkExtent2D dstExtent{std::max(pyramidRegion.width >> level, 1u),
+                             std::max(pyramidRegion.height >> level, 1u)};
+
+        lveDevice.counters().add(LveCounters::DESCRIPTOR_SET_BINDS);
+        lveDevice.counters().add(LveCounters::PUSH_CONSTANT_BYTES,
+                                 sizeof(ReducePush));
+        lveDevice.counters().add(LveCounters::DISPATCHES);
+        ReducePush push{};
+        push.srcSize[0] = static_cast<int32_t>(srcExtent.width);
+        push.srcSize[1] = static_cast<int32_t>(srcExtent.height);
+        push.dstSize[0] = static_cast<int32_t>(dstExtent.width);
+        push.dstSize[1] = static_cast<int32_t>(dstExtent.height);
+
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                reducePipelineLayout,
+                                0,
+                                1,
+                                &reduceDescriptorSets[frameIndex][level],
+                                0,
+                                nullptr);
+        vkCmdPushConstants(commandBuffer,
+                           reducePipelineLayout,
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(ReducePush),
+                           &push);
+        vkCmdDispatch(
+            commandBuffer,
+            (dstExtent.width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+            (dstExtent.height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+            1);
+        computeBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_ACCESS_SHADER_READ_BIT);
+        srcExtent = dstExtent;
+    }
+    pyramidValid = true;
+
+    if (transitionDepth) {
+        depthBarrier.srcAccessMask = 0;
+        depthBarrier.dstAccessMask =
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        depthBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        depthBarrier.newLayout =
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &depthBarrier);
+    }
+
+    if (candidateCount == 0) {
+        return;
+    }
+    dispatchCull(commandBuffer, 1);
+    computeBarrier(commandBuffer,
+                   VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                   VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+    // the timeline wait in beginFrame alone does not make the counters
+    // available to the host, even on coherent memory
+    VkBufferMemoryBarrier statsBarrier{};
+    statsBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    statsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    statsBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    statsBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    statsBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    statsBarrier.buffer = statsBuffers[frameIndex]->getBuffer();
+    statsBarrier.offset = 0;
+    statsBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         1,
+                         &statsBarrier,
+                         0,
+                         nullptr);
+}
+
+}  // namespace lve
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "lve_async_compute.hpp"
+#include "lve_buffer.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+#include "lve_model.hpp"
+#include "lve_pipeline.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace lve {
+
+// Two-phase Hi-Z occlusion culling on the GPU. Each frame:
+//  1. cullEarly, before the swapchain render pass, tests the candidates
+//     against the depth pyramid left by the previous frame and draws the
+//     visible ones from getEarlyDrawBuffer().
+//  2. cullLate, between endSwapChainRenderPass and
+//     resumeSwapChainRenderPass, rebuilds the pyramid from the early
+//     depth and re-tests everything the early phase rejected; objects that
+//     became visible are drawn from getLateDrawBuffer().
+// Both draw buffers hold one VkDrawIndexedIndirectCommand per object buffer
+// slot (see LveModel::getIndirectCommand); the culling only writes their
+// instanceCount.
+//
+// Given an LveAsyncCompute the early phase runs on the compute queue:
+// cullEarly records into the compute command buffer, and endFrame hands
+// the culling resources back to the compute queue after the late draws.
+class LveOcclusionCuller {
+   public:
+    static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+    // Counters of the last completed frame that used the current frame
+    // index
+    struct Stats {
+        uint32_t tested = 0;        // candidates, i.e. in the frustum
+        uint32_t earlyVisible = 0;  // drawn in the early phase
+        uint32_t disoccluded = 0;   // rejected early, drawn after re-test
+        uint32_t occluded = 0;      // rejected by both phases
+    };
+
+    LveOcclusionCuller(LveDevice& device,
+                       uint32_t maxObjects,
+                       LveAsyncCompute* asyncCompute = nullptr);
+    ~LveOcclusionCuller();
+
+    LveOcclusionCuller(const LveOcclusionCuller&) = delete;
+    LveOcclusionCuller& operator=(const LveOcclusionCuller&) = delete;
+
+    // Must be called after LveRenderer::beginFrame, which waited for the
+    // timeline value of the previous use of frameIndex. Reads back that
+    // frame's stats and rebuilds the pyramid if maxExtent, the size of the
+    // depth image, changed. depthExtent is the part of it rendered this
+    // frame; a new resolution scale only changes the reduced region.
+    void beginFrame(int frameIndex,
+                    VkExtent2D maxExtent,
+                    VkExtent2D depthExtent);
+    void addCandidate(uint32_t slot,
+                      const glm::vec3& center,
+                      float radius,
+                      const LveModel& model);
+    // With async compute, commandBuffer only gets the acquires of the
+    // resources and the dispatch goes to the compute command buffer,
+    // which must be recording
+    void cullEarly(VkCommandBuffer commandBuffer,
+                   const glm::mat4& projectionView);
+    // The depth image must be in DEPTH_STENCIL_ATTACHMENT_OPTIMAL layout and
+    // is returned to it. Without transitionDepth the caller already made
+    // the early depth readable in SHADER_READ_ONLY_OPTIMAL to the compute
+    // stage, and moves it back itself.
+    void cullLate(VkCommandBuffer commandBuffer,
+                  VkImage depthImage,
+                  VkImageView depthImageView,
+                  VkFormat depthFormat,
+                  bool transitionDepth = true);
+    // After the last draw from getLateDrawBuffer
+    void endFrame(VkCommandBuffer commandBuffer);
+
+    VkBuffer getEarlyDrawBuffer() {
+        return earlyDrawBuffers[frameIndex]->getBuffer();
+    }
+    VkBuffer getLateDrawBuffer() {
+        return lateDrawBuffers[frameIndex]->getBuffer();
+    }
+    static VkDeviceSize getDrawOffset(uint32_t slot) {
+        return slot * sizeof(VkDrawIndexedIndirectCommand);
+    }
+    const Stats& getStats() const { return stats; }
+
+   private:
+    // Matches occlusion_cull.comp
+    struct Candidate {
+        glm::vec4 sphere{};
+        uint32_t slot = 0;
+        uint32_t padding[3]{};
+    };
+    struct CullPush {
+        glm::mat4 projectionView{1.f};
+        // level 0 region holding depth, not the image size
+        glm::vec2 pyramidSize{};
+        uint32_t pyramidLevels = 0;
+        uint32_t candidateCount = 0;
+        uint32_t latePhase = 0;
+    };
+    struct ReducePush {
+        int32_t srcSize[2];
+        int32_t dstSize[2];
+    };
+
+    void createBuffers();
+    void createDescriptorSetLayouts();
+    void createPipelineLayouts();
+    void createPipelines();
+    void createSampler();
+    void createPyramid(VkExtent2D maxExtent);
+    void destroyPyramid();
+    void writeDescriptorSets();
+    void dispatchCull(VkCommandBuffer commandBuffer, uint32_t latePhase);
+    // The pyramid and the frame's buffers, as used by the early phase
+    // (toGraphics) or by the late phase and draws
+    void getHandoffs(bool toGraphics,
+                     std::vector<LveAsyncCompute::BufferHandoff>& buffers,
+                     std::vector<LveAsyncCompute::ImageHandoff>& images);
+
+    LveDevice& lveDevice;
+    uint32_t maxObjects;
+
+    std::vector<std::unique_ptr<LveBuffer>> candidateBuffers;
+    std::vector<std::unique_ptr<LveBuffer>> earlyDrawBuffers;
+    std::vector<std::unique_ptr<LveBuffer>> lateDrawBuffers;
+    std::vector<std::unique_ptr<LveBuffer>> statsBuffers;
+    std::vector<bool> statsWritten;
+
+    std::unique_ptr<LveDescriptorPool> descriptorPool;
+    std::unique_ptr<LveDescriptorSetLayout> reduceSetLayout;
+    std::unique_ptr<LveDescriptorSetLayout> cullSetLayout;
+    // indexed by frame index, then pyramid level
+    std::vector<std::vector<VkDescriptorSet>> reduceDescriptorSets;
+    std::vector<VkDescriptorSet> cullDescriptorSets;
+
+    VkPipelineLayout reducePipelineLayout;
+    VkPipelineLayout cullPipelineLayout;
+    std::unique_ptr<LveComputePipeline> reducePipeline;
+    std::unique_ptr<LveComputePipeline> cullPipeline;
+
+    VkSampler pyramidSampler;
+    VkImage pyramidImage = VK_NULL_HANDLE;
+    VkDeviceMemory pyramidImageMemory = VK_NULL_HANDLE;
+    VkImageView pyramidView = VK_NULL_HANDLE;
+    std::vector<VkImageView> pyramidLevelViews;
+    VkExtent2D maxExtent{};
+    VkExtent2D depthExtent{};
+    VkExtent2D pyramidExtent{};
+    // level 0 texels holding the depth of the last rebuild
+    VkExtent2D pyramidRegion{};
+    uint32_t pyramidLevels = 0;
+    // false until the pyramid holds depth from an earlier frame
+    bool pyramidValid = false;
+
+    // nullptr culls on the graphics queue only
+    LveAsyncCompute* asyncCompute;
+
+    int frameIndex = 0;
+    uint32_t candidateCount = 0;
+    glm::mat4 projectionView{1.f};
+    Stats stats{};
+};
+
+}  // namespace lve
@@ -1,14 +1,28 @@
 #include "lve_pipeline.hpp"
 
 #include <cassert>
-#include <fstream>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 
 #include "lve_model.hpp"
+#include "lve_shader_library.hpp"
 
 namespace lve {
 
+namespace {
+
+void addCreationTime(LveDevice& device,
+                     std::chrono::high_resolution_clock::time_point start) {
+    device.addPipelineCreation(
+        std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start)
+            .count());
+}
+
+}  // namespace
+
 LvePipeline::LvePipeline(LveDevice& device,
                          const std::string& vertFilePath,
                          const std::string& fragFilePath,
@@ -17,62 +31,102 @@ LvePipeline::LvePipeline(LveDevice& device,
     createGraphicsPipeline(vertFilePath, fragFilePath, configInfo);
 }
 
-LvePipeline::~LvePipeline() {
-    vkDestroyShaderModule(lveDevice.device(), vertShaderModule, nullptr);
-    vkDestroyShaderModule(lveDevice.device(), fragShaderModule, nullptr);
+LvePipeline::LvePipeline(LveDevice& device, VkPipeline pipeline)
+    : lveDevice{device}, graphicsPipeline{pipeline} {}
 
+LvePipeline::~LvePipeline() {
     vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr);
 }
 
-std::vector<char> LvePipeline::readFile(const std::string& filePath) {
-    std::ifstream file(filePath, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file: " + filePath);
-    }
-
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-
-    return buffer;
-}
-
 void LvePipeline::createGraphicsPipeline(const std::string& vertFilePath,
                                          const std::string& fragFilePath,
                                          const PipelineConfigInfo& configInfo) {
+    auto start = std::chrono::high_resolution_clock::now();
+    graphicsPipeline =
+        createPipeline(lveDevice, vertFilePath, fragFilePath, configInfo, 0);
+    addCreationTime(lveDevice, start);
+}
+
+VkPipeline LvePipeline::createLibrary(
+    LveDevice& device,
+    VkGraphicsPipelineLibraryFlagsEXT libraryFlags,
+    const std::string& vertFilePath,
+    const std::string& fragFilePath,
+    const PipelineConfigInfo& configInfo) {
+    assert(libraryFlags != 0 &&
+           "Cannot create pipeline library: no state subset requested");
+    return createPipeline(
+        device, vertFilePath, fragFilePath, configInfo, libraryFlags);
+}
+
+VkPipeline LvePipeline::createPipeline(
+    LveDevice& device,
+    const std::string& vertFilePath,
+    const std::string& fragFilePath,
+    const PipelineConfigInfo& configInfo,
+    VkGraphicsPipelineLibraryFlagsEXT libraryFlags) {
     assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
            "Cannot create graphics pipeline: no pipelineLayout provided in "
            "configInfo");
-    assert(configInfo.renderPass != VK_NULL_HANDLE &&
-           "Cannot create graphics pipeline: no renderPass provided in "
-           "configInfo");
-
-    auto vertCode = readFile(vertFilePath);
-    auto fragCode = readFile(fragFilePath);
-
-    createShaderModule(vertCode, &vertShaderModule);
-    createShaderModule(fragCode, &fragShaderModule);
-
-    VkPipelineShaderStageCreateInfo shaderStages[2];
-    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = vertShaderModule;
-    shaderStages[0].pName = "main";
-    shaderStages[0].flags = 0;
-    shaderStages[0].pNext = nullptr;
-    shaderStages[0].pSpecializationInfo = nullptr;
-
-    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = fragShaderModule;
-    shaderStages[1].pName = "main";
-    shaderStages[1].flags = 0;
-    shaderStages[1].pNext = nullptr;
-    shaderStages[1].pSpecializationInfo = nullptr;
+    assert((configInfo.renderPass != VK_NULL_HANDLE ||
+            !configInfo.colorAttachmentFormats.empty() ||
+            configInfo.depthAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+           "Cannot create graphics pipeline: no renderPass or attachment "
+           "formats provided in configInfo");
+
+    // A complete pipeline has every state subset. Library parts only get
+    // the shader stages of their subsets; the other state is ignored by the
+    // driver.
+    const bool library = libraryFlags != 0;
+    const bool hasVertexShader =
+        !library ||
+        (libraryFlags &
+         VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+    const bool hasFragmentShader =
+        !library ||
+        (libraryFlags & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+
+    std::vector<VkSpecializationMapEntry> specializationEntries;
+    for (uint32_t i = 0; i < configInfo.specializationConstants.size(); i++) {
+        specializationEntries.push_back(
+            {i, static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t)});
+    }
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount =
+        static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize =
+        configInfo.specializationConstants.size() * sizeof(uint32_t);
+    specializationInfo.pData = configInfo.specializationConstants.data();
+    const VkSpecializationInfo* pSpecializationInfo =
+        specializationEntries.empty() ? nullptr : &specializationInfo;
+
+    // The modules are only needed until vkCreateGraphicsPipelines returns
+    std::shared_ptr<LveShaderModule> vertShaderModule;
+    std::shared_ptr<LveShaderModule> fragShaderModule;
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+    if (hasVertexShader) {
+        vertShaderModule = device.shaderLibrary().getModule(vertFilePath);
+
+        VkPipelineShaderStageCreateInfo stage{};
+        stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stage.module = vertShaderModule->getShaderModule();
+        stage.pName = "main";
+        stage.pSpecializationInfo = pSpecializationInfo;
+        shaderStages.push_back(stage);
+    }
+    if (hasFragmentShader) {
+        fragShaderModule = device.shaderLibrary().getModule(fragFilePath);
+
+        VkPipelineShaderStageCreateInfo stage{};
+        stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stage.module = fragShaderModule->getShaderModule();
+        stage.pName = "main";
+        stage.pSpecializationInfo = pSpecializationInfo;
+        shaderStages.push_back(stage);
+    }
 
     auto attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
     auto bindingDescriptions = LveModel::Vertex::getBindingDescriptions();
@@ -88,8 +142,8 @@ void LvePipeline::createGraphicsPipeline(const std::string& vertFilePath,
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
     pipelineInfo.pViewportState = &configInfo.viewportInfo;
@@ -103,36 +157,98 @@ void LvePipeline::createGraphicsPipeline(const std::string& vertFilePath,
     pipelineInfo.renderPass = configInfo.renderPass;
     pipelineInfo.subpass = configInfo.subpass;
 
+    // Without a render pass the pipeline is for dynamic rendering and only
+    // depends on the attachment formats.
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    if (configInfo.renderPass == VK_NULL_HANDLE) {
+        renderingInfo.colorAttachmentCount =
+            static_cast<uint32_t>(configInfo.colorAttachmentFormats.size());
+        renderingInfo.pColorAttachmentFormats =
+            configInfo.colorAttachmentFormats.data();
+        renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+        pipelineInfo.pNext = &renderingInfo;
+    }
+
+    // Parts keep their intermediate representation so that they can also
+    // be linked with link-time optimization.
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+    libraryInfo.sType =
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    if (library) {
+        libraryInfo.pNext = pipelineInfo.pNext;
+        libraryInfo.flags = libraryFlags;
+        pipelineInfo.pNext = &libraryInfo;
+        pipelineInfo.flags =
+            VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+            VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+    }
+
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(lveDevice.device(),
-                                  VK_NULL_HANDLE,
+    VkPipeline pipeline;
+    device.counters().add(LveCounters::PIPELINES_CREATED);
+    if (vkCreateGraphicsPipelines(device.device(),
+                                  device.pipelineCache(),
                                   1,
                                   &pipelineInfo,
                                   nullptr,
-                                  &graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline");
+                                  &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error(library
+                                     ? "failed to create pipeline library"
+                                     : "failed to create graphics pipeline");
     }
+    return pipeline;
 }
 
-void LvePipeline::createShaderModule(const std::vector<char>& code,
-                                     VkShaderModule* shaderModule) {
-    VkShaderModuleCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-    if (vkCreateShaderModule(
-            lveDevice.device(), &createInfo, nullptr, shaderModule) !=
-        VK_SUCCESS) {
-        throw std::runtime_error("Failed to create shader module");
+void LvePipeline::bind(VkCommandBuffer commandBuffer) {
+    lveDevice.counters().add(LveCounters::PIPELINE_BINDS);
+    vkCmdBindPipeline(
+        commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+}
+
+LveComputePipeline::LveComputePipeline(LveDevice& device,
+                                       const std::string& compFilePath,
+                                       VkPipelineLayout pipelineLayout)
+    : lveDevice{device} {
+    assert(pipelineLayout != VK_NULL_HANDLE &&
+           "Cannot create compute pipeline: no pipelineLayout provided");
+
+    auto compShaderModule = lveDevice.shaderLibrary().getModule(compFilePath);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule->getShaderModule();
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    lveDevice.counters().add(LveCounters::PIPELINES_CREATED);
+    if (vkCreateComputePipelines(lveDevice.device(),
+                                 lveDevice.pipelineCache(),
+                                 1,
+                                 &pipelineInfo,
+                                 nullptr,
+                                 &computePipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline");
     }
+    addCreationTime(lveDevice, start);
 }
 
-void LvePipeline::bind(VkCommandBuffer commandBuffer) {
+LveComputePipeline::~LveComputePipeline() {
+    vkDestroyPipeline(lveDevice.device(), computePipeline, nullptr);
+}
+
+void LveComputePipeline::bind(VkCommandBuffer commandBuffer) {
+    lveDevice.counters().add(LveCounters::PIPELINE_BINDS);
     vkCmdBindPipeline(
-        commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
 }
 
 void LvePipeline::defaultPipeLineConfigInfo(PipelineConfigInfo& configInfo) {
@@ -219,4 +335,39 @@ void LvePipeline::defaultPipeLineConfigInfo(PipelineConfigInfo& configInfo) {
     configInfo.dynamicStateInfo.flags = 0;
 }
 
-}  // namespace lve
\ No newline at end of file
+void LvePipeline::copyPipelineConfigInfo(const PipelineConfigInfo& source,
+                                         PipelineConfigInfo& destination) {
+    assert(source.colorBlendInfo.attachmentCount <= 1 &&
+           source.colorBlendInfo.pAttachments ==
+               &source.colorBlendAttachment &&
+           "Cannot copy configInfo: color blend attachments are not owned by "
+           "configInfo");
+    assert(source.dynamicStateInfo.pDynamicStates ==
+               source.dynamicStateEnables.data() &&
+           "Cannot copy configInfo: dynamic states are not owned by "
+           "configInfo");
+
+    destination.viewportInfo = source.viewportInfo;
+    destination.inputAssemblyInfo = source.inputAssemblyInfo;
+    destination.rasterizationInfo = source.rasterizationInfo;
+    destination.multisampleInfo = source.multisampleInfo;
+    destination.colorBlendAttachment = source.colorBlendAttachment;
+    destination.colorBlendInfo = source.colorBlendInfo;
+    destination.depthStencilInfo = source.depthStencilInfo;
+    destination.dynamicStateEnables = source.dynamicStateEnables;
+    destination.dynamicStateInfo = source.dynamicStateInfo;
+    destination.pipelineLayout = source.pipelineLayout;
+    destination.renderPass = source.renderPass;
+    destination.subpass = source.subpass;
+    destination.colorAttachmentFormats = source.colorAttachmentFormats;
+    destination.depthAttachmentFormat = source.depthAttachmentFormat;
+    destination.specializationConstants = source.specializationConstants;
+
+    // re-point the copied create infos at the copy's own arrays
+    destination.colorBlendInfo.pAttachments =
+        &destination.colorBlendAttachment;
+    destination.dynamicStateInfo.pDynamicStates =
+        destination.dynamicStateEnables.data();
+}
+
+}  // namespace lve
@@ -7,6 +7,16 @@
 
 namespace lve {
 
+// What a render system draws into: the render pass plus the formats of its
+// single subpass. Render passes with equal formats are compatible, so a
+// pipeline built for one can be used with the other. A null renderPass
+// means dynamic rendering into attachments of these formats.
+struct RenderTargetInfo {
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    std::vector<VkFormat> colorFormats{};
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+};
+
 struct PipelineConfigInfo {
     PipelineConfigInfo(const PipelineConfigInfo&) = delete;
     PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
@@ -23,6 +33,21 @@ struct PipelineConfigInfo {
     VkPipelineLayout pipelineLayout = nullptr;
     VkRenderPass renderPass = nullptr;
     uint32_t subpass = 0;
+    // Attachment formats of renderPass. When set, LvePipelineRegistry keys
+    // on them instead of the renderPass handle. With a null renderPass the
+    // pipeline is created for dynamic rendering with these formats.
+    std::vector<VkFormat> colorAttachmentFormats;
+    VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    // Value of the 32-bit specialization constant with constant_id i, passed
+    // to every stage (bools are 0 or 1). Ids a stage does not declare are
+    // ignored.
+    std::vector<uint32_t> specializationConstants;
+
+    void setRenderTarget(const RenderTargetInfo& renderTarget) {
+        renderPass = renderTarget.renderPass;
+        colorAttachmentFormats = renderTarget.colorFormats;
+        depthAttachmentFormat = renderTarget.depthFormat;
+    }
 };
 
 class LvePipeline {
@@ -31,6 +56,9 @@ class LvePipeline {
                 const std::string& vertFilePath,
                 const std::string& fragFilePath,
                 const PipelineConfigInfo& configInfo);
+    // Takes ownership of a pipeline created elsewhere, e.g. one linked from
+    // LvePipelineLibrary parts
+    LvePipeline(LveDevice& device, VkPipeline pipeline);
     ~LvePipeline();
 
     LvePipeline(const LvePipeline&) = delete;
@@ -38,20 +66,50 @@ class LvePipeline {
 
     void bind(VkCommandBuffer commandBuffer);
     static void defaultPipeLineConfigInfo(PipelineConfigInfo& configInfo);
+    // PipelineConfigInfo points into itself, so it cannot be copied
+    // memberwise. pSampleMask is copied as is and must outlive the copy.
+    static void copyPipelineConfigInfo(const PipelineConfigInfo& source,
+                                       PipelineConfigInfo& destination);
+    // Creates a VK_EXT_graphics_pipeline_library part holding the state
+    // subsets in libraryFlags; the caller owns the returned pipeline. Shader
+    // paths of stages outside those subsets are not read.
+    static VkPipeline createLibrary(
+        LveDevice& device,
+        VkGraphicsPipelineLibraryFlagsEXT libraryFlags,
+        const std::string& vertFilePath,
+        const std::string& fragFilePath,
+        const PipelineConfigInfo& configInfo);
 
    private:
-    static std::vector<char> readFile(const std::string& filePath);
-
     void createGraphicsPipeline(const std::string& vertFilePath,
                                 const std::string& fragFilePath,
                                 const PipelineConfigInfo& configInfo);
-
-    void createShaderModule(const std::vector<char>& code,
-                            VkShaderModule* shaderModule);
+    // A complete pipeline when libraryFlags is 0
+    static VkPipeline createPipeline(
+        LveDevice& device,
+        const std::string& vertFilePath,
+        const std::string& fragFilePath,
+        const PipelineConfigInfo& configInfo,
+        VkGraphicsPipelineLibraryFlagsEXT libraryFlags);
 
     LveDevice& lveDevice;
     VkPipeline graphicsPipeline;
-    VkShaderModule vertShaderModule;
-    VkShaderModule fragShaderModule;
+};
+
+class LveComputePipeline {
+   public:
+    LveComputePipeline(LveDevice& device,
+                       const std::string& compFilePath,
+                       VkPipelineLayout pipelineLayout);
+    ~LveComputePipeline();
+
+    LveComputePipeline(const LveComputePipeline&) = delete;
+    LveComputePipeline& operator=(const LveComputePipeline&) = delete;
+
+    void bind(VkCommandBuffer commandBuffer);
+
+   private:
+    LveDevice& lveDevice;
+    VkPipeline computePipeline;
 };
 }  // namespace lve
\ No newline at end of file
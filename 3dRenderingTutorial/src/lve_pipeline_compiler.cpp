@@ -0,0 +1,121 @@
+#include "lve_pipeline_compiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+#include "lve_cpu_profiler.hpp"
+
+namespace lve {
+
+bool LveAsyncPipeline::isReady() const {
+    return future.valid() && future.wait_for(std::chrono::seconds(0)) ==
+                                 std::future_status::ready;
+}
+
+std::shared_ptr<LvePipeline> LveAsyncPipeline::get() const {
+    if (fallback != nullptr && !isReady()) {
+        return fallback;
+    }
+    return future.get();
+}
+
+LvePipelineCompiler::LvePipelineCompiler(LveDevice& device,
+                                         uint32_t workerCount)
+    : lveDevice{device} {
+    if (workerCount == 0) {
+        // hardware_concurrency may report 0 when unknown
+        workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&LvePipelineCompiler::workerLoop, this);
+    }
+}
+
+LvePipelineCompiler::~LvePipelineCompiler() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    // queued jobs are still compiled so that no future is left broken
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+PipelineFuture LvePipelineCompiler::compile(
+    const std::string& vertFilePath,
+    const std::string& fragFilePath,
+    const PipelineConfigInfo& configInfo) {
+    struct Job {
+        std::string vertFilePath;
+        std::string fragFilePath;
+        PipelineConfigInfo configInfo{};
+    };
+    auto job = std::make_shared<Job>();
+    job->vertFilePath = vertFilePath;
+    job->fragFilePath = fragFilePath;
+    LvePipeline::copyPipelineConfigInfo(configInfo, job->configInfo);
+
+    LveDevice& device = lveDevice;
+    return submit([job, &device]() {
+        return std::make_shared<LvePipeline>(
+            device, job->vertFilePath, job->fragFilePath, job->configInfo);
+    });
+}
+
+PipelineFuture LvePipelineCompiler::submit(
+    std::function<std::shared_ptr<LvePipeline>()> create) {
+    auto promise =
+        std::make_shared<std::promise<std::shared_ptr<LvePipeline>>>();
+    PipelineFuture future = promise->get_future().share();
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        jobs.emplace_back([promise, create = std::move(create)]() {
+            try {
+                promise->set_value(create());
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        pendingCount++;
+    }
+    jobAvailable.notify_one();
+    return future;
+}
+
+uint32_t LvePipelineCompiler::getPendingCount() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    return pendingCount;
+}
+
+void LvePipelineCompiler::workerLoop() {
+    if (LveCpuProfiler::isEnabled()) {
+        LveCpuProfiler::setThreadName("pipeline compiler");
+    }
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            jobAvailable.wait(lock,
+                              [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        {
+            LVE_CPU_ZONE("compile pipeline");
+            job();
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        pendingCount--;
+    }
+}
+
+}  // namespace lve
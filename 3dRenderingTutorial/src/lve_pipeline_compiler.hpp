@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+namespace lve {
+
+using PipelineFuture = std::shared_future<std::shared_ptr<LvePipeline>>;
+
+// A pipeline that may still be compiling. Render systems call get() every
+// frame: until the compiled pipeline is ready it returns the fallback, so
+// drawing never waits on the compiler unless there is no fallback.
+class LveAsyncPipeline {
+   public:
+    LveAsyncPipeline() = default;
+    LveAsyncPipeline(PipelineFuture future,
+                     std::shared_ptr<LvePipeline> fallback = nullptr)
+        : future{std::move(future)}, fallback{std::move(fallback)} {}
+
+    bool isValid() const { return future.valid(); }
+    bool isReady() const;
+    bool hasFallback() const { return fallback != nullptr; }
+    // Rethrows the compile error if compilation failed
+    std::shared_ptr<LvePipeline> get() const;
+    void setFallback(std::shared_ptr<LvePipeline> pipeline) {
+        fallback = std::move(pipeline);
+    }
+
+   private:
+    PipelineFuture future{};
+    std::shared_ptr<LvePipeline> fallback{};
+};
+
+// Compiles graphics pipelines on a pool of worker threads. All workers
+// create their pipelines through the device's VkPipelineCache, which the
+// driver synchronizes internally, so their results end up in the cache
+// that LveDevice saves on shutdown.
+class LvePipelineCompiler {
+   public:
+    // workerCount 0 leaves one hardware thread to the render loop
+    explicit LvePipelineCompiler(LveDevice& device, uint32_t workerCount = 0);
+    ~LvePipelineCompiler();
+
+    LvePipelineCompiler(const LvePipelineCompiler&) = delete;
+    LvePipelineCompiler& operator=(const LvePipelineCompiler&) = delete;
+
+    // configInfo is copied, it does not need to outlive the call
+    PipelineFuture compile(const std::string& vertFilePath,
+                           const std::string& fragFilePath,
+                           const PipelineConfigInfo& configInfo);
+    // Runs any pipeline-creating function on a worker, e.g. a link of
+    // LvePipelineLibrary parts
+    PipelineFuture submit(std::function<std::shared_ptr<LvePipeline>()> create);
+
+    uint32_t getWorkerCount() const {
+        return static_cast<uint32_t>(workers.size());
+    }
+    // Jobs queued or being compiled
+    uint32_t getPendingCount() const;
+
+   private:
+    void workerLoop();
+
+    LveDevice& lveDevice;
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::deque<std::function<void()>> jobs;
+    uint32_t pendingCount = 0;
+    bool stopping = false;
+};
+
+}  // namespace lve
@@ -0,0 +1,247 @@
+#include "lve_pipeline_key.hpp"
+
+#include <type_traits>
+
+#include "lve_model.hpp"
+#include "lve_shader_library.hpp"
+
+namespace lve {
+
+namespace {
+
+// Appends single values so that padding inside the Vulkan structs never
+// ends up in the key.
+class KeyWriter {
+   public:
+    template <typename T>
+    KeyWriter& add(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "key values must be trivially copyable");
+        key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        return *this;
+    }
+
+    std::string key;
+};
+
+// Every part may reference dynamic state, so all of them key on it
+void addDynamicState(KeyWriter& writer, const PipelineConfigInfo& configInfo) {
+    auto& dynamicState = configInfo.dynamicStateInfo;
+    writer.add(dynamicState.dynamicStateCount);
+    for (uint32_t i = 0; i < dynamicState.dynamicStateCount; i++) {
+        writer.add(dynamicState.pDynamicStates[i]);
+    }
+}
+
+bool isDynamic(const PipelineConfigInfo& configInfo, VkDynamicState state) {
+    auto& dynamicState = configInfo.dynamicStateInfo;
+    for (uint32_t i = 0; i < dynamicState.dynamicStateCount; i++) {
+        if (dynamicState.pDynamicStates[i] == state) return true;
+    }
+    return false;
+}
+
+// The counts always; the rectangles when they are baked into the pipeline
+// rather than set by vkCmdSetViewport/vkCmdSetScissor
+void addViewports(KeyWriter& writer, const PipelineConfigInfo& configInfo) {
+    auto& viewportInfo = configInfo.viewportInfo;
+    writer.add(viewportInfo.viewportCount).add(viewportInfo.scissorCount);
+
+    // without the dynamic state the pointers must be valid
+    if (!isDynamic(configInfo, VK_DYNAMIC_STATE_VIEWPORT)) {
+        for (uint32_t i = 0; i < viewportInfo.viewportCount; i++) {
+            auto& viewport = viewportInfo.pViewports[i];
+            writer.add(viewport.x)
+                .add(viewport.y)
+                .add(viewport.width)
+                .add(viewport.height)
+                .add(viewport.minDepth)
+                .add(viewport.maxDepth);
+        }
+    }
+    if (!isDynamic(configInfo, VK_DYNAMIC_STATE_SCISSOR)) {
+        for (uint32_t i = 0; i < viewportInfo.scissorCount; i++) {
+            auto& scissor = viewportInfo.pScissors[i];
+            writer.add(scissor.offset.x)
+                .add(scissor.offset.y)
+                .add(scissor.extent.width)
+                .add(scissor.extent.height);
+        }
+    }
+}
+
+void addSpecializationConstants(KeyWriter& writer,
+                                const PipelineConfigInfo& configInfo) {
+    writer.add(
+        static_cast<uint32_t>(configInfo.specializationConstants.size()));
+    for (uint32_t constant : configInfo.specializationConstants) {
+        writer.add(constant);
+    }
+}
+
+void addMultisample(KeyWriter& writer, const PipelineConfigInfo& configInfo) {
+    auto& multisample = configInfo.multisampleInfo;
+    writer.add(multisample.rasterizationSamples)
+        .add(multisample.sampleShadingEnable)
+        .add(multisample.minSampleShading)
+        .add(multisample.alphaToCoverageEnable)
+        .add(multisample.alphaToOneEnable)
+        .add(multisample.pSampleMask != nullptr);
+    if (multisample.pSampleMask != nullptr) {
+        uint32_t maskWords = (multisample.rasterizationSamples + 31) / 32;
+        for (uint32_t i = 0; i < maskWords; i++) {
+            writer.add(multisample.pSampleMask[i]);
+        }
+    }
+}
+
+void addRenderTarget(KeyWriter& writer, const PipelineConfigInfo& configInfo) {
+    writer.add(configInfo.subpass);
+
+    // Render passes are compatible when their attachment formats match, so
+    // key on those when known and only fall back to the handle otherwise.
+    // Dynamic rendering pipelines (null renderPass) only have the formats.
+    writer.add(configInfo.renderPass == VK_NULL_HANDLE);
+    if (configInfo.colorAttachmentFormats.empty() &&
+        configInfo.depthAttachmentFormat == VK_FORMAT_UNDEFINED) {
+        writer.add(configInfo.renderPass);
+    } else {
+        writer.add(
+            static_cast<uint32_t>(configInfo.colorAttachmentFormats.size()));
+        for (auto format : configInfo.colorAttachmentFormats) {
+            writer.add(format);
+        }
+        writer.add(configInfo.depthAttachmentFormat);
+    }
+}
+
+}  // namespace
+
+std::string makeVertexInputKey(const PipelineConfigInfo& configInfo) {
+    KeyWriter writer{};
+
+    for (auto& binding : LveModel::Vertex::getBindingDescriptions()) {
+        writer.add(binding.binding)
+            .add(binding.stride)
+            .add(binding.inputRate);
+    }
+    for (auto& attribute : LveModel::Vertex::getAttributeDescriptions()) {
+        writer.add(attribute.location)
+            .add(attribute.binding)
+            .add(attribute.format)
+            .add(attribute.offset);
+    }
+
+    auto& inputAssembly = configInfo.inputAssemblyInfo;
+    writer.add(inputAssembly.topology)
+        .add(inputAssembly.primitiveRestartEnable);
+
+    addDynamicState(writer, configInfo);
+    return writer.key;
+}
+
+std::string makePreRasterizationKey(LveDevice& device,
+                                    const std::string& vertFilePath,
+                                    const PipelineConfigInfo& configInfo) {
+    KeyWriter writer{};
+    writer.add(device.shaderLibrary().getCode(vertFilePath).hash);
+    addSpecializationConstants(writer, configInfo);
+
+    addViewports(writer, configInfo);
+
+    auto& rasterization = configInfo.rasterizationInfo;
+    writer.add(rasterization.depthClampEnable)
+        .add(rasterization.rasterizerDiscardEnable)
+        .add(rasterization.polygonMode)
+        .add(rasterization.cullMode)
+        .add(rasterization.frontFace)
+        .add(rasterization.depthBiasEnable)
+        .add(rasterization.depthBiasConstantFactor)
+        .add(rasterization.depthBiasClamp)
+        .add(rasterization.depthBiasSlopeFactor)
+        .add(rasterization.lineWidth);
+
+    writer.add(configInfo.pipelineLayout);
+    addRenderTarget(writer, configInfo);
+    addDynamicState(writer, configInfo);
+    return writer.key;
+}
+
+std::string makeFragmentShaderKey(LveDevice& device,
+                                  const std::string& fragFilePath,
+                                  const PipelineConfigInfo& configInfo) {
+    KeyWriter writer{};
+    writer.add(device.shaderLibrary().getCode(fragFilePath).hash);
+    addSpecializationConstants(writer, configInfo);
+
+    auto& depthStencil = configInfo.depthStencilInfo;
+    writer.add(depthStencil.depthTestEnable)
+        .add(depthStencil.depthWriteEnable)
+        .add(depthStencil.depthCompareOp)
+        .add(depthStencil.depthBoundsTestEnable)
+        .add(depthStencil.stencilTestEnable)
+        .add(depthStencil.minDepthBounds)
+        .add(depthStencil.maxDepthBounds);
+    for (auto& stencil : {depthStencil.front, depthStencil.back}) {
+        writer.add(stencil.failOp)
+            .add(stencil.passOp)
+            .add(stencil.depthFailOp)
+            .add(stencil.compareOp)
+            .add(stencil.compareMask)
+            .add(stencil.writeMask)
+            .add(stencil.reference);
+    }
+    addMultisample(writer, configInfo);
+
+    writer.add(configInfo.pipelineLayout);
+    addRenderTarget(writer, configInfo);
+    addDynamicState(writer, configInfo);
+    return writer.key;
+}
+
+std::string makeFragmentOutputKey(const PipelineConfigInfo& configInfo) {
+    KeyWriter writer{};
+
+    auto& colorBlend = configInfo.colorBlendInfo;
+    writer.add(colorBlend.logicOpEnable)
+        .add(colorBlend.logicOp)
+        .add(colorBlend.attachmentCount);
+    for (uint32_t i = 0; i < colorBlend.attachmentCount; i++) {
+        auto& attachment = colorBlend.pAttachments[i];
+        writer.add(attachment.blendEnable)
+            .add(attachment.srcColorBlendFactor)
+            .add(attachment.dstColorBlendFactor)
+            .add(attachment.colorBlendOp)
+            .add(attachment.srcAlphaBlendFactor)
+            .add(attachment.dstAlphaBlendFactor)
+            .add(attachment.alphaBlendOp)
+            .add(attachment.colorWriteMask);
+    }
+    for (float constant : colorBlend.blendConstants) writer.add(constant);
+    addMultisample(writer, configInfo);
+
+    addRenderTarget(writer, configInfo);
+    addDynamicState(writer, configInfo);
+    return writer.key;
+}
+
+std::string makePipelineKey(LveDevice& device,
+                            const std::string& vertFilePath,
+                            const std::string& fragFilePath,
+                            const PipelineConfigInfo& configInfo) {
+    // The part keys have variable length, so prefix each with its size to
+    // keep the concatenation unambiguous.
+    std::string key;
+    for (auto& part :
+         {makeVertexInputKey(configInfo),
+          makePreRasterizationKey(device, vertFilePath, configInfo),
+          makeFragmentShaderKey(device, fragFilePath, configInfo),
+          makeFragmentOutputKey(configInfo)}) {
+        uint32_t size = static_cast<uint32_t>(part.size());
+        key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        key += part;
+    }
+    return key;
+}
+
+}  // namespace lve
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+namespace lve {
+
+// Serialized graphics pipeline state, used as cache keys. The state is
+// split along the four VK_EXT_graphics_pipeline_library subsets so that
+// LvePipelineLibrary can cache each part of a pipeline on its own; the key
+// of a whole pipeline is the concatenation of the four. Shaders are keyed
+// by the hash of their SPIR-V, so copies of a shader share pipelines.
+
+// Vertex layout of LveModel::Vertex and input assembly
+std::string makeVertexInputKey(const PipelineConfigInfo& configInfo);
+// Vertex shader, viewport, rasterization and dynamic state
+std::string makePreRasterizationKey(LveDevice& device,
+                                    const std::string& vertFilePath,
+                                    const PipelineConfigInfo& configInfo);
+// Fragment shader, depth/stencil and multisample state
+std::string makeFragmentShaderKey(LveDevice& device,
+                                  const std::string& fragFilePath,
+                                  const PipelineConfigInfo& configInfo);
+// Color blend and multisample state
+std::string makeFragmentOutputKey(const PipelineConfigInfo& configInfo);
+
+std::string makePipelineKey(LveDevice& device,
+                            const std::string& vertFilePath,
+                            const std::string& fragFilePath,
+                            const PipelineConfigInfo& configInfo);
+
+}  // namespace lve
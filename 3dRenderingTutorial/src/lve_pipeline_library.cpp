@@ -0,0 +1,188 @@
+#include "lve_pipeline_library.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+
+#include "lve_pipeline_key.hpp"
+
+namespace lve {
+
+namespace {
+
+float millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+// A linked pipeline that keeps the parts it was linked from cached while
+// it is in use; Vulkan itself does not need them after the link
+struct LinkedPipeline {
+    LinkedPipeline(const LvePipelineLibrary::PipelineParts& parts,
+                   LveDevice& device,
+                   VkPipeline pipeline)
+        : parts{parts}, pipeline{device, pipeline} {}
+
+    LvePipelineLibrary::PipelineParts parts;
+    LvePipeline pipeline;
+};
+
+}  // namespace
+
+LvePipelineLibrary::LvePipelineLibrary(LveDevice& device) : lveDevice{device} {
+    assert(device.hasGraphicsPipelineLibrary() &&
+           "Cannot create pipeline library: VK_EXT_graphics_pipeline_library "
+           "is not enabled");
+}
+
+LvePipelineLibrary::PipelineParts LvePipelineLibrary::getParts(
+    const std::string& vertFilePath,
+    const std::string& fragFilePath,
+    const PipelineConfigInfo& configInfo) {
+    PipelineParts pipelineParts{};
+    pipelineParts.pipelineLayout = configInfo.pipelineLayout;
+    pipelineParts.parts[0] =
+        getPart(makeVertexInputKey(configInfo),
+                VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+                vertFilePath,
+                fragFilePath,
+                configInfo);
+    pipelineParts.parts[1] = getPart(
+        makePreRasterizationKey(lveDevice, vertFilePath, configInfo),
+        VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+        vertFilePath,
+        fragFilePath,
+        configInfo);
+    pipelineParts.parts[2] =
+        getPart(makeFragmentShaderKey(lveDevice, fragFilePath, configInfo),
+                VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+                vertFilePath,
+                fragFilePath,
+                configInfo);
+    pipelineParts.parts[3] =
+        getPart(makeFragmentOutputKey(configInfo),
+                VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+                vertFilePath,
+                fragFilePath,
+                configInfo);
+    return pipelineParts;
+}
+
+std::shared_ptr<LvePipelineLibrary::Part> LvePipelineLibrary::getPart(
+    const std::string& key,
+    VkGraphicsPipelineLibraryFlagsEXT libraryFlags,
+    const std::string& vertFilePath,
+    const std::string& fragFilePath,
+    const PipelineConfigInfo& configInfo) {
+    // the subset is part of the key, the state keys of two subsets may match
+    std::string partKey = std::to_string(libraryFlags) + ":" + key;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto found = parts.find(partKey);
+        if (found != parts.end()) {
+            if (auto part = found->second.lock()) {
+                stats.partsShared++;
+                return part;
+            }
+        }
+    }
+
+    // Compiled outside the lock so optimized links on the workers are not
+    // held up; getParts is only called from one thread.
+    auto start = std::chrono::high_resolution_clock::now();
+    auto part = std::make_shared<Part>(
+        lveDevice,
+        LvePipeline::createLibrary(
+            lveDevice, libraryFlags, vertFilePath, fragFilePath, configInfo));
+    float milliseconds = millisecondsSince(start);
+
+    std::lock_guard<std::mutex> lock{mutex};
+    stats.partsCreated++;
+    stats.partMilliseconds += milliseconds;
+    for (auto it = parts.begin(); it != parts.end();) {
+        if (it->second.expired()) {
+            it = parts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    parts[partKey] = part;
+    return part;
+}
+
+std::shared_ptr<LvePipeline> LvePipelineLibrary::fastLink(
+    const PipelineParts& parts) {
+    return link(parts, false);
+}
+
+std::shared_ptr<LvePipeline> LvePipelineLibrary::optimizedLink(
+    const PipelineParts& parts) {
+    return link(parts, true);
+}
+
+std::shared_ptr<LvePipeline> LvePipelineLibrary::link(
+    const PipelineParts& parts, bool optimize) {
+    std::array<VkPipeline, 4> libraries{};
+    for (size_t i = 0; i < libraries.size(); i++) {
+        assert(parts.parts[i] != nullptr &&
+               "Cannot link pipeline: missing library part");
+        libraries[i] = parts.parts[i]->getPipeline();
+    }
+
+    VkPipelineLibraryCreateInfoKHR libraryInfo{};
+    libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    libraryInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+    libraryInfo.pLibraries = libraries.data();
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &libraryInfo;
+    pipelineInfo.flags =
+        optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    pipelineInfo.layout = parts.pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkPipeline pipeline;
+    lveDevice.counters().add(LveCounters::PIPELINES_CREATED);
+    if (vkCreateGraphicsPipelines(lveDevice.device(),
+                                  lveDevice.pipelineCache(),
+                                  1,
+                                  &pipelineInfo,
+                                  nullptr,
+                                  &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to link graphics pipeline");
+    }
+    float milliseconds = millisecondsSince(start);
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (optimize) {
+            stats.optimizedLinks++;
+            stats.optimizedLinkMilliseconds += milliseconds;
+        } else {
+            stats.fastLinks++;
+            stats.fastLinkMilliseconds += milliseconds;
+        }
+    }
+    auto linked = std::make_shared<LinkedPipeline>(parts, lveDevice, pipeline);
+    return std::shared_ptr<LvePipeline>(linked, &linked->pipeline);
+}
+
+LvePipelineLibrary::Stats LvePipelineLibrary::getStats() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    return stats;
+}
+
+size_t LvePipelineLibrary::size() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    size_t alive = 0;
+    for (auto& kv : parts) {
+        if (!kv.second.expired()) alive++;
+    }
+    return alive;
+}
+
+}  // namespace lve
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+namespace lve {
+
+// Builds graphics pipelines from VK_EXT_graphics_pipeline_library parts.
+// A pipeline is split into its vertex input, pre-rasterization shader,
+// fragment shader and fragment output parts, each compiled once and cached
+// by the state it depends on (see lve_pipeline_key.hpp), so a new blend
+// state or cull mode only compiles the part it changes. Complete pipelines
+// are then linked from the parts: fastLink skips link-time optimization
+// and is meant to be called while rendering, optimizedLink produces the
+// pipeline a full compile would and is meant for a worker thread.
+//
+// Only usable when LveDevice::hasGraphicsPipelineLibrary() is true.
+class LvePipelineLibrary {
+   public:
+    // Totals since creation; the milliseconds are wall-clock time spent in
+    // vkCreateGraphicsPipelines.
+    struct Stats {
+        uint32_t partsCreated = 0;
+        uint32_t partsShared = 0;
+        uint32_t fastLinks = 0;
+        uint32_t optimizedLinks = 0;
+        float partMilliseconds = 0.f;
+        float fastLinkMilliseconds = 0.f;
+        float optimizedLinkMilliseconds = 0.f;
+    };
+
+    // One compiled part, destroyed with the last PipelineParts or linked
+    // pipeline using it
+    class Part {
+       public:
+        Part(LveDevice& device, VkPipeline pipeline)
+            : lveDevice{device}, pipeline{pipeline} {}
+        ~Part() { vkDestroyPipeline(lveDevice.device(), pipeline, nullptr); }
+
+        Part(const Part&) = delete;
+        Part& operator=(const Part&) = delete;
+
+        VkPipeline getPipeline() const { return pipeline; }
+
+       private:
+        LveDevice& lveDevice;
+        VkPipeline pipeline;
+    };
+
+    // Everything needed to link one pipeline. Holds its parts, so it can be
+    // handed to a worker thread for the optimized link.
+    struct PipelineParts {
+        std::array<std::shared_ptr<Part>, 4> parts{};
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    };
+
+    explicit LvePipelineLibrary(LveDevice& device);
+
+    LvePipelineLibrary(const LvePipelineLibrary&) = delete;
+    LvePipelineLibrary& operator=(const LvePipelineLibrary&) = delete;
+
+    // Compiles the parts that are not cached yet, so it only blocks when
+    // the state includes shaders or a shader combination not seen before.
+    PipelineParts getParts(const std::string& vertFilePath,
+                           const std::string& fragFilePath,
+                           const PipelineConfigInfo& configInfo);
+    std::shared_ptr<LvePipeline> fastLink(const PipelineParts& parts);
+    // Safe to call from any thread
+    std::shared_ptr<LvePipeline> optimizedLink(const PipelineParts& parts);
+
+    Stats getStats() const;
+    // Parts currently alive
+    size_t size() const;
+
+   private:
+    std::shared_ptr<Part> getPart(
+        const std::string& key,
+        VkGraphicsPipelineLibraryFlagsEXT libraryFlags,
+        const std::string& vertFilePath,
+        const std::string& fragFilePath,
+        const PipelineConfigInfo& configInfo);
+    std::shared_ptr<LvePipeline> link(const PipelineParts& parts,
+                                      bool optimize);
+
+    LveDevice& lveDevice;
+
+    mutable std::mutex mutex;
+    // Parts are shared while a pipeline linked from them or its
+    // PipelineParts is alive, which is what makes the fast link of a new
+    // variant cheap. The keys include the SPIR-V hash, so parts of replaced
+    // shaders are released with the pipelines the registry sweeps; their
+    // entries are erased when a part is added. Keyed by the subset bit
+    // followed by the subset's state key.
+    std::unordered_map<std::string, std::weak_ptr<Part>> parts;
+    Stats stats{};
+};
+
+}  // namespace lve
@@ -0,0 +1,119 @@
+#include "lve_pipeline_registry.hpp"
+
+#include <chrono>
+
+#include "lve_pipeline_key.hpp"
+
+namespace lve {
+
+LvePipelineRegistry::LvePipelineRegistry(LveDevice& device)
+    : lveDevice{device}, compiler{device} {
+    if (device.hasGraphicsPipelineLibrary()) {
+        library = std::make_unique<LvePipelineLibrary>(device);
+    }
+}
+
+void LvePipelineRegistry::sweep() {
+    for (auto it = pipelines.begin(); it != pipelines.end();) {
+        Entry& entry = it->second;
+        if (entry.compiling.valid() &&
+            entry.compiling.wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready) {
+            // a failed compilation is dropped, so the next request retries
+            // it
+            try {
+                entry.pipeline = entry.compiling.get();
+            } catch (...) {
+            }
+            entry.compiling = {};
+            entry.fastLinked.reset();
+        }
+        if (!entry.compiling.valid() && entry.pipeline.expired()) {
+            it = pipelines.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+PipelineFuture LvePipelineRegistry::find(const std::string& key) {
+    auto it = pipelines.find(key);
+    if (it != pipelines.end()) {
+        if (it->second.compiling.valid()) {
+            stats.hits++;
+            return it->second.compiling;
+        }
+        if (auto pipeline = it->second.pipeline.lock()) {
+            stats.hits++;
+            std::promise<std::shared_ptr<LvePipeline>> ready;
+            ready.set_value(pipeline);
+            return ready.get_future().share();
+        }
+    }
+    stats.misses++;
+    return {};
+}
+
+std::shared_ptr<LvePipeline> LvePipelineRegistry::getPipeline(
+    const std::string& vertFilePath,
+    const std::string& fragFilePath,
+    const PipelineConfigInfo& configInfo) {
+    auto key =
+        makePipelineKey(lveDevice, vertFilePath, fragFilePath, configInfo);
+
+    sweep();
+    auto found = find(key);
+    if (found.valid()) {
+        return found.get();
+    }
+
+    auto pipeline = std::make_shared<LvePipeline>(
+        lveDevice, vertFilePath, fragFilePath, configInfo);
+    pipelines[key].pipeline = pipeline;
+    return pipeline;
+}
+
+LveAsyncPipeline LvePipelineRegistry::getPipelineAsync(
+    const std::string& vertFilePath,
+    const std::string& fragFilePath,
+    const PipelineConfigInfo& configInfo,
+    std::shared_ptr<LvePipeline> fallback) {
+    auto key =
+        makePipelineKey(lveDevice, vertFilePath, fragFilePath, configInfo);
+
+    sweep();
+    auto found = find(key);
+    if (!found.valid()) {
+        auto& entry = pipelines[key];
+        if (library != nullptr) {
+            auto parts =
+                library->getParts(vertFilePath, fragFilePath, configInfo);
+            entry.fastLinked = library->fastLink(parts);
+            LvePipelineLibrary* optimizer = library.get();
+            found = compiler.submit([optimizer, parts]() {
+                return optimizer->optimizedLink(parts);
+            });
+        } else {
+            found = compiler.compile(vertFilePath, fragFilePath, configInfo);
+        }
+        entry.compiling = found;
+    }
+
+    auto& fastLinked = pipelines[key].fastLinked;
+    if (fastLinked != nullptr) {
+        fallback = fastLinked;
+    }
+    return LveAsyncPipeline{found, std::move(fallback)};
+}
+
+size_t LvePipelineRegistry::size() const {
+    size_t alive = 0;
+    for (auto& kv : pipelines) {
+        if (kv.second.compiling.valid() || !kv.second.pipeline.expired()) {
+            alive++;
+        }
+    }
+    return alive;
+}
+
+}  // namespace lve
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_pipeline_compiler.hpp"
+#include "lve_pipeline_library.hpp"
+
+namespace lve {
+
+// Hands out shared graphics pipelines. Requests with the same shader code,
+// fixed-function state, vertex layout, pipeline layout and a compatible
+// render pass get the same LvePipeline; it is destroyed once the last
+// shared_ptr to it is released. Pipelines can also be requested
+// asynchronously, in which case they are compiled by the registry's
+// LvePipelineCompiler; a request matching a pipeline that is still
+// compiling shares that compilation. On devices with
+// VK_EXT_graphics_pipeline_library an asynchronous request is fast-linked
+// from cached parts right away and that pipeline is used until the
+// optimized link finishes on the compiler; elsewhere the caller's fallback
+// is used until the full compile finishes.
+class LvePipelineRegistry {
+   public:
+    struct Stats {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+    };
+
+    explicit LvePipelineRegistry(LveDevice& device);
+
+    LvePipelineRegistry(const LvePipelineRegistry&) = delete;
+    LvePipelineRegistry& operator=(const LvePipelineRegistry&) = delete;
+
+    std::shared_ptr<LvePipeline> getPipeline(
+        const std::string& vertFilePath,
+        const std::string& fragFilePath,
+        const PipelineConfigInfo& configInfo);
+    // Returns immediately (after compiling any missing library parts); the
+    // handle yields the fast-linked pipeline, or else fallback, until the
+    // optimized pipeline is ready.
+    LveAsyncPipeline getPipelineAsync(
+        const std::string& vertFilePath,
+        const std::string& fragFilePath,
+        const PipelineConfigInfo& configInfo,
+        std::shared_ptr<LvePipeline> fallback = nullptr);
+
+    const Stats& getStats() const { return stats; }
+    // Number of pipelines currently alive or being compiled
+    size_t size() const;
+    const LvePipelineCompiler& getCompiler() const { return compiler; }
+    // nullptr without VK_EXT_graphics_pipeline_library
+    const LvePipelineLibrary* getLibrary() const { return library.get(); }
+
+   private:
+    // A finished compilation is only held weakly, like a synchronously
+    // created pipeline, once sweep has seen it complete. fastLinked is
+    // handed out as the fallback while compiling.
+    struct Entry {
+        std::weak_ptr<LvePipeline> pipeline{};
+        PipelineFuture compiling{};
+        std::shared_ptr<LvePipeline> fastLinked{};
+    };
+
+    // Moves finished compilations to their weak pointer, releasing the
+    // registry's references to them and their fast-linked pipelines, and
+    // erases the entries of pipelines nobody uses anymore. Run on every
+    // request, so pipelines replaced by hot reload or other variants are
+    // destroyed even if their keys are never requested again.
+    void sweep();
+    // Looks up key, counting a hit or miss. Returns an empty future on a
+    // miss.
+    PipelineFuture find(const std::string& key);
+
+    LveDevice& lveDevice;
+    // keyed by the serialized pipeline state, see makePipelineKey
+    std::unordered_map<std::string, Entry> pipelines;
+    Stats stats{};
+    std::unique_ptr<LvePipelineLibrary> library;
+    // declared last so its workers finish before the map is destroyed
+    LvePipelineCompiler compiler;
+};
+
+}  // namespace lve
@@ -0,0 +1,854 @@
+#include "lve_render_graph.hpp"
+
+#include "lve_render_graph_plan.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace lve {
+
+namespace {
+
+struct UsageInfo {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    VkImageUsageFlags imageUsage;
+    VkBufferUsageFlags bufferUsage;
+};
+
+UsageInfo usageInfo(LveRenderGraph::Usage usage) {
+    using Usage = LveRenderGraph::Usage;
+    switch (usage) {
+        case Usage::COLOR_ATTACHMENT:
+            return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                    0};
+        case Usage::DEPTH_ATTACHMENT:
+            return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                    0};
+        case Usage::SAMPLED_FRAGMENT:
+            return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT};
+        case Usage::SAMPLED_COMPUTE:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT};
+        case Usage::STORAGE_READ_COMPUTE:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_USAGE_STORAGE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+        case Usage::STORAGE_WRITE_COMPUTE:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_USAGE_STORAGE_BIT,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+        case Usage::INDIRECT_READ:
+            return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                    VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    0,
+                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT};
+        case Usage::TRANSFER_SRC:
+            return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+        case Usage::TRANSFER_DST:
+            return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT};
+    }
+    throw std::runtime_error("unknown render graph usage");
+}
+
+bool isWriteUsage(LveRenderGraph::Usage usage) {
+    using Usage = LveRenderGraph::Usage;
+    return usage == Usage::STORAGE_WRITE_COMPUTE ||
+           usage == Usage::TRANSFER_DST;
+}
+
+constexpr VkAccessFlags WRITE_ACCESS =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+    VK_ACCESS_MEMORY_WRITE_BIT;
+
+VkImageAspectFlags aspectMask(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+}  // namespace
+
+LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::renderArea(
+    VkExtent2D extent) {
+    graph.passes[pass].renderArea = extent;
+    return *this;
+}
+
+LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::color(
+    ResourceId resource,
+    VkAttachmentLoadOp loadOp,
+    VkClearColorValue clearColor) {
+    Attachment attachment{resource, loadOp, {}};
+    attachment.clearValue.color = clearColor;
+    graph.passes[pass].colors.push_back(attachment);
+    graph.addAccess(pass,
+                    {resource,
+                     Usage::COLOR_ATTACHMENT,
+                     loadOp == VK_ATTACHMENT_LOAD_OP_LOAD,
+                     true});
+    return *this;
+}
+
+LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::depth(
+    ResourceId resource,
+    VkAttachmentLoadOp loadOp,
+    VkClearDepthStencilValue clearDepth) {
+    auto& target = graph.passes[pass];
+    assert(!target.hasDepth && "Pass already has a depth attachment");
+    target.hasDepth = true;
+    target.depth = {resource, loadOp, {}};
+    target.depth.clearValue.depthStencil = clearDepth;
+    graph.addAccess(pass,
+                    {resource,
+                     Usage::DEPTH_ATTACHMENT,
+                     loadOp == VK_ATTACHMENT_LOAD_OP_LOAD,
+                     true});
+    return *this;
+}
+
+LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::read(
+    ResourceId resource, Usage usage) {
+    assert(usage != Usage::COLOR_ATTACHMENT &&
+           usage != Usage::DEPTH_ATTACHMENT && !isWriteUsage(usage) &&
+           "Not a read usage, attachments are added with color and depth");
+    graph.addAccess(pass, {resource, usage, true, false});
+    return *this;
+}
+
+LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::write(
+    ResourceId resource, Usage usage) {
+    assert(isWriteUsage(usage) &&
+           "Not a write usage, attachments are added with color and depth");
+    graph.addAccess(pass, {resource, usage, false, true});
+    return *this;
+}
+
+LveRenderGraph::PassBuilder&
+LveRenderGraph::PassBuilder::secondaryCommandBuffers() {
+    graph.passes[pass].secondary = true;
+    return *this;
+}
+
+LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::sideEffects() {
+    graph.passes[pass].sideEffects = true;
+    return *this;
+}
+
+LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::execute(
+    std::function<void(VkCommandBuffer)> callback) {
+    graph.passes[pass].callback = std::move(callback);
+    return *this;
+}
+
+LveRenderGraph::LveRenderGraph(LveDevice& device) : lveDevice{device} {}
+
+LveRenderGraph::~LveRenderGraph() {
+    for (auto& transients : frameTransients) {
+        destroyTransients(transients);
+    }
+}
+
+void LveRenderGraph::reset(int newFrameIndex) {
+    frameIndex = newFrameIndex;
+    if (frameTransients.size() <= static_cast<size_t>(frameIndex)) {
+        frameTransients.resize(frameIndex + 1);
+    }
+    resources.clear();
+    resourceNames.clear();
+    passes.clear();
+}
+
+LveRenderGraph::ResourceId LveRenderGraph::addResource(Resource resource) {
+    auto id = static_cast<ResourceId>(resources.size());
+    if (!resourceNames.emplace(resource.name, id).second) {
+        throw std::runtime_error("render graph resource declared twice: " +
+                                 resource.name);
+    }
+    resources.push_back(std::move(resource));
+    return id;
+}
+
+LveRenderGraph::ResourceId LveRenderGraph::importImage(
+    const std::string& name, const ImportedImage& image) {
+    Resource resource{};
+    resource.name = name;
+    resource.imported = true;
+    resource.image = image.image;
+    resource.view = image.view;
+    resource.desc = {image.format, image.extent};
+    resource.aspect = aspectMask(image.format);
+    resource.import = image;
+    return addResource(std::move(resource));
+}
+
+LveRenderGraph::ResourceId LveRenderGraph::importBuffer(
+    const std::string& name, VkBuffer buffer, VkDeviceSize size) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = false;
+    resource.imported = true;
+    resource.buffer = buffer;
+    resource.size = size;
+    return addResource(std::move(resource));
+}
+
+LveRenderGraph::ResourceId LveRenderGraph::createImage(
+    const std::string& name, const ImageDesc& desc) {
+    Resource resource{};
+    resource.name = name;
+    resource.desc = desc;
+    resource.aspect = aspectMask(desc.format);
+    return addResource(std::move(resource));
+}
+
+LveRenderGraph::ResourceId LveRenderGraph::createBuffer(
+    const std::string& name, VkDeviceSize size) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = false;
+    resource.size = size;
+    return addResource(std::move(resource));
+}
+
+LveRenderGraph::ResourceId LveRenderGraph::getResource(
+    const std::string& name) const {
+    auto found = resourceNames.find(name);
+    if (found == resourceNames.end()) {
+        throw std::runtime_error("unknown render graph resource: " + name);
+    }
+    return found->second;
+}
+
+VkImage LveRenderGraph::getImage(ResourceId resource) const {
+    assert(resources.at(resource).isImage && "Resource is not an image");
+    return resources.at(resource).image;
+}
+
+VkImageView LveRenderGraph::getImageView(ResourceId resource) const {
+    assert(resources.at(resource).isImage && "Resource is not an image");
+    return resources.at(resource).view;
+}
+
+VkBuffer LveRenderGraph::getBuffer(ResourceId resource) const {
+    assert(!resources.at(resource).isImage && "Resource is not a buffer");
+    return resources.at(resource).buffer;
+}
+
+LveRenderGraph::PassBuilder LveRenderGraph::addPass(const std::string& name) {
+    Pass pass{};
+    pass.name = name;
+    passes.push_back(std::move(pass));
+    return PassBuilder{*this, passes.size() - 1};
+}
+
+void LveRenderGraph::addAccess(size_t pass, const Access& access) {
+    assert(access.resource < resources.size() && "Unknown resource");
+    assert((resources[access.resource].isImage ||
+            usageInfo(access.usage).bufferUsage != 0) &&
+           "Usage does not apply to buffers");
+    assert((!resources[access.resource].isImage ||
+            usageInfo(access.usage).imageUsage != 0) &&
+           "Usage does not apply to images");
+    passes[pass].accesses.push_back(access);
+}
+
+std::vector<size_t> LveRenderGraph::cullPasses() {
+    std::vector<bool> preserved(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        preserved[i] = resources[i].imported && resources[i].import.preserve;
+    }
+
+    std::vector<GraphPassUse> uses(passes.size());
+    for (size_t i = 0; i < passes.size(); i++) {
+        uses[i].sideEffects = passes[i].sideEffects;
+        for (const auto& access : passes[i].accesses) {
+            uses[i].accesses.push_back(
+                {access.resource, access.reads, access.writes});
+        }
+    }
+    return cullGraphPasses(uses, preserved);
+}
+
+void LveRenderGraph::collectUsage(const std::vector<size_t>& order) {
+    for (size_t position = 0; position < order.size(); position++) {
+        for (const auto& access : passes[order[position]].accesses) {
+            auto& resource = resources[access.resource];
+            auto info = usageInfo(access.usage);
+            resource.imageUsage |= info.imageUsage;
+            resource.bufferUsage |= info.bufferUsage;
+            if (resource.firstUse < 0) {
+                resource.firstUse = static_cast<int>(position);
+            }
+            resource.lastUse = static_cast<int>(position);
+        }
+    }
+}
+
+void LveRenderGraph::allocateTransients() {
+    auto& transients = frameTransients[frameIndex];
+
+    std::string key;
+    for (ResourceId id = 0; id < resources.size(); id++) {
+        const auto& resource = resources[id];
+        if (resource.imported || resource.firstUse < 0) continue;
+        key += std::to_string(id) + ":" + std::to_string(resource.isImage) +
+               ":" + std::to_string(static_cast<int>(resource.desc.format)) +
+               ":" +
+               std::to_string(resource.desc.extent.width) + "x" +
+               std::to_string(resource.desc.extent.height) + ":" +
+               std::to_string(resource.size) + ":" +
+               std::to_string(resource.imageUsage) + ":" +
+               std::to_string(resource.bufferUsage) + ":" +
+               std::to_string(resource.firstUse) + "-" +
+               std::to_string(resource.lastUse) + ";";
+    }
+
+    if (key != transients.key || transients.images.size() != resources.size()) {
+        destroyTransients(transients);
+        transients.key = key;
+        transients.images.assign(resources.size(), VK_NULL_HANDLE);
+        transients.views.assign(resources.size(), VK_NULL_HANDLE);
+        transients.buffers.assign(resources.size(), VK_NULL_HANDLE);
+        transients.aliased.assign(resources.size(), {});
+
+        // Images and buffers get separate heaps, so bufferImageGranularity
+        // never applies
+        std::vector<std::pair<uint32_t, bool>> heaps;  // memory type, image
+        std::vector<TransientPlacement> placements;
+
+        for (ResourceId id = 0; id < resources.size(); id++) {
+            const auto& resource = resources[id];
+            if (resource.imported || resource.firstUse < 0) continue;
+
+            VkMemoryRequirements requirements{};
+            if (resource.isImage) {
+                VkImageCreateInfo imageInfo{};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.extent = {resource.desc.extent.width,
+                                    resource.desc.extent.height,
+                                    1};
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.format = resource.desc.format;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                imageInfo.usage = resource.imageUsage;
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                if (vkCreateImage(lveDevice.device(),
+                                  &imageInfo,
+                                  nullptr,
+                                  &transients.images[id]) != VK_SUCCESS) {
+                    throw std::runtime_error(
+                        "failed to create render graph image!");
+                }
+                vkGetImageMemoryRequirements(
+                    lveDevice.device(), transients.images[id], &requirements);
+            } else {
+                VkBufferCreateInfo bufferInfo{};
+                bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                bufferInfo.size = resource.size;
+                bufferInfo.usage = resource.bufferUsage;
+                bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                lveDevice.counters().add(LveCounters::BUFFERS_CREATED);
+                if (vkCreateBuffer(lveDevice.device(),
+                                   &bufferInfo,
+                                   nullptr,
+                                   &transients.buffers[id]) != VK_SUCCESS) {
+                    throw std::runtime_error(
+                        "failed to create render graph buffer!");
+                }
+                vkGetBufferMemoryRequirements(
+                    lveDevice.device(), transients.buffers[id], &requirements);
+            }
+            std::pair<uint32_t, bool> heap{
+                lveDevice.findMemoryType(requirements.memoryTypeBits,
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+                resource.isImage};
+
+            TransientPlacement placement{};
+            placement.resource = id;
+            placement.size = requirements.size;
+            placement.alignment = requirements.alignment;
+            placement.heap = static_cast<uint32_t>(
+                std::find(heaps.begin(), heaps.end(), heap) - heaps.begin());
+            if (placement.heap == heaps.size()) heaps.push_back(heap);
+            placement.firstUse = resource.firstUse;
+            placement.lastUse = resource.lastUse;
+            placements.push_back(placement);
+        }
+
+        std::vector<uint64_t> heapSizes = placeTransients(placements);
+        transients.transientBytes = 0;
+        for (const auto& placement : placements) {
+            transients.transientBytes += placement.size;
+        }
+
+        // one allocation per heap, as large as its highest placement
+        transients.allocatedBytes = 0;
+        for (size_t heap = 0; heap < heaps.size(); heap++) {
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = heapSizes[heap];
+            allocInfo.memoryTypeIndex = heaps[heap].first;
+            VkDeviceMemory memory;
+            if (vkAllocateMemory(
+                    lveDevice.device(), &allocInfo, nullptr, &memory) !=
+                VK_SUCCESS) {
+                throw std::runtime_error(
+                    "failed to allocate render graph memory!");
+            }
+            transients.memory.push_back(memory);
+            transients.allocatedBytes += heapSizes[heap];
+        }
+
+        for (const auto& placement : placements) {
+            ResourceId id = placement.resource;
+            VkDeviceMemory memory = transients.memory[placement.heap];
+            if (resources[id].isImage) {
+                vkBindImageMemory(lveDevice.device(),
+                                  transients.images[id],
+                                  memory,
+                                  placement.offset);
+
+                VkImageViewCreateInfo viewInfo{};
+                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                viewInfo.image = transients.images[id];
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.format = resources[id].desc.format;
+                viewInfo.subresourceRange = {
+                    resources[id].aspect, 0, 1, 0, 1};
+                if (vkCreateImageView(lveDevice.device(),
+                                      &viewInfo,
+                                      nullptr,
+                                      &transients.views[id]) != VK_SUCCESS) {
+                    throw std::runtime_error(
+                        "failed to create render graph image view!");
+                }
+            } else {
+                vkBindBufferMemory(lveDevice.device(),
+                                   transients.buffers[id],
+                                   memory,
+                                   placement.offset);
+            }
+
+            // earlier occupants of the memory, which the first access has
+            // to wait for
+            for (const auto& other : placements) {
+                if (reusesMemory(other, placement)) {
+                    transients.aliased[id].push_back(other.resource);
+                }
+            }
+        }
+    }
+
+    for (ResourceId id = 0; id < resources.size(); id++) {
+        auto& resource = resources[id];
+        if (resource.imported) continue;
+        resource.image = transients.images[id];
+        resource.view = transients.views[id];
+        resource.buffer = transients.buffers[id];
+    }
+    stats.transientBytes = transients.transientBytes;
+    stats.allocatedBytes = transients.allocatedBytes;
+}
+
+void LveRenderGraph::destroyTransients(Transients& transients) {
+    for (auto view : transients.views) {
+        if (view != VK_NULL_HANDLE) {
+            vkDestroyImageView(lveDevice.device(), view, nullptr);
+        }
+    }
+    for (auto image : transients.images) {
+        if (image != VK_NULL_HANDLE) {
+            vkDestroyImage(lveDevice.device(), image, nullptr);
+        }
+    }
+    for (auto buffer : transients.buffers) {
+        if (buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(lveDevice.device(), buffer, nullptr);
+        }
+    }
+    for (auto memory : transients.memory) {
+        vkFreeMemory(lveDevice.device(), memory, nullptr);
+    }
+    transients = Transients{};
+}
+
+bool LveRenderGraph::needsBarrier(const State& state,
+                                  const Access& access) const {
+    auto info = usageInfo(access.usage);
+    if (resources[access.resource].isImage && state.layout != info.layout) {
+        return true;
+    }
+    if (access.writes) {
+        // write after write, or after reads that must finish first
+        return (state.writeStages | state.readStages) != 0;
+    }
+    // read after write the write is not yet visible to
+    return state.writeStages != 0 &&
+           ((info.stages & ~state.visibleStages) != 0 ||
+            (info.access & ~state.visibleAccess) != 0);
+}
+
+void LveRenderGraph::addBarrier(State& state,
+                                const Resource& resource,
+                                const Access& access,
+                                Barriers& barriers) {
+    auto info = usageInfo(access.usage);
+    const bool transition = resource.isImage && state.layout != info.layout;
+
+    if (needsBarrier(state, access)) {
+        VkPipelineStageFlags srcStages =
+            transition || access.writes
+                ? state.writeStages | state.readStages
+                : state.writeStages;
+        if (transition) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = state.writeAccess;
+            barrier.dstAccessMask = info.access;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = info.layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = resource.image;
+            barrier.subresourceRange = {resource.aspect, 0, 1, 0, 1};
+            barriers.images.push_back(barrier);
+        } else {
+            barriers.srcAccess |= state.writeAccess;
+            barriers.dstAccess |= info.access;
+        }
+        barriers.srcStages |=
+            srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        barriers.dstStages |= info.stages;
+
+        if (transition || access.writes) {
+            // a layout transition counts as a write that is visible to the
+            // stages it was made for
+            state.layout = transition ? info.layout : state.layout;
+            state.writeStages = info.stages;
+            state.writeAccess = access.writes ? info.access & WRITE_ACCESS : 0;
+            state.readStages = 0;
+            state.visibleStages = info.stages;
+            state.visibleAccess = info.access;
+        } else {
+            state.visibleStages |= info.stages;
+            state.visibleAccess |= info.access;
+        }
+    } else if (access.writes) {
+        // first write, nothing to wait for
+        state.writeStages = info.stages;
+        state.writeAccess = info.access & WRITE_ACCESS;
+        state.readStages = 0;
+        state.visibleStages = info.stages;
+        state.visibleAccess = info.access;
+    }
+    if (access.reads) state.readStages |= info.stages;
+}
+
+bool LveRenderGraph::canMerge(const Pass& previous, const Pass& pass) const {
+    if (!previous.isGraphics() || !pass.isGraphics()) return false;
+    if (previous.secondary != pass.secondary ||
+        previous.renderArea.width != pass.renderArea.width ||
+        previous.renderArea.height != pass.renderArea.height ||
+        previous.colors.size() != pass.colors.size() ||
+        previous.hasDepth != pass.hasDepth) {
+        return false;
+    }
+    for (size_t i = 0; i < pass.colors.size(); i++) {
+        if (pass.colors[i].resource != previous.colors[i].resource ||
+            pass.colors[i].loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR) {
+            return false;
+        }
+    }
+    return !pass.hasDepth ||
+           (pass.depth.resource == previous.depth.resource &&
+            pass.depth.loadOp != VK_ATTACHMENT_LOAD_OP_CLEAR);
+}
+
+void LveRenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+                                    const Barriers& barriers) {
+    if (barriers.empty()) return;
+
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = barriers.srcAccess;
+    memoryBarrier.dstAccessMask = barriers.dstAccess;
+    const bool hasMemoryBarrier =
+        barriers.srcAccess != 0 || barriers.dstAccess != 0;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         barriers.srcStages,
+                         barriers.dstStages,
+                         0,
+                         hasMemoryBarrier ? 1 : 0,
+                         &memoryBarrier,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(barriers.images.size()),
+                         barriers.images.data());
+    stats.imageBarriers += static_cast<uint32_t>(barriers.images.size());
+    if (hasMemoryBarrier) stats.memoryBarriers++;
+}
+
+void LveRenderGraph::beginRendering(VkCommandBuffer commandBuffer,
+                                    const std::vector<size_t>& order,
+                                    size_t first,
+                                    size_t last) {
+    const auto& pass = passes[order[first]];
+
+    // contents only need storing when something after the scope reads them
+    auto storeOp = [&](ResourceId id) {
+        const auto& resource = resources[id];
+        if (resource.imported && resource.import.preserve) {
+            return VK_ATTACHMENT_STORE_OP_STORE;
+        }
+        for (size_t position = last + 1; position < order.size();
+             position++) {
+            for (const auto& access : passes[order[position]].accesses) {
+                if (access.resource == id && access.reads) {
+                    return VK_ATTACHMENT_STORE_OP_STORE;
+                }
+            }
+        }
+        return VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    };
+    auto attachmentInfo = [&](const Attachment& attachment,
+                              VkImageLayout layout) {
+        VkRenderingAttachmentInfoKHR info{};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        info.imageView = resources[attachment.resource].view;
+        info.imageLayout = layout;
+        info.loadOp = attachment.loadOp;
+        info.storeOp = storeOp(attachment.resource);
+        info.clearValue = attachment.clearValue;
+        return info;
+    };
+
+    std::vector<VkRenderingAttachmentInfoKHR> colorAttachments;
+    for (const auto& color : pass.colors) {
+        colorAttachments.push_back(
+            attachmentInfo(color, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+    }
+    VkRenderingAttachmentInfoKHR depthAttachment{};
+    if (pass.hasDepth) {
+        depthAttachment = attachmentInfo(
+            pass.depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.flags =
+        pass.secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR
+                       : 0;
+    renderingInfo.renderArea = {{0, 0}, pass.renderArea};
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount =
+        static_cast<uint32_t>(colorAttachments.size());
+    renderingInfo.pColorAttachments = colorAttachments.data();
+    renderingInfo.pDepthAttachment = pass.hasDepth ? &depthAttachment : nullptr;
+    lveDevice.cmdBeginRendering(commandBuffer, &renderingInfo);
+
+    if (!pass.secondary) {
+        VkViewport viewport{};
+        viewport.width = static_cast<float>(pass.renderArea.width);
+        viewport.height = static_cast<float>(pass.renderArea.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{{0, 0}, pass.renderArea};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+}
+
+void LveRenderGraph::execute(VkCommandBuffer commandBuffer) {
+    stats = Stats{};
+    stats.passes = static_cast<uint32_t>(passes.size());
+
+    auto order = cullPasses();
+    stats.culledPasses = static_cast<uint32_t>(passes.size() - order.size());
+    collectUsage(order);
+    for (size_t position : order) {
+        const auto& pass = passes[position];
+        assert((!pass.isGraphics() || lveDevice.hasDynamicRendering()) &&
+               "Graphics passes need dynamic rendering");
+        assert((!pass.isGraphics() ||
+                (pass.renderArea.width > 0 && pass.renderArea.height > 0)) &&
+               "Graphics pass without a render area");
+    }
+    allocateTransients();
+    const auto& aliased = frameTransients[frameIndex].aliased;
+
+    std::vector<State> states(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        if (!resources[i].imported || !resources[i].isImage) continue;
+        const auto& import = resources[i].import;
+        states[i].layout = import.initialLayout;
+        states[i].writeStages = import.initialStages;
+        states[i].writeAccess = import.initialAccess;
+    }
+
+    // Barriers go before each pass; a pass merged into the rendering scope
+    // of the previous one must not need any
+    std::vector<Barriers> passBarriers(order.size());
+    std::vector<bool> merged(order.size());
+    for (size_t position = 0; position < order.size(); position++) {
+        const auto& pass = passes[order[position]];
+        auto& barriers = passBarriers[position];
+
+        for (const auto& access : pass.accesses) {
+            auto& resource = resources[access.resource];
+            if (resource.imported ||
+                resource.firstUse != static_cast<int>(position)) {
+                continue;
+            }
+            // first use of a transient: wait for whatever used the memory
+            auto& state = states[access.resource];
+            for (ResourceId previous : aliased[access.resource]) {
+                state.writeStages |= states[previous].writeStages |
+                                     states[previous].readStages;
+                state.writeAccess |= states[previous].writeAccess;
+            }
+        }
+
+        auto isAttachment = [](const Access& access) {
+            return access.usage == Usage::COLOR_ATTACHMENT ||
+                   access.usage == Usage::DEPTH_ATTACHMENT;
+        };
+        merged[position] =
+            position > 0 && canMerge(passes[order[position - 1]], pass);
+        for (const auto& access : pass.accesses) {
+            if (!isAttachment(access) &&
+                needsBarrier(states[access.resource], access)) {
+                merged[position] = false;
+            }
+        }
+
+        for (const auto& access : pass.accesses) {
+            auto& state = states[access.resource];
+            if (merged[position] && isAttachment(access)) {
+                // ordered by the rasterization order within the scope
+                state.readStages = 0;
+                continue;
+            }
+            addBarrier(state, resources[access.resource], access, barriers);
+        }
+        if (merged[position]) stats.mergedPasses++;
+    }
+
+    // timestamps cannot go into a scope of secondary command buffers, so
+    // those are timed around the whole scope
+    auto beginScope = [&](const Pass& pass) {
+        return profiler != nullptr
+                   ? profiler->beginScope(commandBuffer, pass.name)
+                   : LveGpuProfiler::NO_SCOPE;
+    };
+    auto endScope = [&](LveGpuProfiler::ScopeHandle scope) {
+        if (profiler != nullptr) profiler->endScope(commandBuffer, scope);
+    };
+    LveGpuProfiler::ScopeHandle renderingScope = LveGpuProfiler::NO_SCOPE;
+    for (size_t position = 0; position < order.size(); position++) {
+        const auto& pass = passes[order[position]];
+        const bool timedAroundScope = pass.isGraphics() && pass.secondary;
+        if (!merged[position]) {
+            recordBarriers(commandBuffer, passBarriers[position]);
+            if (pass.isGraphics()) {
+                size_t last = position;
+                while (last + 1 < order.size() && merged[last + 1]) last++;
+                if (timedAroundScope) renderingScope = beginScope(pass);
+                beginRendering(commandBuffer, order, position, last);
+            }
+        }
+        auto passScope =
+            timedAroundScope ? LveGpuProfiler::NO_SCOPE : beginScope(pass);
+        if (pass.callback) pass.callback(commandBuffer);
+        endScope(passScope);
+        const bool scopeContinues =
+            position + 1 < order.size() && merged[position + 1];
+        if (pass.isGraphics() && !scopeContinues) {
+            lveDevice.cmdEndRendering(commandBuffer);
+            endScope(renderingScope);
+            renderingScope = LveGpuProfiler::NO_SCOPE;
+        }
+    }
+
+    // hand imported images over in the layout their owner expects
+    Barriers finalBarriers{};
+    for (size_t i = 0; i < resources.size(); i++) {
+        const auto& resource = resources[i];
+        if (!resource.imported || !resource.isImage ||
+            resource.firstUse < 0 ||
+            resource.import.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+            resource.import.finalLayout == states[i].layout) {
+            continue;
+        }
+        const auto& state = states[i];
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = resource.import.finalLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.image;
+        barrier.subresourceRange = {resource.aspect, 0, 1, 0, 1};
+        finalBarriers.images.push_back(barrier);
+        finalBarriers.srcStages |= state.writeStages | state.readStages;
+        // whatever the owner records next chains onto ALL_COMMANDS
+        finalBarriers.dstStages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    if (!finalBarriers.images.empty() && finalBarriers.srcStages == 0) {
+        finalBarriers.srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    recordBarriers(commandBuffer, finalBarriers);
+}
+
+}  // namespace lve
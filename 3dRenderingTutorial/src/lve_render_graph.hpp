@@ -0,0 +1,259 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_gpu_profiler.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// Records one frame from passes that declare which resources they read
+// and write, instead of hand-written barriers and render passes. On
+// execute the graph
+//  - culls passes whose results nothing uses,
+//  - inserts the pipeline barriers and layout transitions the declared
+//    accesses need, and nothing where an access needs none,
+//  - merges consecutive graphics passes on the same attachments into one
+//    dynamic rendering scope, and picks store ops from later reads,
+//  - places transient images and buffers whose lifetimes do not overlap
+//    at the same memory.
+//
+// Resources are either imported (owned elsewhere, e.g. the swapchain
+// image) or transient (created by the graph for one frame). Transients are
+// kept per frame slot and only recreated when the frame's transients or
+// their lifetimes change. Graphics passes need VK_KHR_dynamic_rendering.
+class LveRenderGraph {
+   public:
+    using ResourceId = uint32_t;
+
+    // How a pass accesses a resource; decides stage, access mask and image
+    // layout of the barriers
+    enum class Usage {
+        COLOR_ATTACHMENT,  // only through PassBuilder::color
+        DEPTH_ATTACHMENT,  // only through PassBuilder::depth
+        SAMPLED_FRAGMENT,
+        SAMPLED_COMPUTE,
+        STORAGE_READ_COMPUTE,
+        STORAGE_WRITE_COMPUTE,
+        INDIRECT_READ,  // buffers only
+        TRANSFER_SRC,
+        TRANSFER_DST,
+    };
+
+    struct ImportedImage {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // Stages and writes of earlier work on the image the first access
+        // has to wait for, e.g. the stage the acquire semaphore is waited at
+        VkPipelineStageFlags initialStages = 0;
+        VkAccessFlags initialAccess = 0;
+        // Layout the image is left in, UNDEFINED to leave it as it is
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // Whether the contents are used after the frame: writes to the
+        // image are then never culled and attachments always stored
+        bool preserve = false;
+    };
+
+    struct ImageDesc {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+    };
+
+    // Of the last execute
+    struct Stats {
+        uint32_t passes = 0;
+        uint32_t culledPasses = 0;
+        // Passes recorded into the rendering scope of the previous pass
+        uint32_t mergedPasses = 0;
+        uint32_t imageBarriers = 0;
+        uint32_t memoryBarriers = 0;
+        // Transient memory without and with aliasing
+        VkDeviceSize transientBytes = 0;
+        VkDeviceSize allocatedBytes = 0;
+    };
+
+    class PassBuilder {
+       public:
+        // Render area of the attachments, from the origin
+        PassBuilder& renderArea(VkExtent2D extent);
+        PassBuilder& color(ResourceId resource,
+                           VkAttachmentLoadOp loadOp,
+                           VkClearColorValue clearColor = {});
+        PassBuilder& depth(ResourceId resource,
+                           VkAttachmentLoadOp loadOp,
+                           VkClearDepthStencilValue clearDepth = {1.f, 0});
+        PassBuilder& read(ResourceId resource, Usage usage);
+        PassBuilder& write(ResourceId resource, Usage usage);
+        // The pass only executes secondary command buffers
+        PassBuilder& secondaryCommandBuffers();
+        // Keeps the pass even when nothing reads what it writes, e.g. when
+        // it updates resources outside the graph
+        PassBuilder& sideEffects();
+        // Records the pass; attachments are already bound, and viewport and
+        // scissor set to the render area unless secondaryCommandBuffers
+        PassBuilder& execute(std::function<void(VkCommandBuffer)> callback);
+
+       private:
+        friend class LveRenderGraph;
+        PassBuilder(LveRenderGraph& graph, size_t pass)
+            : graph{graph}, pass{pass} {}
+
+        LveRenderGraph& graph;
+        size_t pass;
+    };
+
+    explicit LveRenderGraph(LveDevice& device);
+    ~LveRenderGraph();
+
+    LveRenderGraph(const LveRenderGraph&) = delete;
+    LveRenderGraph& operator=(const LveRenderGraph&) = delete;
+
+    // Starts declaring a new frame. The previous frame on frameIndex must
+    // have completed, its transients may be destroyed or reused.
+    void reset(int frameIndex);
+
+    ResourceId importImage(const std::string& name, const ImportedImage& image);
+    ResourceId importBuffer(const std::string& name,
+                            VkBuffer buffer,
+                            VkDeviceSize size);
+    ResourceId createImage(const std::string& name, const ImageDesc& desc);
+    ResourceId createBuffer(const std::string& name, VkDeviceSize size);
+    // Throws when no resource has the name
+    ResourceId getResource(const std::string& name) const;
+    // Transients only exist while execute records the passes
+    VkImage getImage(ResourceId resource) const;
+    VkImageView getImageView(ResourceId resource) const;
+    VkBuffer getBuffer(ResourceId resource) const;
+
+    PassBuilder addPass(const std::string& name);
+
+    // Culls, merges and allocates, then records all passes
+    void execute(VkCommandBuffer commandBuffer);
+    // Times each kept pass as a scope of its name, nullptr to stop. Merged
+    // passes on secondary command buffers are timed together under the
+    // first one's name.
+    void setProfiler(LveGpuProfiler* profiler) { this->profiler = profiler; }
+    Stats getStats() const { return stats; }
+
+   private:
+    struct Resource {
+        std::string name;
+        bool isImage = true;
+        bool imported = false;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        ImageDesc desc{};
+        VkImageAspectFlags aspect = 0;
+        VkDeviceSize size = 0;
+        ImportedImage import{};
+        // accumulated from the kept passes
+        VkImageUsageFlags imageUsage = 0;
+        VkBufferUsageFlags bufferUsage = 0;
+        int firstUse = -1;
+        int lastUse = -1;
+    };
+
+    struct Access {
+        ResourceId resource;
+        Usage usage;
+        bool reads;
+        bool writes;
+    };
+
+    struct Attachment {
+        ResourceId resource;
+        VkAttachmentLoadOp loadOp;
+        VkClearValue clearValue;
+    };
+
+    struct Pass {
+        std::string name;
+        VkExtent2D renderArea{};
+        std::vector<Attachment> colors;
+        bool hasDepth = false;
+        Attachment depth{};
+        // attachments included
+        std::vector<Access> accesses;
+        bool secondary = false;
+        bool sideEffects = false;
+        std::function<void(VkCommandBuffer)> callback;
+
+        bool isGraphics() const { return hasDepth || !colors.empty(); }
+    };
+
+    // Synchronization state of a resource while the passes are walked
+    struct State {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        // reads since the last write
+        VkPipelineStageFlags readStages = 0;
+        // stages and accesses the last write is already visible to
+        VkPipelineStageFlags visibleStages = 0;
+        VkAccessFlags visibleAccess = 0;
+    };
+
+    struct Barriers {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        VkAccessFlags srcAccess = 0;
+        VkAccessFlags dstAccess = 0;
+        std::vector<VkImageMemoryBarrier> images;
+
+        bool empty() const { return srcStages == 0 && images.empty(); }
+    };
+
+    // Transients of one frame slot
+    struct Transients {
+        // Describes the transients and their lifetimes; equal keys can
+        // reuse the allocation
+        std::string key;
+        std::vector<VkImage> images;
+        std::vector<VkImageView> views;
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDeviceMemory> memory;
+        // Per resource: transients that used the same memory before
+        std::vector<std::vector<ResourceId>> aliased;
+        VkDeviceSize transientBytes = 0;
+        VkDeviceSize allocatedBytes = 0;
+    };
+
+    ResourceId addResource(Resource resource);
+    void addAccess(size_t pass, const Access& access);
+    std::vector<size_t> cullPasses();
+    void collectUsage(const std::vector<size_t>& order);
+    void allocateTransients();
+    void destroyTransients(Transients& transients);
+    bool needsBarrier(const State& state, const Access& access) const;
+    void addBarrier(State& state,
+                    const Resource& resource,
+                    const Access& access,
+                    Barriers& barriers);
+    bool canMerge(const Pass& previous, const Pass& pass) const;
+    void recordBarriers(VkCommandBuffer commandBuffer,
+                        const Barriers& barriers);
+    void beginRendering(VkCommandBuffer commandBuffer,
+                        const std::vector<size_t>& order,
+                        size_t first,
+                        size_t last);
+
+    LveDevice& lveDevice;
+    std::vector<Resource> resources;
+    std::unordered_map<std::string, ResourceId> resourceNames;
+    std::vector<Pass> passes;
+    std::vector<Transients> frameTransients;
+    int frameIndex = 0;
+    Stats stats{};
+    LveGpuProfiler* profiler = nullptr;
+};
+
+}  // namespace lve
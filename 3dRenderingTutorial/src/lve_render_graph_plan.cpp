@@ -0,0 +1,90 @@
+#include "lve_render_graph_plan.hpp"
+
+// std
+#include <algorithm>
+
+namespace lve {
+
+namespace {
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool livesWith(const TransientPlacement& a, const TransientPlacement& b) {
+    return a.firstUse <= b.lastUse && b.firstUse <= a.lastUse;
+}
+
+bool overlaps(const TransientPlacement& a, const TransientPlacement& b) {
+    return a.heap == b.heap && a.offset < b.offset + b.size &&
+           b.offset < a.offset + a.size;
+}
+
+}  // namespace
+
+std::vector<size_t> cullGraphPasses(const std::vector<GraphPassUse>& passes,
+                                    const std::vector<bool>& preserved) {
+    std::vector<bool> needed = preserved;
+    std::vector<bool> kept(passes.size());
+    for (size_t i = passes.size(); i-- > 0;) {
+        const auto& pass = passes[i];
+        kept[i] = pass.sideEffects;
+        for (const auto& access : pass.accesses) {
+            if (access.writes && needed[access.resource]) kept[i] = true;
+        }
+        if (!kept[i]) continue;
+        for (const auto& access : pass.accesses) {
+            if (access.reads) needed[access.resource] = true;
+        }
+    }
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (kept[i]) order.push_back(i);
+    }
+    return order;
+}
+
+std::vector<uint64_t> placeTransients(
+    std::vector<TransientPlacement>& placements) {
+    std::stable_sort(placements.begin(),
+                     placements.end(),
+                     [](const TransientPlacement& a,
+                        const TransientPlacement& b) {
+                         return a.size > b.size;
+                     });
+
+    std::vector<uint64_t> heapSizes;
+    for (size_t i = 0; i < placements.size(); i++) {
+        auto& placement = placements[i];
+        placement.offset = 0;
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            for (size_t j = 0; j < i; j++) {
+                const auto& other = placements[j];
+                if (livesWith(placement, other) &&
+                    overlaps(placement, other)) {
+                    placement.offset = alignUp(other.offset + other.size,
+                                               placement.alignment);
+                    moved = true;
+                }
+            }
+        }
+
+        if (placement.heap >= heapSizes.size()) {
+            heapSizes.resize(placement.heap + 1, 0);
+        }
+        heapSizes[placement.heap] =
+            std::max(heapSizes[placement.heap],
+                     placement.offset + placement.size);
+    }
+    return heapSizes;
+}
+
+bool reusesMemory(const TransientPlacement& earlier,
+                  const TransientPlacement& later) {
+    return overlaps(earlier, later) && earlier.lastUse < later.firstUse;
+}
+
+}  // namespace lve
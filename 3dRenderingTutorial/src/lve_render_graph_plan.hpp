@@ -0,0 +1,55 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// The decisions of LveRenderGraph that need no device: which passes a
+// frame keeps and where its transients go in memory. Kept apart from the
+// Vulkan calls so `make check` can test them without a GPU.
+
+struct GraphPassAccess {
+    uint32_t resource = 0;
+    bool reads = false;
+    bool writes = false;
+};
+
+struct GraphPassUse {
+    std::vector<GraphPassAccess> accesses;
+    bool sideEffects = false;
+};
+
+// Indices of the passes to record, in order. Walking backwards from what
+// outlives the frame (preserved, indexed by resource), a pass is kept when
+// it has side effects or writes a resource a later kept pass reads.
+std::vector<size_t> cullGraphPasses(const std::vector<GraphPassUse>& passes,
+                                    const std::vector<bool>& preserved);
+
+struct TransientPlacement {
+    uint32_t resource = 0;
+    uint64_t size = 0;
+    uint64_t alignment = 1;
+    // Only placements of the same heap can share memory
+    uint32_t heap = 0;
+    // Positions of the first and last kept pass using the resource
+    int firstUse = 0;
+    int lastUse = 0;
+    // Set by placeTransients
+    uint64_t offset = 0;
+};
+
+// Sorts placements largest first and puts each at the lowest aligned
+// offset of its heap that overlaps no placement before it whose lifetime
+// overlaps its own. Returns the size each heap needs, indexed by heap.
+std::vector<uint64_t> placeTransients(
+    std::vector<TransientPlacement>& placements);
+
+// Whether later uses memory of earlier after earlier's last use, so the
+// first access of later has to wait for the accesses of earlier
+bool reusesMemory(const TransientPlacement& earlier,
+                  const TransientPlacement& later);
+
+}  // namespace lve
@@ -1,15 +1,47 @@
 #include "lve_renderer.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
 
+#include "lve_cpu_profiler.hpp"
+#include "lve_timeline.hpp"
+
 namespace lve {
-LveRenderer::LveRenderer(LveWindow& window, LveDevice& device)
+
+namespace {
+
+VkImageAspectFlags depthAspectMask(VkFormat depthFormat) {
+    if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+        depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+}  // namespace
+
+LveRenderer::LveRenderer(LveWindow& window,
+                         LveDevice& device,
+                         bool preferDynamicRendering,
+                         const FramePacing& framePacing)
     : lveWindow{window},
-      lveDevice{device} {
+      lveDevice{device},
+      framePacing{framePacing},
+      gpuProfiler{device},
+      dynamicRendering{preferDynamicRendering &&
+                       device.hasDynamicRendering()} {
     recreateSwapChain();
+    if (lveSwapchain == nullptr) {
+        throw std::runtime_error(
+            "Cannot create a swap chain for a minimized window");
+    }
     createCommandBuffers();
+    if (dynamicRendering) {
+        frameGraph = std::make_unique<LveRenderGraph>(lveDevice);
+        frameGraph->setProfiler(&gpuProfiler);
+    }
 }
 
 LveRenderer::~LveRenderer() { freeCommandBuffers(); }
@@ -38,38 +70,174 @@ void LveRenderer::freeCommandBuffers() {
     commandBuffers.clear();
 }
 
+void LveRenderer::readFrameTimestamps() {
+    // the timestamps are only used for statistics and resolution scaling,
+    // so a device without them just renders at the full resolution
+    if (gpuProfiler.readResults(currentFrameIndex)) {
+        resolutionScaler.addFrameTime(gpuProfiler.getFrameMilliseconds());
+    }
+    frameStats.pipelineStatistics = gpuProfiler.getPipelineStatistics();
+}
+
 void LveRenderer::recreateSwapChain() {
     auto extent = lveWindow.getExtent();
-    while (extent.width == 0 || extent.height == 0) {
-        extent = lveWindow.getExtent();
-        glfwWaitEvents();
+    if (extent.width == 0 || extent.height == 0) {
+        // Minimized: beginFrame skips frames until the window has a size
+        // again, so the caller's loop keeps running instead of blocking here
+        swapChainStale = true;
+        return;
     }
-
-    vkDeviceWaitIdle(lveDevice.device());
+    swapChainStale = false;
 
     if (lveSwapchain == nullptr) {
-        lveSwapchain = std::make_unique<LveSwapChain>(lveDevice, extent);
-    } else {
-        std::shared_ptr<LveSwapChain> oldSwapChain = std::move(lveSwapchain);
-        lveSwapchain =
-            std::make_unique<LveSwapChain>(lveDevice, extent, oldSwapChain);
+        lveSwapchain = std::make_unique<LveSwapChain>(
+            lveDevice,
+            extent,
+            framePacing,
+            depthUsage,
+            resolutionScaler.getScaling().enabled);
+        return;
+    }
 
-        if (!oldSwapChain->compareSwapFormats(*lveSwapchain.get())) {
-            throw std::runtime_error(
-                "Swap chain image or depth format has changed");
-        }
+    auto start = std::chrono::high_resolution_clock::now();
+    std::shared_ptr<LveSwapChain> oldSwapChain = std::move(lveSwapchain);
+    lveSwapchain =
+        std::make_unique<LveSwapChain>(lveDevice,
+                                       extent,
+                                       framePacing,
+                                       depthUsage,
+                                       resolutionScaler.getScaling().enabled,
+                                       oldSwapChain);
+
+    if (!oldSwapChain->compareSwapFormats(*lveSwapchain.get())) {
+        throw std::runtime_error(
+            "Swap chain image or depth format has changed");
+    }
+
+    // No vkDeviceWaitIdle: frames in flight finish on the old swap chain
+    // while new frames already use the new one. The frame slots carry over
+    // unless their count changed, in which case they restart at 0.
+    if (oldSwapChain->getFramesInFlight() !=
+        lveSwapchain->getFramesInFlight()) {
+        frameStartTimes.fill({});
+    }
+    currentFrameIndex = lveSwapchain->getCurrentFrame();
+    retiredSwapChains.push_back({std::move(oldSwapChain), 0});
+
+    float milliseconds =
+        std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start)
+            .count();
+    resizeStats.recreations++;
+    resizeStats.totalMilliseconds += milliseconds;
+    resizeStats.maxMilliseconds =
+        std::max(resizeStats.maxMilliseconds, milliseconds);
+
+    // Pipelines stay valid: with dynamic rendering they only depend on the
+    // formats checked above, and the new render passes have the same
+    // formats and so are compatible with the old ones.
+}
+
+void LveRenderer::releaseRetiredSwapChains() {
+    // Waiting for the first frame after the old chain's last one, rather
+    // than for the last one itself, leaves its final presents time to be
+    // processed: without VK_EXT_swapchain_maintenance1 there is no signal
+    // for when a present is done with the chain's images and semaphores.
+    auto& timeline = lveDevice.timeline();
+    retiredSwapChains.erase(
+        std::remove_if(retiredSwapChains.begin(),
+                       retiredSwapChains.end(),
+                       [&](const RetiredSwapChain& retired) {
+                           return retired.releaseValue != 0 &&
+                                  timeline.isComplete(retired.releaseValue);
+                       }),
+        retiredSwapChains.end());
+}
+
+void LveRenderer::setFramePacing(const FramePacing& pacing) {
+    assert(!isFrameStarted &&
+           "Cannot change frame pacing while frame is in progress");
+    framePacing = pacing;
+    recreateSwapChain();
+}
+
+void LveRenderer::setDepthUsage(DepthUsage usage) {
+    assert(!isFrameStarted &&
+           "Cannot change depth usage while frame is in progress");
+    if (usage == depthUsage) return;
+    depthUsage = usage;
+    recreateSwapChain();
+}
+
+bool LveRenderer::supportsResolutionScaling() {
+    if (!gpuProfiler.isSupported()) return false;
+    auto capabilities = lveDevice.getSwapChainSupport().capabilities;
+    return (capabilities.supportedUsageFlags &
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0 &&
+           lveDevice.hasFormatFeatures(
+               lveSwapchain->getSwapChainImageFormat(),
+               VK_IMAGE_TILING_OPTIMAL,
+               VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+                   VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                   VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                   VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
+
+void LveRenderer::setResolutionScaling(const ResolutionScaling& scaling) {
+    assert(!isFrameStarted &&
+           "Cannot change resolution scaling while frame is in progress");
+    if (scaling.enabled && !supportsResolutionScaling()) {
+        throw std::runtime_error("Resolution scaling is not supported");
     }
+    bool toggled = scaling.enabled != resolutionScaler.getScaling().enabled;
+    resolutionScaler.setScaling(scaling);
+    if (toggled) recreateSwapChain();
+}
+
+LveRenderer::LatencyStats LveRenderer::takeLatencyStats() {
+    LatencyStats stats = latencyStats;
+    latencyStats = {};
+    return stats;
+}
 
-    // createPipeline();
-    // TODO
+LveRenderer::ResizeStats LveRenderer::takeResizeStats() {
+    ResizeStats stats = resizeStats;
+    resizeStats = {};
+    return stats;
 }
 
 VkCommandBuffer LveRenderer::beginFrame() {
     assert(!isFrameStarted &&
            "Cant call beginFrame while frame is aleady in progress");
+    // mostly waiting for the frame slot and the swapchain image
+    LVE_CPU_ZONE("begin frame");
 
+    if (swapChainStale) {
+        recreateSwapChain();
+        if (swapChainStale) return nullptr;
+    }
+    releaseRetiredSwapChains();
+
+    auto startTime = std::chrono::high_resolution_clock::now();
     auto result = lveSwapchain->acquireNextImage(&currentImageIndex);
 
+    // acquireNextImage waited for the frame that last used this index
+    auto& previousStart = frameStartTimes[currentFrameIndex];
+    if (previousStart != std::chrono::high_resolution_clock::time_point{}) {
+        float milliseconds =
+            std::chrono::duration<float, std::chrono::milliseconds::period>(
+                lveSwapchain->getFrameCompletedTime() - previousStart)
+                .count();
+        latencyStats.samples++;
+        latencyStats.totalMilliseconds += milliseconds;
+        latencyStats.maxMilliseconds =
+            std::max(latencyStats.maxMilliseconds, milliseconds);
+        previousStart = {};
+    }
+
+    // before recording, so the whole frame uses one resolution scale
+    readFrameTimestamps();
+
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreateSwapChain();
         return nullptr;
@@ -80,6 +248,7 @@ VkCommandBuffer LveRenderer::beginFrame() {
     }
 
     isFrameStarted = true;
+    previousStart = startTime;
 
     auto commandBuffer = getCurrentCommandBuffer();
 
@@ -89,71 +258,269 @@ VkCommandBuffer LveRenderer::beginFrame() {
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("Failed to begin recording command buffers");
     }
+    gpuProfiler.beginFrame(commandBuffer, currentFrameIndex);
+    if (frameGraph) importFrameTargets();
 
     return commandBuffer;
 };
 
+void LveRenderer::importFrameTargets() {
+    // acquireNextImage waited for the previous frame on this slot
+    frameGraph->reset(currentFrameIndex);
+
+    const bool sceneTarget = lveSwapchain->hasSceneTarget();
+    LveRenderGraph::ImportedImage color{};
+    color.image = sceneTarget ? lveSwapchain->getSceneImage(currentFrameIndex)
+                              : lveSwapchain->getImage(currentImageIndex);
+    color.view = sceneTarget
+                     ? lveSwapchain->getSceneImageView(currentFrameIndex)
+                     : lveSwapchain->getImageView(currentImageIndex);
+    color.format = lveSwapchain->getSwapChainImageFormat();
+    color.extent = getSwapChainExtent();
+    // the acquire semaphore is waited for at COLOR_ATTACHMENT_OUTPUT; a
+    // scene target was last read by the blit of its previous frame
+    color.initialStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                          (sceneTarget ? VK_PIPELINE_STAGE_TRANSFER_BIT : 0);
+    // upscaleSceneTarget expects the scene target as an attachment
+    color.finalLayout = sceneTarget ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color.preserve = true;
+    frameGraph->importImage(FRAME_COLOR, color);
+
+    LveRenderGraph::ImportedImage depth{};
+    depth.image = lveSwapchain->getDepthImage(currentFrameIndex);
+    depth.view = lveSwapchain->getDepthImageView(currentFrameIndex);
+    depth.format = lveSwapchain->getSwapChainDepthFormat();
+    depth.extent = getSwapChainExtent();
+    depth.initialStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    depth.initialAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    frameGraph->importImage(FRAME_DEPTH, depth);
+}
+
+void LveRenderer::executeFrameGraph(VkCommandBuffer commandBuffer) {
+    assert(isFrameStarted &&
+           "Cannot call executeFrameGraph while frame is not started");
+    assert(commandBuffer == getCurrentCommandBuffer() &&
+           "Can't execute frame graph on command buffer from a different "
+           "frame");
+    getFrameGraph().execute(commandBuffer);
+}
+
 void LveRenderer::endFrame() {
     assert(isFrameStarted && "Cannot call endFrame when frame is not started");
+    LVE_CPU_ZONE("end frame");
     auto commandBuffer = getCurrentCommandBuffer();
 
+    if (lveSwapchain->hasSceneTarget()) {
+        upscaleSceneTarget(commandBuffer);
+    }
+    gpuProfiler.endFrame(commandBuffer);
+
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("Failed to record command buffer");
     }
 
-    auto result =
-        lveSwapchain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+    auto result = lveSwapchain->submitCommandBuffers(
+        &commandBuffer, &currentImageIndex, submitWaits);
+    submitWaits.clear();
+    LveCounters::Values counters = lveDevice.counters().get();
+    frameStats.counters = counters - endFrameCounters;
+    endFrameCounters = counters;
+    for (auto& retired : retiredSwapChains) {
+        if (retired.releaseValue == 0) {
+            retired.releaseValue = lveSwapchain->getSubmittedFrameValue();
+        }
+    }
+
+    // advanced before a recreation, which may restart the frame index at 0
+    isFrameStarted = false;
+    currentFrameIndex =
+        (currentFrameIndex + 1) % lveSwapchain->getFramesInFlight();
+
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
         lveWindow.wasWindowResized()) {
         lveWindow.resetWindowResizedFlag();
         recreateSwapChain();
-    }
-    if (result != VK_SUCCESS) {
+    } else if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to present swapchain image");
     }
-
-    isFrameStarted = false;
-    currentFrameIndex =
-        (currentFrameIndex + 1) % LveSwapChain::MAX_FRAMES_IN_FLIGHT;
 };
 
-void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                           VkSubpassContents contents) {
     assert(isFrameStarted &&
            "Cannot call beginSwapChainRenderPass while frame is not started");
     assert(commandBuffer == getCurrentCommandBuffer() &&
            "Can't begin render pass on command buffer from a different frame");
 
+    if (dynamicRendering) {
+        beginRendering(commandBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, contents);
+    } else {
+        beginRenderPass(
+            commandBuffer, lveSwapchain->getRenderPass(), contents);
+    }
+}
+
+void LveRenderer::resumeSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                            VkSubpassContents contents) {
+    assert(isFrameStarted &&
+           "Cannot call resumeSwapChainRenderPass while frame is not started");
+    assert(commandBuffer == getCurrentCommandBuffer() &&
+           "Can't resume render pass on command buffer from a different frame");
+    assert(lveSwapchain->getDepthUsage() == DepthUsage::STORED &&
+           "Cannot resume render pass whose depth was not stored");
+
+    if (dynamicRendering) {
+        beginRendering(commandBuffer, VK_ATTACHMENT_LOAD_OP_LOAD, contents);
+    } else {
+        beginRenderPass(
+            commandBuffer, lveSwapchain->getResumeRenderPass(), contents);
+    }
+}
+
+void LveRenderer::beginRenderPass(VkCommandBuffer commandBuffer,
+                                  VkRenderPass renderPass,
+                                  VkSubpassContents contents) {
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = lveSwapchain->getRenderPass();
+    renderPassInfo.renderPass = renderPass;
     renderPassInfo.framebuffer =
-        lveSwapchain->getFrameBuffer(currentImageIndex);
+        lveSwapchain->getFrameBuffer(currentImageIndex, currentFrameIndex);
 
     renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = lveSwapchain->getSwapChainExtent();
+    renderPassInfo.renderArea.extent = getRenderExtent();
 
     std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
+    clearValues[0].color = CLEAR_COLOR;
     clearValues[1].depthStencil = {1.0f, 0};
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(
-        commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+    if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+        setViewportAndScissor(commandBuffer);
+    }
+};
 
+void LveRenderer::beginRendering(VkCommandBuffer commandBuffer,
+                                 VkAttachmentLoadOp loadOp,
+                                 VkSubpassContents contents) {
+    const bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+
+    // Same transitions as the render passes: the color image comes from the
+    // presentation engine (or our previous endSwapChainRenderPass when
+    // resuming), the depth image stays an attachment between passes. A
+    // scene target stays an attachment as well.
+    const bool sceneTarget = lveSwapchain->hasSceneTarget();
+    VkImage colorImage = sceneTarget
+                             ? lveSwapchain->getSceneImage(currentFrameIndex)
+                             : lveSwapchain->getImage(currentImageIndex);
+    VkImageView colorImageView =
+        sceneTarget ? lveSwapchain->getSceneImageView(currentFrameIndex)
+                    : lveSwapchain->getImageView(currentImageIndex);
+    VkImageLayout resumedColorLayout =
+        sceneTarget ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    std::array<VkImageMemoryBarrier, 2> barriers{};
+    auto& colorBarrier = barriers[0];
+    colorBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    colorBarrier.srcAccessMask =
+        load ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
+    colorBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    colorBarrier.oldLayout =
+        load ? resumedColorLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+    colorBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    colorBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    colorBarrier.image = colorImage;
+    colorBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    auto& depthBarrier = barriers[1];
+    depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthBarrier.oldLayout = load
+                                 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                 : VK_IMAGE_LAYOUT_UNDEFINED;
+    depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthBarrier.image = lveSwapchain->getDepthImage(currentFrameIndex);
+    depthBarrier.subresourceRange = {
+        depthAspectMask(lveSwapchain->getSwapChainDepthFormat()), 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                             VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+
+    VkRenderingAttachmentInfoKHR colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = colorImageView;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = loadOp;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue.color = CLEAR_COLOR;
+
+    VkRenderingAttachmentInfoKHR depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachment.imageView =
+        lveSwapchain->getDepthImageView(currentFrameIndex);
+    depthAttachment.imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = loadOp;
+    depthAttachment.storeOp =
+        lveSwapchain->getDepthUsage() == DepthUsage::STORED
+            ? VK_ATTACHMENT_STORE_OP_STORE
+            : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.flags =
+        contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+            ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR
+            : 0;
+    renderingInfo.renderArea = {{0, 0}, getRenderExtent()};
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    lveDevice.cmdBeginRendering(commandBuffer, &renderingInfo);
+    if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+        setViewportAndScissor(commandBuffer);
+    }
+}
+
+void LveRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer) {
+    VkExtent2D extent = getRenderExtent();
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width =
-        static_cast<float>(lveSwapchain->getSwapChainExtent().width);
-    viewport.height =
-        static_cast<float>(lveSwapchain->getSwapChainExtent().height);
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
-    VkRect2D scissor{{0, 0}, lveSwapchain->getSwapChainExtent()};
+    VkRect2D scissor{{0, 0}, extent};
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-};
+}
 
 void LveRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
     assert(isFrameStarted &&
@@ -161,6 +528,120 @@ void LveRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
     assert(commandBuffer == getCurrentCommandBuffer() &&
            "Can't end render pass on command buffer from a different frame");
 
-    vkCmdEndRenderPass(commandBuffer);
+    if (!dynamicRendering) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
+
+    lveDevice.cmdEndRendering(commandBuffer);
+    // upscaled in endFrame, which also prepares the image for presenting
+    if (lveSwapchain->hasSceneTarget()) return;
+
+    // finalLayout of the render pass path
+    VkImageMemoryBarrier presentBarrier{};
+    presentBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    presentBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    presentBarrier.dstAccessMask = 0;
+    presentBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    presentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    presentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    presentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    presentBarrier.image = lveSwapchain->getImage(currentImageIndex);
+    presentBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &presentBarrier);
 };
+void LveRenderer::upscaleSceneTarget(VkCommandBuffer commandBuffer) {
+    VkImage sceneImage = lveSwapchain->getSceneImage(currentFrameIndex);
+    VkImage swapChainImage = lveSwapchain->getImage(currentImageIndex);
+
+    std::array<VkImageMemoryBarrier, 2> barriers{};
+    auto& sceneBarrier = barriers[0];
+    sceneBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    sceneBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    sceneBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    sceneBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    sceneBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    sceneBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    sceneBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    sceneBarrier.image = sceneImage;
+    sceneBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    // The acquire semaphore is waited at the color attachment output
+    // stage, which this barrier chains onto
+    auto& swapChainBarrier = barriers[1];
+    swapChainBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    swapChainBarrier.srcAccessMask = 0;
+    swapChainBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    swapChainBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    swapChainBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    swapChainBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    swapChainBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    swapChainBarrier.image = swapChainImage;
+    swapChainBarrier.subresourceRange = {
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+
+    VkExtent2D renderExtent = getRenderExtent();
+    VkExtent2D swapChainExtent = lveSwapchain->getSwapChainExtent();
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {static_cast<int32_t>(renderExtent.width),
+                          static_cast<int32_t>(renderExtent.height),
+                          1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = {static_cast<int32_t>(swapChainExtent.width),
+                          static_cast<int32_t>(swapChainExtent.height),
+                          1};
+    vkCmdBlitImage(commandBuffer,
+                   sceneImage,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   swapChainImage,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1,
+                   &blit,
+                   VK_FILTER_LINEAR);
+
+    // The scene image is cleared from UNDEFINED by the next frame's pass,
+    // so only the swapchain image needs another transition
+    VkImageMemoryBarrier presentBarrier{};
+    presentBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    presentBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    presentBarrier.dstAccessMask = 0;
+    presentBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    presentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    presentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    presentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    presentBarrier.image = swapChainImage;
+    presentBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &presentBarrier);
+}
+
 }  // namespace lve
@@ -1,25 +1,101 @@
 #pragma once
 
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include "lve_device.hpp"
+#include "lve_gpu_profiler.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_render_graph.hpp"
+#include "lve_resolution_scaler.hpp"
 #include "lve_swap_chain.hpp"
 #include "lve_window.hpp"
 
 namespace lve {
 class LveRenderer {
    public:
-    LveRenderer(LveWindow& window, LveDevice& device);
+    // Time from beginFrame, which the app calls right after handling input,
+    // until a later beginFrame saw the frame's timeline value: an upper
+    // bound of input to GPU completion. Scanout is not included.
+    struct LatencyStats {
+        uint32_t samples = 0;
+        float totalMilliseconds = 0.f;
+        float maxMilliseconds = 0.f;
+    };
+    // What a frame did: counters of the work recorded and objects created
+    // since the previous endFrame, and the pipeline statistics of the last
+    // completed frame, framesInFlight frames earlier, when there are any
+    struct FrameStats {
+        LveCounters::Values counters{};
+        std::optional<LveGpuProfiler::PipelineStatistics> pipelineStatistics;
+    };
+    // Swapchain recreations, e.g. while the window is being resized. The
+    // milliseconds are CPU time spent recreating, the frame is not stalled
+    // otherwise.
+    struct ResizeStats {
+        uint32_t recreations = 0;
+        float totalMilliseconds = 0.f;
+        float maxMilliseconds = 0.f;
+    };
+
+    // With preferDynamicRendering the swapchain is drawn with
+    // VK_KHR_dynamic_rendering when the device supports it. Pipelines then
+    // only depend on the attachment formats, see getSwapChainRenderTarget.
+    LveRenderer(LveWindow& window,
+                LveDevice& device,
+                bool preferDynamicRendering = false,
+                const FramePacing& framePacing = {});
     ~LveRenderer();
 
     LveRenderer(const LveRenderer&) = delete;
     LveRenderer& operator=(const LveRenderer&) = delete;
 
+    // Names of the frame targets in getFrameGraph
+    static constexpr const char* FRAME_COLOR = "frame color";
+    static constexpr const char* FRAME_DEPTH = "frame depth";
+    static constexpr VkClearColorValue CLEAR_COLOR{{0.01f, 0.01f, 0.01f, 1.f}};
+
+    // VK_NULL_HANDLE with dynamic rendering
     const VkRenderPass getSwapChainRenderPass() {
-        return lveSwapchain->getRenderPass();
+        return dynamicRendering ? VK_NULL_HANDLE
+                                : lveSwapchain->getRenderPass();
     };
+    bool usesDynamicRendering() const { return dynamicRendering; }
+    // Depth attachment of this frame, only kept with DepthUsage::STORED
+    VkImage getCurrentDepthImage() {
+        assert(isFrameStarted &&
+               "Cannot get depth image when frame is not in progress");
+        assert(lveSwapchain->getDepthUsage() == DepthUsage::STORED &&
+               "Cannot get depth image that is not stored");
+        return lveSwapchain->getDepthImage(currentFrameIndex);
+    }
+    VkImageView getCurrentDepthImageView() {
+        assert(isFrameStarted &&
+               "Cannot get depth image when frame is not in progress");
+        assert(lveSwapchain->getDepthUsage() == DepthUsage::STORED &&
+               "Cannot get depth image that is not stored");
+        return lveSwapchain->getDepthImageView(currentFrameIndex);
+    }
+    VkFormat getSwapChainDepthFormat() {
+        return lveSwapchain->getSwapChainDepthFormat();
+    }
+    RenderTargetInfo getSwapChainRenderTarget() {
+        return {getSwapChainRenderPass(),
+                {lveSwapchain->getSwapChainImageFormat()},
+                lveSwapchain->getSwapChainDepthFormat()};
+    }
+    VkExtent2D getSwapChainExtent() {
+        return lveSwapchain->getSwapChainExtent();
+    }
+    // Size the swapchain pass renders at: the swapchain extent scaled by
+    // the current resolution scale. Viewports and Hi-Z pyramids go by it.
+    VkExtent2D getRenderExtent() {
+        return resolutionScaler.scaleExtent(getSwapChainExtent());
+    }
     float getAspectRatio() { return lveSwapchain->extentAspectRatio(); }
     const bool isFrameInProgress() { return isFrameStarted; };
 
@@ -29,30 +105,166 @@ class LveRenderer {
         return commandBuffers[currentFrameIndex];
     };
 
+    // LveDevice::timeline() value of the most recently submitted frame;
+    // timeline().isComplete(value) tells whether it has finished
+    uint64_t getSubmittedFrameValue() const {
+        return lveSwapchain->getSubmittedFrameValue();
+    }
+
     const int getFrameIndex() {
         assert(isFrameStarted &&
                "Cannot get frame index when frame is not in progress");
         return currentFrameIndex;
     };
 
+    // Returns nullptr when no frame can be rendered, e.g. while the window
+    // is minimized or right after the swapchain was recreated
     VkCommandBuffer beginFrame();
     void endFrame();
 
-    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+    // Rebuilds the swapchain with the new pacing; not during a frame.
+    // Frame indices restart at 0 when framesInFlight changes.
+    void setFramePacing(const FramePacing& pacing);
+    const FramePacing& getFramePacing() const { return framePacing; }
+    // Returns the latency since the last call and starts over
+    LatencyStats takeLatencyStats();
+    // Returns the recreations since the last call and starts over
+    ResizeStats takeResizeStats();
+    // Rebuilds the swapchain when the usage changes; not during a frame.
+    // Starts out TRANSIENT, set STORED before reading the depth image or
+    // resuming the swapchain pass.
+    void setDepthUsage(DepthUsage usage);
+    DepthUsage getDepthUsage() const { return depthUsage; }
+    LveSwapChain::AttachmentMemory getAttachmentMemory() {
+        return lveSwapchain->getAttachmentMemory();
+    }
+
+    // Times the frame as LveGpuProfiler::FRAME_SCOPE, scopes of the frame
+    // graph passes and whatever scopes the caller adds between beginFrame
+    // and endFrame
+    LveGpuProfiler& getGpuProfiler() { return gpuProfiler; }
+    // Of the frame last ended
+    const FrameStats& getFrameStats() const { return frameStats; }
+
+    // Whether the device can time frames on the GPU and blit the scene
+    // target into the swapchain images
+    bool supportsResolutionScaling();
+    // Enabling or disabling rebuilds the swapchain, which then gets a scene
+    // target; changing only the bounds or target does not. Not during a
+    // frame. Throws on invalid bounds or when not supported.
+    void setResolutionScaling(const ResolutionScaling& scaling);
+    const ResolutionScaling& getResolutionScaling() const {
+        return resolutionScaler.getScaling();
+    }
+    // Also tracks the GPU frame time without scaling, when the device has
+    // timestamps
+    LveResolutionScaler::Stats getResolutionStats() const {
+        return resolutionScaler.getStats();
+    }
+    // Replaced swapchains still waiting for their last frames
+    size_t getRetiredSwapChainCount() const {
+        return retiredSwapChains.size();
+    }
+
+    // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only
+    // execute secondary command buffers, which set their own viewport.
+    void beginSwapChainRenderPass(
+        VkCommandBuffer commandBuffer,
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+    // Begins the swapchain pass again without clearing, after work that
+    // had to run outside of it since the last endSwapChainRenderPass.
+    void resumeSwapChainRenderPass(
+        VkCommandBuffer commandBuffer,
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+    // Makes this frame's submission wait for the semaphore at stages, e.g.
+    // for compute work on another queue the frame depends on
+    void addSubmitWait(const SubmitWait& wait) {
+        assert(isFrameStarted &&
+               "Cannot add submit wait when frame is not in progress");
+        submitWaits.push_back(wait);
+    }
+
+    // Alternative to the swapchain pass, only with dynamic rendering: each
+    // frame starts with a cleared graph that has the color target (scene
+    // target or swapchain image) imported as FRAME_COLOR and the depth
+    // attachment as FRAME_DEPTH. executeFrameGraph records the passes and
+    // leaves the targets as endSwapChainRenderPass would.
+    bool supportsFrameGraph() const { return frameGraph != nullptr; }
+    LveRenderGraph& getFrameGraph() {
+        assert(isFrameStarted &&
+               "Cannot get frame graph when frame is not in progress");
+        assert(frameGraph && "Frame graph needs dynamic rendering");
+        return *frameGraph;
+    }
+    void executeFrameGraph(VkCommandBuffer commandBuffer);
+    // Of the last executeFrameGraph
+    LveRenderGraph::Stats getFrameGraphStats() const {
+        return frameGraph ? frameGraph->getStats() : LveRenderGraph::Stats{};
+    }
+
    private:
     void createCommandBuffers();
     void freeCommandBuffers();
+    // Feeds the GPU time of the frame that last used the current frame
+    // index to the resolution scaler, and its pipeline statistics to the
+    // frame stats
+    void readFrameTimestamps();
+    void upscaleSceneTarget(VkCommandBuffer commandBuffer);
     void recreateSwapChain();
+    void releaseRetiredSwapChains();
+    void beginRenderPass(VkCommandBuffer commandBuffer,
+                         VkRenderPass renderPass,
+                         VkSubpassContents contents);
+    // Dynamic rendering equivalent of beginRenderPass, including the layout
+    // transitions the render passes would do
+    void beginRendering(VkCommandBuffer commandBuffer,
+                        VkAttachmentLoadOp loadOp,
+                        VkSubpassContents contents);
+    void setViewportAndScissor(VkCommandBuffer commandBuffer);
+    void importFrameTargets();
 
     LveWindow& lveWindow;
     LveDevice& lveDevice;
     std::unique_ptr<LveSwapChain> lveSwapchain;
     std::vector<VkCommandBuffer> commandBuffers;
 
+    // A replaced swapchain with its images, framebuffers and depth buffers,
+    // kept until the frames presented from it are done with them
+    struct RetiredSwapChain {
+        std::shared_ptr<LveSwapChain> swapChain;
+        // Timeline value of the first frame submitted to the replacement,
+        // 0 until there is one
+        uint64_t releaseValue = 0;
+    };
+    std::vector<RetiredSwapChain> retiredSwapChains;
+    ResizeStats resizeStats{};
+    // Set while the window is minimized, the swapchain is recreated once
+    // it has a size again
+    bool swapChainStale{false};
+
+    FramePacing framePacing;
+    DepthUsage depthUsage{DepthUsage::TRANSIENT};
+    LveResolutionScaler resolutionScaler{ResolutionScaling{}};
+    // nullptr without dynamic rendering
+    std::unique_ptr<LveRenderGraph> frameGraph;
+    // for the current frame's submission
+    std::vector<SubmitWait> submitWaits;
+    LveGpuProfiler gpuProfiler;
+    FrameStats frameStats{};
+    // LveDevice::counters() at the last endFrame
+    LveCounters::Values endFrameCounters{};
+    // beginFrame time of the frame last started with each frame index,
+    // unset while no frame is pending on it
+    std::array<std::chrono::high_resolution_clock::time_point,
+               LveSwapChain::MAX_FRAMES_IN_FLIGHT>
+        frameStartTimes{};
+    LatencyStats latencyStats{};
+
     uint32_t currentImageIndex;
     int currentFrameIndex{0};
     bool isFrameStarted{false};
+    bool dynamicRendering{false};
 };
 }  // namespace lve
\ No newline at end of file
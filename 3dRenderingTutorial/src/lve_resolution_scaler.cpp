@@ -0,0 +1,79 @@
+#include "lve_resolution_scaler.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace lve {
+
+LveResolutionScaler::LveResolutionScaler(const ResolutionScaling& scaling) {
+    setScaling(scaling);
+}
+
+void LveResolutionScaler::setScaling(const ResolutionScaling& newScaling) {
+    if (newScaling.minScale <= 0.f || newScaling.maxScale > 1.f ||
+        newScaling.minScale > newScaling.maxScale) {
+        throw std::runtime_error(
+            "resolution scale bounds must satisfy 0 < min <= max <= 1");
+    }
+    if (newScaling.targetFrameMilliseconds <= 0.f) {
+        throw std::runtime_error("target frame time must be positive");
+    }
+    scaling = newScaling;
+
+    float scale = scaling.enabled ? std::clamp(stats.scale,
+                                               scaling.minScale,
+                                               scaling.maxScale)
+                                  : 1.f;
+    if (scale != stats.scale) {
+        stats.scale = scale;
+        stats.scaleChanges++;
+        samples = 0;
+        settleFrames = SETTLE_FRAMES;
+    }
+}
+
+bool LveResolutionScaler::addFrameTime(float gpuMilliseconds) {
+    if (settleFrames > 0) {
+        settleFrames--;
+        return false;
+    }
+    if (samples == 0) {
+        stats.gpuMilliseconds = gpuMilliseconds;
+    } else {
+        stats.gpuMilliseconds +=
+            SMOOTHING * (gpuMilliseconds - stats.gpuMilliseconds);
+    }
+    samples++;
+    if (!scaling.enabled || samples < SETTLE_FRAMES) return false;
+
+    float target = scaling.targetFrameMilliseconds;
+    if (stats.gpuMilliseconds <= target &&
+        stats.gpuMilliseconds >= target * HEADROOM) {
+        return false;
+    }
+
+    float desired = stats.scale *
+                    std::sqrt(target * AIM / std::max(stats.gpuMilliseconds,
+                                                      0.001f));
+    desired = std::round(desired / SCALE_STEP) * SCALE_STEP;
+    desired = std::clamp(desired, scaling.minScale, scaling.maxScale);
+    if (desired == stats.scale) return false;
+
+    stats.scale = desired;
+    stats.scaleChanges++;
+    samples = 0;
+    settleFrames = SETTLE_FRAMES;
+    return true;
+}
+
+VkExtent2D LveResolutionScaler::scaleExtent(VkExtent2D extent) const {
+    auto scaleAxis = [&](uint32_t size) {
+        return std::max(
+            static_cast<uint32_t>(std::lround(size * stats.scale)), 1u);
+    };
+    return {scaleAxis(extent.width), scaleAxis(extent.height)};
+}
+
+}  // namespace lve
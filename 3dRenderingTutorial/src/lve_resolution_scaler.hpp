@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+
+namespace lve {
+
+struct ResolutionScaling {
+    bool enabled = false;
+    // Bounds of the scale of each axis. The scene target has the swapchain
+    // size, so maxScale is at most 1.
+    float minScale = 0.5f;
+    float maxScale = 1.f;
+    // GPU time per frame the scale is adjusted to stay under
+    float targetFrameMilliseconds = 1000.f / 60.f;
+};
+
+// Picks the render resolution from the GPU time of finished frames. The
+// scale shrinks when frames take longer than the target and grows back
+// when there is headroom; rendered pixels, and roughly the GPU time, go
+// with the square of the scale.
+class LveResolutionScaler {
+   public:
+    struct Stats {
+        float scale = 1.f;
+        // Smoothed GPU time of the frames since the last scale change
+        float gpuMilliseconds = 0.f;
+        uint32_t scaleChanges = 0;
+    };
+
+    // Throws when the bounds are invalid
+    explicit LveResolutionScaler(const ResolutionScaling& scaling);
+
+    void setScaling(const ResolutionScaling& scaling);
+    const ResolutionScaling& getScaling() const { return scaling; }
+
+    // Feeds the GPU time of one finished frame, returns whether the scale
+    // changed. Without scaling enabled it only keeps the statistics.
+    bool addFrameTime(float gpuMilliseconds);
+    float getScale() const { return stats.scale; }
+    // extent scaled by the current scale, at least 1x1
+    VkExtent2D scaleExtent(VkExtent2D extent) const;
+    Stats getStats() const { return stats; }
+
+   private:
+    // Frames ignored after a change: frames already in flight were
+    // recorded at the old scale
+    static constexpr uint32_t SETTLE_FRAMES = 8;
+    static constexpr float SMOOTHING = 0.1f;
+    // Scales are multiples of the step, so small jitter in the frame times
+    // does not change the resolution every frame
+    static constexpr float SCALE_STEP = 1.f / 32.f;
+    // Scaled up again once frames take less than this share of the target
+    static constexpr float HEADROOM = 0.75f;
+    // Adjustments aim at this share of the target
+    static constexpr float AIM = 0.9f;
+
+    ResolutionScaling scaling;
+    Stats stats{};
+    uint32_t samples = 0;
+    uint32_t settleFrames = 0;
+};
+
+}  // namespace lve
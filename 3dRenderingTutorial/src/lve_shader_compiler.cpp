@@ -0,0 +1,272 @@
+#include "lve_shader_compiler.hpp"
+
+#include "lve_utils.hpp"
+
+// std
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef LVE_SHADERC
+#include <shaderc/shaderc.hpp>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define LVE_SHADER_HOT_RELOAD 1
+#endif
+
+namespace lve {
+
+namespace {
+
+// Bump when the compile options change, to ignore old cache entries
+constexpr const char* CACHE_VERSION = "shaderc-performance-1";
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) ==
+               0;
+}
+
+bool readTextFile(const std::string& filePath, std::string& contents) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) return false;
+    contents.assign(std::istreambuf_iterator<char>(file),
+                    std::istreambuf_iterator<char>());
+    return true;
+}
+
+#ifdef LVE_SHADERC
+shaderc_shader_kind shaderKind(const std::string& sourcePath) {
+    if (endsWith(sourcePath, ".vert")) return shaderc_vertex_shader;
+    if (endsWith(sourcePath, ".frag")) return shaderc_fragment_shader;
+    if (endsWith(sourcePath, ".comp")) return shaderc_compute_shader;
+    return shaderc_glsl_infer_from_source;
+}
+#endif
+
+}  // namespace
+
+LveShaderCompiler::~LveShaderCompiler() {
+    stopWatching = true;
+    if (watcher.joinable()) {
+        watcher.join();
+    }
+}
+
+bool LveShaderCompiler::isRuntimeCompilationAvailable() {
+#ifdef LVE_SHADERC
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool LveShaderCompiler::isCachePath(const std::string& path) {
+    const std::string prefix = std::string{CACHE_DIRECTORY} + "/";
+    return path.compare(0, prefix.size(), prefix) == 0;
+}
+
+std::string LveShaderCompiler::getSpirvPath(const std::string& spirvPath,
+                                            const Defines& defines) {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        requested.emplace(spirvPath, defines);
+    }
+
+#ifdef LVE_SHADERC
+    if (endsWith(spirvPath, ".spv")) {
+        std::string sourcePath = spirvPath.substr(0, spirvPath.size() - 4);
+        struct stat sourceStat {};
+        if (stat(sourcePath.c_str(), &sourceStat) == 0) {
+            return compile(sourcePath, defines);
+        }
+    }
+#endif
+    return spirvPath;
+}
+
+std::vector<std::string> LveShaderCompiler::takeChangedShaders() {
+    std::lock_guard<std::mutex> lock{mutex};
+    std::vector<std::string> changed{changedShaders.begin(),
+                                     changedShaders.end()};
+    changedShaders.clear();
+    return changed;
+}
+
+LveShaderCompiler::Stats LveShaderCompiler::getStats() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    return stats;
+}
+
+std::string LveShaderCompiler::cachePath(const std::string& source,
+                                         const Defines& defines) const {
+    std::string key = CACHE_VERSION;
+    key += '\n';
+    for (auto& define : defines) {
+        key += define.first + '=' + define.second + '\n';
+    }
+    uint64_t hash = hashBytes(key.data(), key.size());
+    hash = hashBytes(source.data(), source.size(), hash);
+
+    char name[32];
+    std::snprintf(name,
+                  sizeof(name),
+                  "%016llx.spv",
+                  static_cast<unsigned long long>(hash));
+    return std::string{CACHE_DIRECTORY} + "/" + name;
+}
+
+std::string LveShaderCompiler::compile(const std::string& sourcePath,
+                                       const Defines& defines) {
+    std::string source;
+    if (!readTextFile(sourcePath, source)) {
+        throw std::runtime_error("failed to open file: " + sourcePath);
+    }
+    std::string spirvPath = cachePath(source, defines);
+
+    std::ifstream cached(spirvPath, std::ios::binary);
+    if (cached.is_open()) {
+        std::lock_guard<std::mutex> lock{mutex};
+        stats.cacheHits++;
+        return spirvPath;
+    }
+
+#ifdef LVE_SHADERC
+    shaderc::Compiler compiler;
+    shaderc::CompileOptions options;
+    options.SetOptimizationLevel(shaderc_optimization_level_performance);
+    for (auto& define : defines) {
+        options.AddMacroDefinition(define.first, define.second);
+    }
+
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(
+        source, shaderKind(sourcePath), sourcePath.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stats.errors++;
+        }
+        throw std::runtime_error("failed to compile " + sourcePath + ":\n" +
+                                 result.GetErrorMessage());
+    }
+    std::vector<uint32_t> spirv{result.cbegin(), result.cend()};
+
+    mkdir(CACHE_DIRECTORY, 0755);
+    // written under a temporary name first, so a crash never leaves a
+    // truncated entry behind; named per thread, as two sources with the
+    // same text can be compiled at once
+    const size_t threadId =
+        std::hash<std::thread::id>{}(std::this_thread::get_id());
+    std::string tempPath =
+        spirvPath + "." + std::to_string(threadId) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(spirv.data()),
+                   spirv.size() * sizeof(uint32_t));
+        if (!file) {
+            throw std::runtime_error("failed to write " + tempPath);
+        }
+    }
+    if (std::rename(tempPath.c_str(), spirvPath.c_str()) != 0) {
+        throw std::runtime_error("failed to write " + spirvPath);
+    }
+
+    std::lock_guard<std::mutex> lock{mutex};
+    stats.compiled++;
+    return spirvPath;
+#else
+    throw std::runtime_error("cannot compile " + sourcePath +
+                             ": built without LVE_SHADERC");
+#endif
+}
+
+void LveShaderCompiler::startWatching() {
+#ifdef LVE_SHADER_HOT_RELOAD
+    if (!watcher.joinable()) {
+        watcher = std::thread{&LveShaderCompiler::watch, this};
+    }
+#endif
+}
+
+void LveShaderCompiler::watch() {
+#ifdef LVE_SHADER_HOT_RELOAD
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 ||
+        inotify_add_watch(fd, SHADER_DIRECTORY, IN_CLOSE_WRITE | IN_MOVED_TO) <
+            0) {
+        std::cerr << "shader hot reload disabled: cannot watch "
+                  << SHADER_DIRECTORY << std::endl;
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (!stopWatching) {
+        // wake up regularly to notice stopWatching
+        pollfd pollFd{fd, POLLIN, 0};
+        if (poll(&pollFd, 1, 100) <= 0) continue;
+
+        // an editor saving one file can produce several events
+        std::set<std::string> fileNames;
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length;) {
+                auto event = reinterpret_cast<const inotify_event*>(p);
+                if (event->len > 0) fileNames.insert(event->name);
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        for (auto& fileName : fileNames) {
+            onFileChanged(fileName);
+        }
+    }
+    close(fd);
+#endif
+}
+
+void LveShaderCompiler::onFileChanged(const std::string& fileName) {
+    // With runtime compilation the sources are watched, otherwise the .spv
+    // files glslc writes.
+    std::string spirvPath = std::string{SHADER_DIRECTORY} + "/" + fileName;
+    if (isRuntimeCompilationAvailable()) {
+        if (endsWith(fileName, ".spv")) return;
+        spirvPath += ".spv";
+    } else if (!endsWith(fileName, ".spv")) {
+        return;
+    }
+
+    std::vector<Defines> variants;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto& request : requested) {
+            if (request.first == spirvPath) variants.push_back(request.second);
+        }
+    }
+    if (variants.empty()) return;
+
+    if (isRuntimeCompilationAvailable()) {
+        // keep the old shader when the edit does not compile
+        try {
+            for (auto& defines : variants) {
+                compile(std::string{SHADER_DIRECTORY} + "/" + fileName,
+                        defines);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return;
+        }
+    }
+
+    std::cout << "shader changed: " << spirvPath << std::endl;
+    std::lock_guard<std::mutex> lock{mutex};
+    changedShaders.insert(spirvPath);
+}
+
+}  // namespace lve
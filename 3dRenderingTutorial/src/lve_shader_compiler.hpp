@@ -0,0 +1,86 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+// Runtime GLSL -> SPIR-V compilation and shader hot reload.
+//
+// Built with LVE_SHADERC (the Makefile defines it when pkg-config finds
+// libshaderc), a request for "shaders/x.vert.spv" compiles
+// "shaders/x.vert" and caches the result in CACHE_DIRECTORY, keyed by a
+// hash of the source and defines, so unchanged shaders are never compiled
+// twice. Without it the glslc output is used as is.
+//
+// startWatching() watches SHADER_DIRECTORY with inotify on Linux. Edited
+// sources are recompiled on the watcher thread (or, without shaderc,
+// .spv files rewritten by compile.sh/make are picked up), and their .spv
+// paths are reported by takeChangedShaders() for the render loop to
+// rebuild pipelines at a frame boundary.
+class LveShaderCompiler {
+   public:
+    using Defines = std::vector<std::pair<std::string, std::string>>;
+
+    static constexpr const char* SHADER_DIRECTORY = "shaders";
+    static constexpr const char* CACHE_DIRECTORY = "shader_cache";
+
+    struct Stats {
+        uint32_t compiled = 0;
+        uint32_t cacheHits = 0;
+        uint32_t errors = 0;
+    };
+
+    LveShaderCompiler() = default;
+    ~LveShaderCompiler();
+
+    LveShaderCompiler(const LveShaderCompiler&) = delete;
+    LveShaderCompiler& operator=(const LveShaderCompiler&) = delete;
+
+    static bool isRuntimeCompilationAvailable();
+    // Whether path is an entry of CACHE_DIRECTORY. Entries are only ever
+    // replaced by a rename, never rewritten in place, so they can be
+    // memory-mapped.
+    static bool isCachePath(const std::string& path);
+
+    // Path of the SPIR-V to load for spirvPath: the cached compilation of
+    // its GLSL source when runtime compilation is available and the source
+    // exists, spirvPath otherwise. Throws if the source does not compile.
+    std::string getSpirvPath(const std::string& spirvPath,
+                             const Defines& defines = {});
+
+    // No-op where inotify is unavailable
+    void startWatching();
+    // .spv paths (as requested from getSpirvPath) changed since the last
+    // call
+    std::vector<std::string> takeChangedShaders();
+
+    Stats getStats() const;
+
+   private:
+    std::string cachePath(const std::string& source,
+                          const Defines& defines) const;
+    // Compiles into the cache unless already there; returns the cache path
+    std::string compile(const std::string& sourcePath,
+                        const Defines& defines);
+    void watch();
+    void onFileChanged(const std::string& fileName);
+
+    mutable std::mutex mutex;
+    // every (spirvPath, defines) handed out, recompiled when changed
+    std::set<std::pair<std::string, Defines>> requested;
+    std::set<std::string> changedShaders;
+    Stats stats{};
+
+    std::thread watcher;
+    std::atomic<bool> stopWatching{false};
+};
+
+}  // namespace lve
@@ -0,0 +1,242 @@
+#include "lve_shader_library.hpp"
+
+#include "lve_shader_compiler.hpp"
+#include "lve_timeline.hpp"
+#include "lve_utils.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LVE_SHADER_LIBRARY_MMAP 1
+#endif
+
+namespace lve {
+
+namespace {
+
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+bool sameCode(const ShaderCode& a, const ShaderCode& b) {
+    return a.size == b.size && std::memcmp(a.words, b.words, a.size) == 0;
+}
+
+}  // namespace
+
+LveShaderModule::LveShaderModule(LveDevice& device, const ShaderCode& code)
+    : lveDevice{device} {
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size;
+    createInfo.pCode = code.words;
+
+    if (vkCreateShaderModule(
+            lveDevice.device(), &createInfo, nullptr, &shaderModule) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shader module");
+    }
+}
+
+LveShaderModule::~LveShaderModule() {
+    vkDestroyShaderModule(lveDevice.device(), shaderModule, nullptr);
+}
+
+LveShaderLibrary::~LveShaderLibrary() {
+    for (auto& kv : files) {
+        unmap(*kv.second);
+    }
+    for (auto& retired : retiredFiles) {
+        unmap(*retired.file);
+    }
+}
+
+void LveShaderLibrary::setCompiler(LveShaderCompiler* shaderCompiler) {
+    std::lock_guard<std::mutex> lock{mutex};
+    compiler = shaderCompiler;
+}
+
+void LveShaderLibrary::invalidate(const std::string& filePath) {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto inProgress = loading.find(filePath);
+    if (inProgress != loading.end()) {
+        inProgress->second = true;
+    }
+    releaseRetiredFiles();
+    auto found = files.find(filePath);
+    if (found != files.end()) {
+        retire(std::move(found->second));
+        files.erase(found);
+    }
+}
+
+void LveShaderLibrary::retire(std::unique_ptr<LoadedFile> file) {
+    retiredFiles.push_back(
+        {std::move(file), lveDevice.timeline().getSubmittedValue()});
+}
+
+void LveShaderLibrary::releaseRetiredFiles() {
+    auto& timeline = lveDevice.timeline();
+    auto released = std::stable_partition(
+        retiredFiles.begin(),
+        retiredFiles.end(),
+        [&timeline](const RetiredFile& retired) {
+            return !timeline.isComplete(retired.timelineValue);
+        });
+    for (auto it = released; it != retiredFiles.end(); ++it) {
+        // moduleCode must not point into the freed words; a module created
+        // from them is simply no longer shared
+        const uint64_t hash = it->file->code.hash;
+        auto code = moduleCode.find(hash);
+        if (code != moduleCode.end() &&
+            code->second.words == it->file->code.words) {
+            moduleCode.erase(code);
+            modules.erase(hash);
+        }
+        unmap(*it->file);
+    }
+    retiredFiles.erase(released, retiredFiles.end());
+}
+
+void LveShaderLibrary::unmap(LoadedFile& file) {
+#ifdef LVE_SHADER_LIBRARY_MMAP
+    if (file.mapping != nullptr) {
+        munmap(file.mapping, file.code.size);
+        file.mapping = nullptr;
+    }
+#endif
+}
+
+ShaderCode LveShaderLibrary::getCode(const std::string& filePath) {
+    std::unique_lock<std::mutex> lock{mutex};
+    return load(lock, filePath);
+}
+
+std::shared_ptr<LveShaderModule> LveShaderLibrary::getModule(
+    const std::string& filePath) {
+    std::unique_lock<std::mutex> lock{mutex};
+    const ShaderCode& code = load(lock, filePath);
+
+    auto& cached = modules[code.hash];
+    if (auto module = cached.lock()) {
+        if (sameCode(moduleCode[code.hash], code)) {
+            stats.modulesShared++;
+            return module;
+        }
+        // different code with the same hash: not worth sharing
+        stats.modulesCreated++;
+        return std::make_shared<LveShaderModule>(lveDevice, code);
+    }
+
+    auto module = std::make_shared<LveShaderModule>(lveDevice, code);
+    cached = module;
+    moduleCode[code.hash] = code;
+    stats.modulesCreated++;
+    return module;
+}
+
+LveShaderLibrary::Stats LveShaderLibrary::getStats() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    return stats;
+}
+
+const ShaderCode& LveShaderLibrary::load(std::unique_lock<std::mutex>& lock,
+                                        const std::string& filePath) {
+    for (;;) {
+        auto found = files.find(filePath);
+        if (found != files.end()) {
+            return found->second->code;
+        }
+        if (loading.count(filePath) == 0) break;
+        loadFinished.wait(lock);
+    }
+
+    loading[filePath] = false;
+    LveShaderCompiler* loadingCompiler = compiler;
+    std::unique_ptr<LoadedFile> file;
+    lock.unlock();
+    try {
+        // may compile GLSL, see LveShaderCompiler::getSpirvPath
+        file = readFile(loadingCompiler != nullptr
+                            ? loadingCompiler->getSpirvPath(filePath)
+                            : filePath);
+    } catch (...) {
+        lock.lock();
+        loading.erase(filePath);
+        loadFinished.notify_all();
+        throw;
+    }
+    lock.lock();
+
+    stats.filesLoaded++;
+    const ShaderCode& code = file->code;
+    // invalidated while compiling: this caller still gets the code it
+    // asked for, the next request loads the file again
+    if (loading[filePath]) {
+        retire(std::move(file));
+    } else {
+        files[filePath] = std::move(file);
+    }
+    loading.erase(filePath);
+    loadFinished.notify_all();
+    return code;
+}
+
+std::unique_ptr<LveShaderLibrary::LoadedFile> LveShaderLibrary::readFile(
+    const std::string& spirvPath) {
+    auto file = std::make_unique<LoadedFile>();
+    size_t fileSize = 0;
+
+#ifdef LVE_SHADER_LIBRARY_MMAP
+    // a replaced cache entry is a new file, the mapping keeps the old one
+    if (LveShaderCompiler::isCachePath(spirvPath)) {
+        int fd = open(spirvPath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open file: " + spirvPath);
+        }
+        struct stat fileStat {};
+        if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+            fileSize = static_cast<size_t>(fileStat.st_size);
+            void* mapping =
+                mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                file->mapping = mapping;
+                file->code.words = static_cast<const uint32_t*>(mapping);
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    if (file->mapping == nullptr) {
+        std::ifstream stream(spirvPath, std::ios::ate | std::ios::binary);
+        if (!stream.is_open()) {
+            throw std::runtime_error("failed to open file: " + spirvPath);
+        }
+        fileSize = static_cast<size_t>(stream.tellg());
+        // uint32_t storage keeps the words aligned for pCode
+        file->contents.resize((fileSize + 3) / 4);
+        stream.seekg(0);
+        stream.read(reinterpret_cast<char*>(file->contents.data()), fileSize);
+        file->code.words = file->contents.data();
+    }
+    file->code.size = fileSize;
+
+    if (fileSize < 4 || fileSize % 4 != 0 ||
+        file->code.words[0] != SPIRV_MAGIC) {
+#ifdef LVE_SHADER_LIBRARY_MMAP
+        if (file->mapping != nullptr) munmap(file->mapping, fileSize);
+#endif
+        throw std::runtime_error("not a SPIR-V file: " + spirvPath);
+    }
+    file->code.hash = hashBytes(file->code.words, fileSize);
+    return file;
+}
+
+}  // namespace lve
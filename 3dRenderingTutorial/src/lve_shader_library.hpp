@@ -0,0 +1,124 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+class LveShaderCompiler;
+
+// SPIR-V loaded by LveShaderLibrary. The words stay valid until the file
+// is invalidated and the device timeline passes the value submitted then.
+struct ShaderCode {
+    const uint32_t* words = nullptr;
+    size_t size = 0;  // in bytes
+    uint64_t hash = 0;
+};
+
+// A VkShaderModule that lives only as long as some pipeline creation
+// needs it.
+class LveShaderModule {
+   public:
+    LveShaderModule(LveDevice& device, const ShaderCode& code);
+    ~LveShaderModule();
+
+    LveShaderModule(const LveShaderModule&) = delete;
+    LveShaderModule& operator=(const LveShaderModule&) = delete;
+
+    VkShaderModule getShaderModule() const { return shaderModule; }
+
+   private:
+    LveDevice& lveDevice;
+    VkShaderModule shaderModule;
+};
+
+// Loads every .spv file once and shares shader modules by content hash.
+// Modules are only held by the pipelines being created from them and are
+// destroyed when the last creation finishes. Safe to use from the pipeline
+// compiler threads.
+//
+// Files are read into memory of their own: glslc and make rewrite .spv
+// files in place, which would change or truncate a mapping under its
+// readers. Only LveShaderCompiler cache entries, which are replaced by a
+// rename, are memory-mapped.
+class LveShaderLibrary {
+   public:
+    struct Stats {
+        uint32_t filesLoaded = 0;
+        uint32_t modulesCreated = 0;
+        uint32_t modulesShared = 0;
+    };
+
+    explicit LveShaderLibrary(LveDevice& device) : lveDevice{device} {}
+    ~LveShaderLibrary();
+
+    LveShaderLibrary(const LveShaderLibrary&) = delete;
+    LveShaderLibrary& operator=(const LveShaderLibrary&) = delete;
+
+    ShaderCode getCode(const std::string& filePath);
+    std::shared_ptr<LveShaderModule> getModule(const std::string& filePath);
+
+    // Lets compiler provide the SPIR-V for requested .spv paths, e.g.
+    // compiled at runtime from the GLSL next to them. The compiler must
+    // outlive the library or be detached by passing nullptr.
+    void setCompiler(LveShaderCompiler* shaderCompiler);
+    // Makes the next request for filePath load it again. Code handed out
+    // before stays valid until the frames submitted so far completed;
+    // earlier invalidated files whose frames completed are freed.
+    void invalidate(const std::string& filePath);
+
+    Stats getStats() const;
+
+   private:
+    struct LoadedFile {
+        ShaderCode code{};
+        void* mapping = nullptr;  // non-null when memory-mapped
+        std::vector<uint32_t> contents{};
+    };
+
+    struct RetiredFile {
+        std::unique_ptr<LoadedFile> file;
+        // device timeline value submitted when the file was retired
+        uint64_t timelineValue;
+    };
+
+    // Returns filePath's code, loading it if needed. lock must hold mutex;
+    // it is released while the file is compiled and read, so other
+    // threads are not held up by a GLSL compile, and waits for a load of
+    // the same path running on another thread.
+    const ShaderCode& load(std::unique_lock<std::mutex>& lock,
+                           const std::string& filePath);
+    // Without holding mutex
+    std::unique_ptr<LoadedFile> readFile(const std::string& spirvPath);
+    // With mutex held
+    void retire(std::unique_ptr<LoadedFile> file);
+    void releaseRetiredFiles();
+    static void unmap(LoadedFile& file);
+
+    LveDevice& lveDevice;
+
+    mutable std::mutex mutex;
+    LveShaderCompiler* compiler = nullptr;
+    std::unordered_map<std::string, std::unique_ptr<LoadedFile>> files;
+    // paths being loaded, each mapped to whether it was invalidated
+    // meanwhile, and signaled whenever a load finishes
+    std::unordered_map<std::string, bool> loading;
+    std::condition_variable loadFinished;
+    // invalidated files, kept while their code may still be in use
+    std::vector<RetiredFile> retiredFiles;
+    std::unordered_map<uint64_t, std::weak_ptr<LveShaderModule>> modules;
+    // code the modules were created from, to rule out hash collisions
+    std::unordered_map<uint64_t, ShaderCode> moduleCode;
+    Stats stats{};
+};
+
+}  // namespace lve
@@ -1,6 +1,10 @@
 #include "lve_swap_chain.hpp"
 
+#include "lve_cpu_profiler.hpp"
+#include "lve_timeline.hpp"
+
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -11,29 +15,63 @@
 
 namespace lve {
 
-LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent)
-    : device{deviceRef},
+const char* presentModePolicyName(PresentModePolicy policy) {
+    switch (policy) {
+        case PresentModePolicy::LOWEST_LATENCY:
+            return "lowest latency";
+        case PresentModePolicy::VSYNC:
+            return "vsync";
+        case PresentModePolicy::MAX_THROUGHPUT:
+            return "max throughput";
+        case PresentModePolicy::POWER_SAVING:
+            return "power saving";
+    }
+    return "unknown";
+}
+
+LveSwapChain::LveSwapChain(LveDevice& deviceRef,
+                           VkExtent2D extent,
+                           const FramePacing& pacing,
+                           DepthUsage depthUsage,
+                           bool sceneTarget)
+    : framePacing{pacing},
+      depthUsage{depthUsage},
+      sceneTarget{sceneTarget},
+      device{deviceRef},
       windowExtent{extent} {
     init();
 }
 
 LveSwapChain::LveSwapChain(LveDevice& deviceRef,
                            VkExtent2D extent,
+                           const FramePacing& pacing,
+                           DepthUsage depthUsage,
+                           bool sceneTarget,
                            std::shared_ptr<LveSwapChain> previous)
-    : device{deviceRef},
+    : framePacing{pacing},
+      depthUsage{depthUsage},
+      sceneTarget{sceneTarget},
+      device{deviceRef},
       windowExtent{extent},
       oldSwapChain{previous} {
     init();
 
-    // Clean up old swap chain since it's no longer needed
+    // Only needed to create this one and take over its frame slots; the
+    // caller keeps it alive until the frames presented from it finished.
     oldSwapChain = nullptr;
 }
 
 void LveSwapChain::init() {
+    if (framePacing.framesInFlight < 1 ||
+        framePacing.framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+        throw std::runtime_error("frames in flight must be between 1 and " +
+                                 std::to_string(MAX_FRAMES_IN_FLIGHT));
+    }
     createSwapChain();
     createImageViews();
     createRenderPass();
     createDepthResources();
+    if (sceneTarget) createSceneResources();
     createFramebuffers();
     createSyncObjects();
 }
@@ -55,17 +93,22 @@ LveSwapChain::~LveSwapChain() {
         vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
     }
 
+    for (int i = 0; i < sceneImages.size(); i++) {
+        vkDestroyImageView(device.device(), sceneImageViews[i], nullptr);
+        vkDestroyImage(device.device(), sceneImages[i], nullptr);
+        vkFreeMemory(device.device(), sceneImageMemorys[i], nullptr);
+    }
+
     for (auto framebuffer : swapChainFramebuffers) {
         vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
     }
 
     vkDestroyRenderPass(device.device(), renderPass, nullptr);
+    vkDestroyRenderPass(device.device(), resumeRenderPass, nullptr);
 
     // cleanup synchronization objects
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(
-            device.device(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device.device(), inFlightFences[i], nullptr);
+    for (auto semaphore : imageAvailableSemaphores) {
+        vkDestroySemaphore(device.device(), semaphore, nullptr);
     }
 
     for (size_t i = 0; i < imageCount(); i++) {
@@ -75,11 +118,10 @@ LveSwapChain::~LveSwapChain() {
 }
 
 VkResult LveSwapChain::acquireNextImage(uint32_t* imageIndex) {
-    vkWaitForFences(device.device(),
-                    1,
-                    &inFlightFences[currentFrame],
-                    VK_TRUE,
-                    std::numeric_limits<uint64_t>::max());
+    // the frame slot, including its acquire semaphore, is free again once
+    // the frame that last used it has signaled its timeline value
+    device.timeline().wait(frameTimelineValues[currentFrame]);
+    frameCompletedTime = std::chrono::high_resolution_clock::now();
 
     VkResult result = vkAcquireNextImageKHR(
         device.device(),
@@ -93,47 +135,61 @@ VkResult LveSwapChain::acquireNextImage(uint32_t* imageIndex) {
     return result;
 }
 
-VkResult LveSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers,
-                                            uint32_t* imageIndex) {
-    if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(device.device(),
-                        1,
-                        &imagesInFlight[*imageIndex],
-                        VK_TRUE,
-                        UINT64_MAX);
-    }
-    imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
-
+VkResult LveSwapChain::submitCommandBuffers(
+    const VkCommandBuffer* buffers,
+    uint32_t* imageIndex,
+    const std::vector<SubmitWait>& waits) {
+    LVE_CPU_ZONE("submit and present");
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {
+    std::vector<VkSemaphore> waitSemaphores = {
+        imageAvailableSemaphores[currentFrame]};
+    std::vector<VkPipelineStageFlags> waitStages = {
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    std::vector<uint64_t> waitValues = {0};  // binary ignores its value
+    for (const auto& wait : waits) {
+        waitSemaphores.push_back(wait.semaphore);
+        waitStages.push_back(wait.stages);
+        waitValues.push_back(wait.value);
+    }
+    submitInfo.waitSemaphoreCount =
+        static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
 
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = buffers;
 
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[*imageIndex]};
-    submitInfo.signalSemaphoreCount = 1;
+    // The binary semaphore is for presentation, the timeline value marks
+    // the frame as complete for everything else
+    uint64_t frameValue = device.timeline().advance();
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[*imageIndex],
+                                      device.timeline().getSemaphore()};
+    uint64_t signalValues[] = {0, frameValue};  // binary ignores its value
+    submitInfo.signalSemaphoreCount = 2;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-    if (vkQueueSubmit(device.graphicsQueue(),
-                      1,
-                      &submitInfo,
-                      inFlightFences[currentFrame]) != VK_SUCCESS) {
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount =
+        static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineInfo;
+
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) !=
+        VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
+    frameTimelineValues[currentFrame] = frameValue;
 
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphores[*imageIndex];
 
     VkSwapchainKHR swapChains[] = {swapChain};
     presentInfo.swapchainCount = 1;
@@ -143,7 +199,7 @@ VkResult LveSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers,
 
     auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % frameTimelineValues.size();
 
     return result;
 }
@@ -153,11 +209,15 @@ void LveSwapChain::createSwapChain() {
 
     VkSurfaceFormatKHR surfaceFormat =
         chooseSwapSurfaceFormat(swapChainSupport.formats);
-    VkPresentModeKHR presentMode =
-        chooseSwapPresentMode(swapChainSupport.presentModes);
+    presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    // One image more than the minimum, so that acquiring does not wait for
+    // the presentation engine to release one, unless saving power
+    uint32_t imageCount = swapChainSupport.capabilities.minImageCount;
+    if (framePacing.presentModePolicy != PresentModePolicy::POWER_SAVING) {
+        imageCount++;
+    }
     if (swapChainSupport.capabilities.maxImageCount > 0 &&
         imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -173,6 +233,10 @@ void LveSwapChain::createSwapChain() {
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (sceneTarget) {
+        // the scene target is blitted into the image
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
 
     QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily,
@@ -240,14 +304,28 @@ void LveSwapChain::createImageViews() {
 }
 
 void LveSwapChain::createRenderPass() {
+    renderPass = createRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR);
+    resumeRenderPass = createRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD);
+}
+
+// A CLEAR pass starts the frame. A LOAD pass is compatible with it, so it
+// uses the same framebuffers and pipelines, and continues drawing into the
+// attachments after work outside a render pass (e.g. occlusion culling).
+VkRenderPass LveSwapChain::createRenderPass(VkAttachmentLoadOp loadOp) {
+    const bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = findDepthFormat();
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.loadOp = loadOp;
+    depthAttachment.storeOp = depthUsage == DepthUsage::STORED
+                                  ? VK_ATTACHMENT_STORE_OP_STORE
+                                  : VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.initialLayout =
+        load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+             : VK_IMAGE_LAYOUT_UNDEFINED;
     depthAttachment.finalLayout =
         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
@@ -259,12 +337,17 @@ void LveSwapChain::createRenderPass() {
     VkAttachmentDescription colorAttachment = {};
     colorAttachment.format = getSwapChainImageFormat();
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.loadOp = loadOp;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // a scene target stays an attachment until the renderer upscales it
+    VkImageLayout colorLayout = sceneTarget
+                                    ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.initialLayout =
+        load ? colorLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = colorLayout;
 
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment = 0;
@@ -286,6 +369,14 @@ void LveSwapChain::createRenderPass() {
                               VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    if (load) {
+        // the loaded contents were written by the previous pass
+        dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    }
 
     std::array<VkAttachmentDescription, 2> attachments = {colorAttachment,
                                                           depthAttachment};
@@ -298,35 +389,42 @@ void LveSwapChain::createRenderPass() {
     renderPassInfo.dependencyCount = 1;
     renderPassInfo.pDependencies = &dependency;
 
-    if (vkCreateRenderPass(
-            device.device(), &renderPassInfo, nullptr, &renderPass) !=
+    VkRenderPass pass;
+    if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &pass) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
+    return pass;
 }
 
 void LveSwapChain::createFramebuffers() {
-    swapChainFramebuffers.resize(imageCount());
-    for (size_t i = 0; i < imageCount(); i++) {
-        std::array<VkImageView, 2> attachments = {swapChainImageViews[i],
-                                                  depthImageViews[i]};
-
-        VkExtent2D swapChainExtent = getSwapChainExtent();
-        VkFramebufferCreateInfo framebufferInfo = {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount =
-            static_cast<uint32_t>(attachments.size());
-        framebufferInfo.pAttachments = attachments.data();
-        framebufferInfo.width = swapChainExtent.width;
-        framebufferInfo.height = swapChainExtent.height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(device.device(),
-                                &framebufferInfo,
-                                nullptr,
-                                &swapChainFramebuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create framebuffer!");
+    size_t colorImages = sceneTarget ? 1 : imageCount();
+    swapChainFramebuffers.resize(colorImages * getFramesInFlight());
+    for (size_t i = 0; i < colorImages; i++) {
+        for (int frame = 0; frame < getFramesInFlight(); frame++) {
+            std::array<VkImageView, 2> attachments = {
+                sceneTarget ? sceneImageViews[frame] : swapChainImageViews[i],
+                depthImageViews[frame]};
+
+            VkExtent2D swapChainExtent = getSwapChainExtent();
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount =
+                static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = swapChainExtent.width;
+            framebufferInfo.height = swapChainExtent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(
+                    device.device(),
+                    &framebufferInfo,
+                    nullptr,
+                    &swapChainFramebuffers[i * getFramesInFlight() + frame]) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer!");
+            }
         }
     }
 }
@@ -336,9 +434,26 @@ void LveSwapChain::createDepthResources() {
     swapChainDepthFormat = depthFormat;
     VkExtent2D swapChainExtent = getSwapChainExtent();
 
-    depthImages.resize(imageCount());
-    depthImageMemorys.resize(imageCount());
-    depthImageViews.resize(imageCount());
+    // A depth image is only written by the frame rendering into it, and a
+    // frame slot is reused only after its previous frame finished, so one
+    // per frame in flight is enough however many images the chain has.
+    depthImages.resize(getFramesInFlight());
+    depthImageMemorys.resize(getFramesInFlight());
+    depthImageViews.resize(getFramesInFlight());
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    VkMemoryPropertyFlags lazyProperties = 0;
+    if (depthUsage == DepthUsage::STORED) {
+        usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    } else {
+        usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        // tile-based GPUs may then never back the image with memory;
+        // desktop GPUs usually have no lazily allocated memory type, and
+        // plain device local memory is used
+        lazyProperties = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    }
+    depthLazilyAllocated = false;
+    depthImageBytes = 0;
 
     for (int i = 0; i < depthImages.size(); i++) {
         VkImageCreateInfo imageInfo{};
@@ -352,15 +467,22 @@ void LveSwapChain::createDepthResources() {
         imageInfo.format = depthFormat;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        imageInfo.usage = usage;
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
 
-        device.createImageWithInfo(imageInfo,
-                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                   depthImages[i],
-                                   depthImageMemorys[i]);
+        // all images are alike, so either all are lazily allocated or none
+        depthLazilyAllocated =
+            device.createImageWithInfo(imageInfo,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       depthImages[i],
+                                       depthImageMemorys[i],
+                                       lazyProperties);
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(
+            device.device(), depthImages[i], &memRequirements);
+        depthImageBytes += memRequirements.size;
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -381,19 +503,103 @@ void LveSwapChain::createDepthResources() {
     }
 }
 
+void LveSwapChain::createSceneResources() {
+    sceneImages.resize(getFramesInFlight());
+    sceneImageMemorys.resize(getFramesInFlight());
+    sceneImageViews.resize(getFramesInFlight());
+    sceneImageBytes = 0;
+
+    // Full size: the renderer only scales the render area, so changing the
+    // resolution never reallocates
+    for (int i = 0; i < sceneImages.size(); i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = swapChainExtent.width;
+        imageInfo.extent.height = swapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = swapChainImageFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                          VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.flags = 0;
+
+        device.createImageWithInfo(imageInfo,
+                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                   sceneImages[i],
+                                   sceneImageMemorys[i]);
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(
+            device.device(), sceneImages[i], &memRequirements);
+        sceneImageBytes += memRequirements.size;
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = sceneImages[i];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = swapChainImageFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(
+                device.device(), &viewInfo, nullptr, &sceneImageViews[i]) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to create scene image view!");
+        }
+    }
+}
+
+LveSwapChain::AttachmentMemory LveSwapChain::getAttachmentMemory() {
+    AttachmentMemory memory{};
+    memory.depthImages = static_cast<uint32_t>(depthImages.size());
+    memory.swapChainImages = static_cast<uint32_t>(imageCount());
+    memory.depthBytes = depthImageBytes;
+    memory.lazilyAllocated = depthLazilyAllocated;
+    memory.sceneColorBytes = sceneImageBytes;
+    if (!depthLazilyAllocated) {
+        memory.committedBytes = depthImageBytes;
+        return memory;
+    }
+    for (auto imageMemory : depthImageMemorys) {
+        VkDeviceSize committed = 0;
+        vkGetDeviceMemoryCommitment(device.device(), imageMemory, &committed);
+        memory.committedBytes += committed;
+    }
+    return memory;
+}
+
 void LveSwapChain::createSyncObjects() {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    imageAvailableSemaphores.resize(framePacing.framesInFlight);
     renderFinishedSemaphores.resize(imageCount());
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+    // 0 is complete from the start, so every frame slot begins free
+    frameTimelineValues.assign(framePacing.framesInFlight, 0);
+    if (oldSwapChain != nullptr) {
+        // Frames of the previous chain may still be executing, and the
+        // per-frame resources outside the swap chain are indexed by slot,
+        // so the slots continue where the previous chain left off.
+        if (oldSwapChain->frameTimelineValues.size() ==
+            frameTimelineValues.size()) {
+            frameTimelineValues = oldSwapChain->frameTimelineValues;
+            currentFrame = oldSwapChain->currentFrame;
+        } else {
+            // with a different slot count every slot waits for all of them
+            std::fill(frameTimelineValues.begin(),
+                      frameTimelineValues.end(),
+                      oldSwapChain->getSubmittedFrameValue());
+        }
+    }
 
     VkSemaphoreCreateInfo semaphoreInfo = {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < imageCount(); i++) {
         if (vkCreateSemaphore(device.device(),
                               &semaphoreInfo,
@@ -403,14 +609,11 @@ void LveSwapChain::createSyncObjects() {
                 "Failed to create render finished semaphores for a frame");
         }
     }
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
         if (vkCreateSemaphore(device.device(),
                               &semaphoreInfo,
                               nullptr,
-                              &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(
-                device.device(), &fenceInfo, nullptr, &inFlightFences[i]) !=
-                VK_SUCCESS) {
+                              &imageAvailableSemaphores[i]) != VK_SUCCESS) {
             throw std::runtime_error(
                 "failed to create synchronization objects for a frame!");
         }
@@ -431,22 +634,50 @@ VkSurfaceFormatKHR LveSwapChain::chooseSwapSurfaceFormat(
 
 VkPresentModeKHR LveSwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR>& availablePresentModes) {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            std::cout << "Present mode: Mailbox" << std::endl;
-            return availablePresentMode;
-        }
+    std::vector<VkPresentModeKHR> preferred;
+    switch (framePacing.presentModePolicy) {
+        case PresentModePolicy::LOWEST_LATENCY:
+            preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR,
+                         VK_PRESENT_MODE_MAILBOX_KHR,
+                         VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+            break;
+        case PresentModePolicy::MAX_THROUGHPUT:
+            preferred = {VK_PRESENT_MODE_MAILBOX_KHR,
+                         VK_PRESENT_MODE_IMMEDIATE_KHR};
+            break;
+        case PresentModePolicy::VSYNC:
+        case PresentModePolicy::POWER_SAVING:
+            break;
     }
 
-    // for (const auto &availablePresentMode : availablePresentModes) {
-    //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-    //     std::cout << "Present mode: Immediate" << std::endl;
-    //     return availablePresentMode;
-    //   }
-    // }
+    VkPresentModeKHR chosen = VK_PRESENT_MODE_FIFO_KHR;
+    for (auto mode : preferred) {
+        if (std::find(availablePresentModes.begin(),
+                      availablePresentModes.end(),
+                      mode) != availablePresentModes.end()) {
+            chosen = mode;
+            break;
+        }
+    }
 
-    std::cout << "Present mode: V-Sync" << std::endl;
-    return VK_PRESENT_MODE_FIFO_KHR;
+    switch (chosen) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            std::cout << "Present mode: Immediate";
+            break;
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            std::cout << "Present mode: Mailbox";
+            break;
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            std::cout << "Present mode: Relaxed V-Sync";
+            break;
+        default:
+            std::cout << "Present mode: V-Sync";
+            break;
+    }
+    std::cout << " (" << presentModePolicyName(framePacing.presentModePolicy)
+              << ", " << framePacing.framesInFlight << " frames in flight)"
+              << std::endl;
+    return chosen;
 }
 
 VkExtent2D LveSwapChain::chooseSwapExtent(
@@ -473,7 +704,8 @@ VkFormat LveSwapChain::findDepthFormat() {
          VK_FORMAT_D32_SFLOAT_S8_UINT,
          VK_FORMAT_D24_UNORM_S8_UINT},
         VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
 }  // namespace lve
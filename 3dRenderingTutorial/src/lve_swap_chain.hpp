@@ -6,35 +6,145 @@
 #include <vulkan/vulkan.h>
 
 // std lib headers
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
 
 namespace lve {
 
+// Which present mode to pick, from the most to the least preferred one the
+// surface supports; FIFO is always available as the last resort.
+enum class PresentModePolicy {
+    LOWEST_LATENCY,  // immediate, then mailbox: tears, never waits
+    VSYNC,           // FIFO: no tearing, at most one image queued ahead
+    MAX_THROUGHPUT,  // mailbox, then immediate: renders uncapped
+    POWER_SAVING,    // FIFO with the fewest images the surface allows
+};
+
+const char* presentModePolicyName(PresentModePolicy policy);
+
+struct FramePacing {
+    // 1 to LveSwapChain::MAX_FRAMES_IN_FLIGHT. Fewer frames lower the
+    // input latency, more let the CPU run further ahead of the GPU.
+    int framesInFlight = 2;
+    PresentModePolicy presentModePolicy = PresentModePolicy::MAX_THROUGHPUT;
+};
+
+// Semaphore a frame's submission waits for besides the acquired image
+struct SubmitWait {
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    // for timeline semaphores
+    uint64_t value = 0;
+    VkPipelineStageFlags stages = 0;
+};
+
+// What happens to the depth attachment after the swapchain pass
+enum class DepthUsage {
+    // Discarded (store op DONT_CARE), so the images are transient and use
+    // lazily allocated memory where the device has it
+    TRANSIENT,
+    // Stored, so a later pass can sample it (the Hi-Z pyramid) or load it
+    // again (the resume render pass)
+    STORED,
+};
+
 class LveSwapChain {
    public:
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-    LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent);
+    // Upper bound of FramePacing::framesInFlight. Per-frame resources are
+    // allocated for this many frames, so the pacing can change at runtime
+    // without reallocating them.
+    static constexpr int MAX_FRAMES_IN_FLIGHT = 4;
+
+    // Memory of the depth attachments, which exist once per frame in
+    // flight rather than once per swapchain image
+    struct AttachmentMemory {
+        uint32_t depthImages = 0;
+        uint32_t swapChainImages = 0;
+        VkDeviceSize depthBytes = 0;
+        // Offscreen color images of the scene target, if any
+        VkDeviceSize sceneColorBytes = 0;
+        bool lazilyAllocated = false;
+        // Backing memory the driver actually committed so far; equal to
+        // depthBytes unless lazily allocated
+        VkDeviceSize committedBytes = 0;
+    };
+
+    // With sceneTarget the render passes draw into an offscreen color
+    // image per frame slot instead of the swapchain image, which the
+    // renderer then upscales into the swapchain image (see
+    // LveRenderer::setResolutionScaling).
+    LveSwapChain(LveDevice& deviceRef,
+                 VkExtent2D windowExtent,
+                 const FramePacing& pacing = {},
+                 DepthUsage depthUsage = DepthUsage::STORED,
+                 bool sceneTarget = false);
+    // Replaces previous, which must stay alive until the frames submitted
+    // to it have finished. Frame slots continue from previous when the
+    // frames in flight did not change.
     LveSwapChain(LveDevice& deviceRef,
                  VkExtent2D windowExtent,
+                 const FramePacing& pacing,
+                 DepthUsage depthUsage,
+                 bool sceneTarget,
                  std::shared_ptr<LveSwapChain> previous);
     ~LveSwapChain();
 
     LveSwapChain(const LveSwapChain&) = delete;
     LveSwapChain& operator=(const LveSwapChain&) = delete;
 
-    VkFramebuffer getFrameBuffer(int index) {
-        return swapChainFramebuffers[index];
+    // Framebuffers pair every image with the depth image of every frame
+    // slot, since an image may be acquired by any of them. With a scene
+    // target there is one per slot and imageIndex is ignored.
+    VkFramebuffer getFrameBuffer(int imageIndex, int frameIndex) {
+        if (sceneTarget) return swapChainFramebuffers[frameIndex];
+        return swapChainFramebuffers[imageIndex * getFramesInFlight() +
+                                     frameIndex];
+    }
+    bool hasSceneTarget() const { return sceneTarget; }
+    // Color attachment of the render passes with a scene target, left in
+    // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; it has the swapchain's size
+    // and format
+    VkImage getSceneImage(int frameIndex) { return sceneImages[frameIndex]; }
+    VkImageView getSceneImageView(int frameIndex) {
+        return sceneImageViews[frameIndex];
     }
     VkRenderPass getRenderPass() { return renderPass; }
+    VkRenderPass getResumeRenderPass() { return resumeRenderPass; }
+    // Depth attachments are indexed by frame slot, not by image
+    VkImage getDepthImage(int frameIndex) { return depthImages[frameIndex]; }
+    VkImageView getDepthImageView(int frameIndex) {
+        return depthImageViews[frameIndex];
+    }
+    DepthUsage getDepthUsage() const { return depthUsage; }
+    AttachmentMemory getAttachmentMemory();
+    VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
+    VkImage getImage(int index) { return swapChainImages[index]; }
     VkImageView getImageView(int index) { return swapChainImageViews[index]; }
     size_t imageCount() { return swapChainImages.size(); }
     VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
     VkExtent2D getSwapChainExtent() { return swapChainExtent; }
     uint32_t width() { return swapChainExtent.width; }
     uint32_t height() { return swapChainExtent.height; }
+    int getFramesInFlight() const { return framePacing.framesInFlight; }
+    // Frame slot the next acquireNextImage uses
+    int getCurrentFrame() const { return static_cast<int>(currentFrame); }
+    // LveDevice::timeline() value signaled by the most recently submitted
+    // frame, 0 before the first one
+    uint64_t getSubmittedFrameValue() const {
+        size_t previous = (currentFrame + frameTimelineValues.size() - 1) %
+                          frameTimelineValues.size();
+        return frameTimelineValues[previous];
+    }
+    const FramePacing& getFramePacing() const { return framePacing; }
+    VkPresentModeKHR getPresentMode() const { return presentMode; }
+    // When acquireNextImage last finished waiting for the timeline value of
+    // the frame that used the current frame index before, i.e. (no earlier
+    // than) when the GPU completed it
+    std::chrono::high_resolution_clock::time_point getFrameCompletedTime()
+        const {
+        return frameCompletedTime;
+    }
 
     float extentAspectRatio() {
         return static_cast<float>(swapChainExtent.width) /
@@ -44,7 +154,8 @@ class LveSwapChain {
 
     VkResult acquireNextImage(uint32_t* imageIndex);
     VkResult submitCommandBuffers(const VkCommandBuffer* buffers,
-                                  uint32_t* imageIndex);
+                                  uint32_t* imageIndex,
+                                  const std::vector<SubmitWait>& waits = {});
 
     const bool compareSwapFormats(const LveSwapChain& swapChain) {
         return (swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -56,7 +167,9 @@ class LveSwapChain {
     void createSwapChain();
     void createImageViews();
     void createDepthResources();
+    void createSceneResources();
     void createRenderPass();
+    VkRenderPass createRenderPass(VkAttachmentLoadOp loadOp);
     void createFramebuffers();
     void createSyncObjects();
 
@@ -67,16 +180,29 @@ class LveSwapChain {
         const std::vector<VkPresentModeKHR>& availablePresentModes);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
+    FramePacing framePacing;
+    DepthUsage depthUsage;
+    VkPresentModeKHR presentMode;
+    std::chrono::high_resolution_clock::time_point frameCompletedTime{};
+
     VkFormat swapChainImageFormat;
     VkFormat swapChainDepthFormat;
     VkExtent2D swapChainExtent;
 
     std::vector<VkFramebuffer> swapChainFramebuffers;
     VkRenderPass renderPass;
+    VkRenderPass resumeRenderPass;
 
     std::vector<VkImage> depthImages;
     std::vector<VkDeviceMemory> depthImageMemorys;
     std::vector<VkImageView> depthImageViews;
+    VkDeviceSize depthImageBytes = 0;
+    bool depthLazilyAllocated = false;
+    bool sceneTarget;
+    std::vector<VkImage> sceneImages;
+    std::vector<VkDeviceMemory> sceneImageMemorys;
+    std::vector<VkImageView> sceneImageViews;
+    VkDeviceSize sceneImageBytes = 0;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
 
@@ -88,8 +214,8 @@ class LveSwapChain {
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
-    std::vector<VkFence> imagesInFlight;
+    // LveDevice::timeline() value signaled by the last frame of each slot
+    std::vector<uint64_t> frameTimelineValues;
     size_t currentFrame = 0;
 };
 
@@ -0,0 +1,68 @@
+#include "lve_timeline.hpp"
+
+// std
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+LveTimeline::LveTimeline(LveDevice& device) : lveDevice{device} {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    if (vkCreateSemaphore(
+            lveDevice.device(), &semaphoreInfo, nullptr, &semaphore) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+    }
+}
+
+LveTimeline::~LveTimeline() {
+    vkDestroySemaphore(lveDevice.device(), semaphore, nullptr);
+}
+
+uint64_t LveTimeline::getCompletedValue() {
+    uint64_t value = 0;
+    if (vkGetSemaphoreCounterValue(lveDevice.device(), semaphore, &value) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to query timeline semaphore!");
+    }
+    raiseCompletedValue(value);
+    return completedValue;
+}
+
+bool LveTimeline::isComplete(uint64_t value) {
+    return value <= completedValue || value <= getCompletedValue();
+}
+
+void LveTimeline::wait(uint64_t value) {
+    if (value <= completedValue) return;
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore;
+    waitInfo.pValues = &value;
+    if (vkWaitSemaphores(lveDevice.device(),
+                         &waitInfo,
+                         std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for timeline semaphore!");
+    }
+    raiseCompletedValue(value);
+}
+
+void LveTimeline::raiseCompletedValue(uint64_t value) {
+    // other threads may have seen a higher value in the meantime
+    uint64_t known = completedValue;
+    while (known < value &&
+           !completedValue.compare_exchange_weak(known, value)) {
+    }
+}
+
+}  // namespace lve
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <atomic>
+#include <cstdint>
+
+namespace lve {
+
+// Timeline semaphore of the graphics queue. Every submission to the queue
+// signals the next value, so whether a submission has finished is a single
+// counter comparison: frame slots, uploads, readbacks and deferred
+// deletion all wait on values of this one semaphore instead of fences.
+// LveAsyncCompute keeps another one for the compute queue.
+//
+// Values must reach vkQueueSubmit in the order advance() returned them;
+// all graphics queue submissions happen on the render thread.
+class LveTimeline {
+   public:
+    explicit LveTimeline(LveDevice& device);
+    ~LveTimeline();
+
+    LveTimeline(const LveTimeline&) = delete;
+    LveTimeline& operator=(const LveTimeline&) = delete;
+
+    VkSemaphore getSemaphore() const { return semaphore; }
+
+    // Reserves the value for the next submission to signal
+    uint64_t advance() { return ++submittedValue; }
+    // Highest value handed out by advance, i.e. the latest submission
+    uint64_t getSubmittedValue() const { return submittedValue; }
+    // Queries the semaphore
+    uint64_t getCompletedValue();
+    // Only queries the semaphore when the last known value is lower
+    bool isComplete(uint64_t value);
+    void wait(uint64_t value);
+
+   private:
+    void raiseCompletedValue(uint64_t value);
+
+    LveDevice& lveDevice;
+    VkSemaphore semaphore;
+    std::atomic<uint64_t> submittedValue{0};
+    std::atomic<uint64_t> completedValue{0};
+};
+
+}  // namespace lve
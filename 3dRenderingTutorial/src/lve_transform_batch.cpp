@@ -0,0 +1,360 @@
+#include "lve_transform_batch.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define LVE_TRANSFORM_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LVE_TRANSFORM_SSE2
+#endif
+
+// std
+#include <cmath>
+
+namespace lve {
+
+namespace {
+
+// Matrix corrsponds to Translate * Ry * Rx * Rz * Scale, same as
+// LveGameObject::TransformComponent::mat4
+glm::mat4 scalarWorldMatrix(const TransformBatch& batch, size_t i) {
+    const float c3 = std::cos(batch.rotationZ[i]);
+    const float s3 = std::sin(batch.rotationZ[i]);
+    const float c2 = std::cos(batch.rotationX[i]);
+    const float s2 = std::sin(batch.rotationX[i]);
+    const float c1 = std::cos(batch.rotationY[i]);
+    const float s1 = std::sin(batch.rotationY[i]);
+    const float sx = batch.scaleX[i];
+    const float sy = batch.scaleY[i];
+    const float sz = batch.scaleZ[i];
+    return glm::mat4{
+        {
+            sx * (c1 * c3 + s1 * s2 * s3),
+            sx * (c2 * s3),
+            sx * (c1 * s2 * s3 - c3 * s1),
+            0.0f,
+        },
+        {
+            sy * (c3 * s1 * s2 - c1 * s3),
+            sy * (c2 * c3),
+            sy * (c1 * c3 * s2 + s1 * s3),
+            0.0f,
+        },
+        {
+            sz * (c2 * s1),
+            sz * (-s2),
+            sz * (c1 * c2),
+            0.0f,
+        },
+        {batch.translationX[i],
+         batch.translationY[i],
+         batch.translationZ[i],
+         1.0f}};
+}
+
+#if defined(LVE_TRANSFORM_AVX2)
+struct SimdOps {
+    using Float = __m256;
+    using Int = __m256i;
+    static constexpr int width = 8;
+
+    static Float load(const float* p) { return _mm256_loadu_ps(p); }
+    static Float set(float v) { return _mm256_set1_ps(v); }
+    static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    // a * b + c
+    static Float madd(Float a, Float b, Float c) {
+        return _mm256_fmadd_ps(a, b, c);
+    }
+    static Float bitAnd(Float a, Float b) { return _mm256_and_ps(a, b); }
+    // ~a & b
+    static Float bitAndNot(Float a, Float b) { return _mm256_andnot_ps(a, b); }
+    static Float bitXor(Float a, Float b) { return _mm256_xor_ps(a, b); }
+
+    static Int toInt(Float a) { return _mm256_cvttps_epi32(a); }
+    static Float toFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+    static Float asFloat(Int a) { return _mm256_castsi256_ps(a); }
+    static Int setInt(int v) { return _mm256_set1_epi32(v); }
+    static Int addInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+    static Int subInt(Int a, Int b) { return _mm256_sub_epi32(a, b); }
+    static Int andInt(Int a, Int b) { return _mm256_and_si256(a, b); }
+    static Int andNotInt(Int a, Int b) { return _mm256_andnot_si256(a, b); }
+    static Int equalInt(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+    static Int shiftToSign(Int a) { return _mm256_slli_epi32(a, 29); }
+
+    // rows[r] holds row r of one column for 8 objects; transposes each
+    // 128-bit half so every object's column lands in one store
+    static void storeColumn(const Float rows[4], glm::mat4* out, int col) {
+        for (int half = 0; half < 2; half++) {
+            __m128 r0 = half == 0 ? _mm256_castps256_ps128(rows[0])
+                                  : _mm256_extractf128_ps(rows[0], 1);
+            __m128 r1 = half == 0 ? _mm256_castps256_ps128(rows[1])
+                                  : _mm256_extractf128_ps(rows[1], 1);
+            __m128 r2 = half == 0 ? _mm256_castps256_ps128(rows[2])
+                                  : _mm256_extractf128_ps(rows[2], 1);
+            __m128 r3 = half == 0 ? _mm256_castps256_ps128(rows[3])
+                                  : _mm256_extractf128_ps(rows[3], 1);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(&out[half * 4 + 0][col][0], r0);
+            _mm_storeu_ps(&out[half * 4 + 1][col][0], r1);
+            _mm_storeu_ps(&out[half * 4 + 2][col][0], r2);
+            _mm_storeu_ps(&out[half * 4 + 3][col][0], r3);
+        }
+    }
+};
+#elif defined(LVE_TRANSFORM_SSE2)
+struct SimdOps {
+    using Float = __m128;
+    using Int = __m128i;
+    static constexpr int width = 4;
+
+    static Float load(const float* p) { return _mm_loadu_ps(p); }
+    static Float set(float v) { return _mm_set1_ps(v); }
+    static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    // a * b + c
+    static Float madd(Float a, Float b, Float c) {
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+    }
+    static Float bitAnd(Float a, Float b) { return _mm_and_ps(a, b); }
+    // ~a & b
+    static Float bitAndNot(Float a, Float b) { return _mm_andnot_ps(a, b); }
+    static Float bitXor(Float a, Float b) { return _mm_xor_ps(a, b); }
+
+    static Int toInt(Float a) { return _mm_cvttps_epi32(a); }
+    static Float toFloat(Int a) { return _mm_cvtepi32_ps(a); }
+    static Float asFloat(Int a) { return _mm_castsi128_ps(a); }
+    static Int setInt(int v) { return _mm_set1_epi32(v); }
+    static Int addInt(Int a, Int b) { return _mm_add_epi32(a, b); }
+    static Int subInt(Int a, Int b) { return _mm_sub_epi32(a, b); }
+    static Int andInt(Int a, Int b) { return _mm_and_si128(a, b); }
+    static Int andNotInt(Int a, Int b) { return _mm_andnot_si128(a, b); }
+    static Int equalInt(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+    static Int shiftToSign(Int a) { return _mm_slli_epi32(a, 29); }
+
+    // rows[r] holds row r of one column for 4 objects; after the transpose
+    // each register is one object's column
+    static void storeColumn(const Float rows[4], glm::mat4* out, int col) {
+        Float r0 = rows[0];
+        Float r1 = rows[1];
+        Float r2 = rows[2];
+        Float r3 = rows[3];
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(&out[0][col][0], r0);
+        _mm_storeu_ps(&out[1][col][0], r1);
+        _mm_storeu_ps(&out[2][col][0], r2);
+        _mm_storeu_ps(&out[3][col][0], r3);
+    }
+};
+#endif
+
+#if defined(LVE_TRANSFORM_AVX2) || defined(LVE_TRANSFORM_SSE2)
+using Float = SimdOps::Float;
+using Int = SimdOps::Int;
+
+// Computes sin and cos of every lane at once. Cephes-style range reduction
+// to [-pi/4, pi/4] followed by the sinf/cosf minimax polynomials; the error
+// stays around 1e-7 for the angle ranges a transform component sees.
+void sinCos(Float x, Float& sinOut, Float& cosOut) {
+    using S = SimdOps;
+    const Float signMask = S::asFloat(S::setInt(0x80000000));
+
+    Float signBitSin = S::bitAnd(x, signMask);
+    x = S::bitAndNot(signMask, x);
+
+    // j = (int(x * 4/pi) + 1) & ~1, the octant rounded to an even number
+    Int j = S::toInt(S::mul(x, S::set(1.27323954473516f)));
+    j = S::addInt(j, S::setInt(1));
+    j = S::andInt(j, S::setInt(~1));
+    Float y = S::toFloat(j);
+
+    Float swapSignBitSin =
+        S::asFloat(S::shiftToSign(S::andInt(j, S::setInt(4))));
+    Float polyMask = S::asFloat(
+        S::equalInt(S::andInt(j, S::setInt(2)), S::setInt(0)));
+    Float signBitCos = S::asFloat(S::shiftToSign(
+        S::andNotInt(S::subInt(j, S::setInt(2)), S::setInt(4))));
+    signBitSin = S::bitXor(signBitSin, swapSignBitSin);
+
+    // extended precision modular arithmetic: x - y * pi/4
+    x = S::madd(y, S::set(-0.78515625f), x);
+    x = S::madd(y, S::set(-2.4187564849853515625e-4f), x);
+    x = S::madd(y, S::set(-3.77489497744594108e-8f), x);
+
+    Float z = S::mul(x, x);
+
+    Float cosPoly = S::set(2.443315711809948e-5f);
+    cosPoly = S::madd(cosPoly, z, S::set(-1.388731625493765e-3f));
+    cosPoly = S::madd(cosPoly, z, S::set(4.166664568298827e-2f));
+    cosPoly = S::mul(S::mul(cosPoly, z), z);
+    cosPoly = S::madd(z, S::set(-0.5f), cosPoly);
+    cosPoly = S::add(cosPoly, S::set(1.f));
+
+    Float sinPoly = S::set(-1.9515295891e-4f);
+    sinPoly = S::madd(sinPoly, z, S::set(8.3321608736e-3f));
+    sinPoly = S::madd(sinPoly, z, S::set(-1.6666654611e-1f));
+    sinPoly = S::madd(S::mul(sinPoly, z), x, x);
+
+    Float sinValue = S::add(S::bitAnd(polyMask, sinPoly),
+                            S::bitAndNot(polyMask, cosPoly));
+    Float cosValue = S::add(S::bitAndNot(polyMask, sinPoly),
+                            S::bitAnd(polyMask, cosPoly));
+
+    sinOut = S::bitXor(sinValue, signBitSin);
+    cosOut = S::bitXor(cosValue, signBitCos);
+}
+
+// Builds the world matrices of objects [first, first + width) and writes
+// them (optionally premultiplied by projectionView) to out[first...].
+void computeBlock(const TransformBatch& batch,
+                  size_t first,
+                  const glm::mat4* projectionView,
+                  glm::mat4* out) {
+    using S = SimdOps;
+
+    Float s1, c1, s2, c2, s3, c3;
+    sinCos(S::load(&batch.rotationY[first]), s1, c1);
+    sinCos(S::load(&batch.rotationX[first]), s2, c2);
+    sinCos(S::load(&batch.rotationZ[first]), s3, c3);
+
+    const Float sx = S::load(&batch.scaleX[first]);
+    const Float sy = S::load(&batch.scaleY[first]);
+    const Float sz = S::load(&batch.scaleZ[first]);
+
+    // m[column][row], rows 0..2 of the affine part
+    Float m[4][3];
+    const Float s1s2 = S::mul(s1, s2);
+    const Float c1s2 = S::mul(c1, s2);
+    m[0][0] = S::mul(sx, S::madd(s1s2, s3, S::mul(c1, c3)));
+    m[0][1] = S::mul(sx, S::mul(c2, s3));
+    m[0][2] = S::mul(sx, S::sub(S::mul(c1s2, s3), S::mul(c3, s1)));
+    m[1][0] = S::mul(sy, S::sub(S::mul(s1s2, c3), S::mul(c1, s3)));
+    m[1][1] = S::mul(sy, S::mul(c2, c3));
+    m[1][2] = S::mul(sy, S::madd(c1s2, c3, S::mul(s1, s3)));
+    m[2][0] = S::mul(sz, S::mul(c2, s1));
+    m[2][1] = S::sub(S::set(0.f), S::mul(sz, s2));
+    m[2][2] = S::mul(sz, S::mul(c1, c2));
+    m[3][0] = S::load(&batch.translationX[first]);
+    m[3][1] = S::load(&batch.translationY[first]);
+    m[3][2] = S::load(&batch.translationZ[first]);
+
+    Float rows[4];
+    if (projectionView == nullptr) {
+        for (int col = 0; col < 4; col++) {
+            rows[0] = m[col][0];
+            rows[1] = m[col][1];
+            rows[2] = m[col][2];
+            rows[3] = S::set(col == 3 ? 1.f : 0.f);
+            S::storeColumn(rows, out + first, col);
+        }
+    } else {
+        // (P * M)[col][row] = sum_k P[k][row] * M[col][k], where M[col][3]
+        // is 0 for the basis columns and 1 for the translation column
+        const glm::mat4& pv = *projectionView;
+        for (int col = 0; col < 4; col++) {
+            for (int row = 0; row < 4; row++) {
+                Float value = col == 3 ? S::set(pv[3][row]) : S::set(0.f);
+                value = S::madd(S::set(pv[0][row]), m[col][0], value);
+                value = S::madd(S::set(pv[1][row]), m[col][1], value);
+                value = S::madd(S::set(pv[2][row]), m[col][2], value);
+                rows[row] = value;
+            }
+            S::storeColumn(rows, out + first, col);
+        }
+    }
+}
+#endif
+
+void computeAll(const TransformBatch& batch,
+                const glm::mat4* projectionView,
+                glm::mat4* out) {
+    const size_t count = batch.size();
+    size_t i = 0;
+
+#if defined(LVE_TRANSFORM_AVX2) || defined(LVE_TRANSFORM_SSE2)
+    for (; i + SimdOps::width <= count; i += SimdOps::width) {
+        computeBlock(batch, i, projectionView, out);
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = projectionView == nullptr
+                     ? scalarWorldMatrix(batch, i)
+                     : *projectionView * scalarWorldMatrix(batch, i);
+    }
+}
+
+}  // namespace
+
+void TransformBatch::clear() {
+    translationX.clear();
+    translationY.clear();
+    translationZ.clear();
+    rotationX.clear();
+    rotationY.clear();
+    rotationZ.clear();
+    scaleX.clear();
+    scaleY.clear();
+    scaleZ.clear();
+}
+
+void TransformBatch::reserve(size_t count) {
+    translationX.reserve(count);
+    translationY.reserve(count);
+    translationZ.reserve(count);
+    rotationX.reserve(count);
+    rotationY.reserve(count);
+    rotationZ.reserve(count);
+    scaleX.reserve(count);
+    scaleY.reserve(count);
+    scaleZ.reserve(count);
+}
+
+void TransformBatch::push_back(const glm::vec3& translation,
+                               const glm::vec3& rotation,
+                               const glm::vec3& scale) {
+    translationX.push_back(translation.x);
+    translationY.push_back(translation.y);
+    translationZ.push_back(translation.z);
+    rotationX.push_back(rotation.x);
+    rotationY.push_back(rotation.y);
+    rotationZ.push_back(rotation.z);
+    scaleX.push_back(scale.x);
+    scaleY.push_back(scale.y);
+    scaleZ.push_back(scale.z);
+}
+
+void TransformBatch::computeWorldMatrices(glm::mat4* worldMatrices) const {
+    computeAll(*this, nullptr, worldMatrices);
+}
+
+void TransformBatch::computeWorldMatrices(const glm::mat4& projectionView,
+                                          glm::mat4* outMatrices) const {
+    computeAll(*this, &projectionView, outMatrices);
+}
+
+void TransformBatch::computeWorldMatricesScalar(
+    glm::mat4* worldMatrices) const {
+    for (size_t i = 0; i < size(); i++) {
+        worldMatrices[i] = scalarWorldMatrix(*this, i);
+    }
+}
+
+void TransformBatch::computeWorldMatricesScalar(
+    const glm::mat4& projectionView, glm::mat4* outMatrices) const {
+    for (size_t i = 0; i < size(); i++) {
+        outMatrices[i] = projectionView * scalarWorldMatrix(*this, i);
+    }
+}
+
+int TransformBatch::simdWidth() {
+#if defined(LVE_TRANSFORM_AVX2) || defined(LVE_TRANSFORM_SSE2)
+    return SimdOps::width;
+#else
+    return 1;
+#endif
+}
+
+}  // namespace lve
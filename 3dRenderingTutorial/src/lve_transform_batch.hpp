@@ -0,0 +1,52 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <vector>
+
+namespace lve {
+
+// Structure-of-arrays copy of many TransformComponents so their world
+// matrices can be built several objects at a time. The SIMD width is picked
+// at compile time: 8 lanes when built with -mavx2 -mfma (make AVX2=1), 4
+// lanes with SSE2 (always available on x86-64), scalar otherwise.
+struct TransformBatch {
+    std::vector<float> translationX{};
+    std::vector<float> translationY{};
+    std::vector<float> translationZ{};
+    std::vector<float> rotationX{};
+    std::vector<float> rotationY{};
+    std::vector<float> rotationZ{};
+    std::vector<float> scaleX{};
+    std::vector<float> scaleY{};
+    std::vector<float> scaleZ{};
+
+    size_t size() const { return translationX.size(); }
+    void clear();
+    void reserve(size_t count);
+    void push_back(const glm::vec3& translation,
+                   const glm::vec3& rotation,
+                   const glm::vec3& scale);
+
+    // Same matrix as TransformComponent::mat4, written to worldMatrices[i]
+    // for every entry. The output array must hold size() matrices.
+    void computeWorldMatrices(glm::mat4* worldMatrices) const;
+    // Writes projectionView * world instead of world.
+    void computeWorldMatrices(const glm::mat4& projectionView,
+                              glm::mat4* outMatrices) const;
+
+    // Per-object reference path using libm sin/cos, used for the remainder
+    // lanes and for checking the SIMD kernels.
+    void computeWorldMatricesScalar(glm::mat4* worldMatrices) const;
+    void computeWorldMatricesScalar(const glm::mat4& projectionView,
+                                    glm::mat4* outMatrices) const;
+
+    // Number of objects processed per SIMD iteration in this build.
+    static int simdWidth();
+};
+
+}  // namespace lve
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 
 namespace lve {
@@ -10,4 +12,17 @@ void hashCombine(std::size_t& seed, const T& v, const Rest&... rest) {
     seed ^= std::hash<T>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
     (hashCombine(seed, rest), ...);
 };
+
+// 64-bit FNV-1a; stable across runs, so usable for on-disk cache keys.
+// Pass the previous result as hash to continue over several buffers.
+inline uint64_t hashBytes(const void* data,
+                          size_t size,
+                          uint64_t hash = 14695981039346656037ull) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
 }  // namespace lve
\ No newline at end of file
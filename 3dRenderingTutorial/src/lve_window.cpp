@@ -4,9 +4,10 @@
 
 namespace lve {
 
-LveWindow::LveWindow(int w, int h, std::string name)
+LveWindow::LveWindow(int w, int h, std::string name, bool headless)
     : width{w},
       height{h},
+      headless{headless},
       windowName{name} {
     initWindow();
 }
@@ -17,9 +18,18 @@ LveWindow::~LveWindow() {
 }
 
 void LveWindow::initWindow() {
-    glfwInit();
+    if (headless) {
+#ifdef GLFW_PLATFORM_NULL
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+        throw std::runtime_error("Headless mode needs GLFW 3.4 or newer");
+#endif
+    }
+    if (glfwInit() != GLFW_TRUE) {
+        throw std::runtime_error("Failed to initialize GLFW");
+    }
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+    glfwWindowHint(GLFW_RESIZABLE, headless ? GLFW_FALSE : GLFW_TRUE);
 
     window =
         glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
@@ -27,8 +37,36 @@ void LveWindow::initWindow() {
     glfwSetFramebufferSizeCallback(window, frameBufferResizedCallback);
 }
 
+std::vector<const char*> LveWindow::getRequiredInstanceExtensions() {
+    if (headless) {
+        return {VK_KHR_SURFACE_EXTENSION_NAME,
+                VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
+    }
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions =
+        glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    if (glfwExtensions == nullptr) {
+        throw std::runtime_error("Vulkan surfaces are not supported");
+    }
+    return {glfwExtensions, glfwExtensions + glfwExtensionCount};
+}
+
 void LveWindow::createWindowSurface(VkInstance instance,
                                     VkSurfaceKHR* surface) {
+    if (headless) {
+        // created directly, GLFW's null platform may not support Vulkan
+        auto vkCreateHeadlessSurfaceEXT =
+            reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(
+                vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT"));
+        VkHeadlessSurfaceCreateInfoEXT createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+        if (vkCreateHeadlessSurfaceEXT == nullptr ||
+            vkCreateHeadlessSurfaceEXT(
+                instance, &createInfo, nullptr, surface) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create headless surface");
+        }
+        return;
+    }
     if (glfwCreateWindowSurface(instance, window, nullptr, surface) !=
         VK_SUCCESS) {
         throw std::runtime_error("Failed to create window surface");
@@ -4,12 +4,17 @@
 #include <GLFW/glfw3.h>
 
 #include <string>
+#include <vector>
 
 namespace lve {
 
 class LveWindow {
    public:
-    LveWindow(int w, int h, std::string name);
+    // A headless window needs no display: it uses GLFW's null platform
+    // (GLFW 3.4 or newer) for input and events, and a surface from
+    // VK_EXT_headless_surface, whose presents are no-ops. The swapchain
+    // is then just a ring of offscreen images.
+    LveWindow(int w, int h, std::string name, bool headless = false);
     ~LveWindow();
 
     LveWindow(const LveWindow&) = delete;
@@ -22,7 +27,10 @@ class LveWindow {
     bool wasWindowResized() { return framebufferResized; }
     void resetWindowResizedFlag() { framebufferResized = false; }
     GLFWwindow* getGLFWwindow() const { return window; };
+    bool isHeadless() const { return headless; }
 
+    // Instance extensions createWindowSurface needs
+    std::vector<const char*> getRequiredInstanceExtensions();
     void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 
    private:
@@ -34,6 +42,7 @@ class LveWindow {
     int width;
     int height;
     bool framebufferResized = false;
+    bool headless;
 
     std::string windowName;
     GLFWwindow* window;
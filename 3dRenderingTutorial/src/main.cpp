@@ -2,13 +2,51 @@
 
 // STD includes
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main() {
-    lve::FirstApp app{};
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "usage: " << program
+              << " [--headless] [--frames <count>] [--trace <file>]"
+              << " [--occluder-test]\n"
+              << "  --headless        render without a display\n"
+              << "  --frames <count>  exit after rendering count frames\n"
+              << "  --trace <file>    write a Chrome trace on exit\n"
+              << "  --occluder-test   render a wall hiding a grid of vases,\n"
+              << "                    fail unless all are reported occluded\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    lve::FirstApp::Options options{};
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            try {
+                options.frameLimit =
+                    static_cast<uint32_t>(std::stoul(argv[++i]));
+            } catch (const std::exception&) {
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--occluder-test") == 0) {
+            options.occluderTest = true;
+        } else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
     try {
+        lve::FirstApp app{options};
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << "\n";
@@ -16,4 +54,4 @@ int main() {
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -1,9 +1,13 @@
 #include "simple_render_system.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
 
+#include "lve_gpu_profiler.hpp"
+#include "lve_timeline.hpp"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -11,35 +15,53 @@
 
 namespace lve {
 
-struct SimplePushConstantData {
-    glm::mat4 transform = {1.f};
-    alignas(16) glm::vec3 color;
-};
+namespace {
+
+// Whether recorded was taken from current's object. Unlike addresses, an
+// object allocated where a destroyed one was does not match it.
+template <typename T>
+bool isSameOwner(const std::weak_ptr<T>& recorded,
+                 const std::shared_ptr<T>& current) {
+    return !recorded.owner_before(current) && !current.owner_before(recorded);
+}
+
+}  // namespace
 
 SimpleRenderSystem::SimpleRenderSystem(LveDevice& device,
-                                       VkRenderPass renderPass)
-    : lveDevice{device} {
-    createPipelineLayout();
-    createPipeline(renderPass);
+                                       LvePipelineRegistry& pipelineRegistry,
+                                       const RenderTargetInfo& renderTarget,
+                                       VkDescriptorSetLayout globalSetLayout)
+    : lveDevice{device},
+      pipelineRegistry{pipelineRegistry},
+      renderTarget{renderTarget} {
+    createPipelineLayout(globalSetLayout);
+    getPipelineVariant(activeVariant);
+    getPipelineVariant(activeVariant | BACK_FACE_CULLING_BIT);
 }
 
 SimpleRenderSystem::~SimpleRenderSystem() {
+    for (auto& recorded : recordedCommands) {
+        if (recorded.commandBuffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(lveDevice.device(),
+                                 lveDevice.getCommandPool(),
+                                 1,
+                                 &recorded.commandBuffer);
+        }
+    }
     vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
 }
 
-void SimpleRenderSystem::createPipelineLayout() {
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags =
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(SimplePushConstantData);
+void SimpleRenderSystem::createPipelineLayout(
+    VkDescriptorSetLayout globalSetLayout) {
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pSetLayouts = nullptr;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.setLayoutCount =
+        static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
     if (vkCreatePipelineLayout(lveDevice.device(),
                                &pipelineLayoutInfo,
@@ -49,42 +71,423 @@ void SimpleRenderSystem::createPipelineLayout() {
     }
 }
 
-void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+LveAsyncPipeline& SimpleRenderSystem::getPipelineVariant(VariantKey key) {
+    auto found = pipelineVariants.find(key);
+    if (found != pipelineVariants.end()) {
+        return found->second;
+    }
+
     assert(pipelineLayout != nullptr &&
            "Cannot create pipeline before pipeline layout");
 
     PipelineConfigInfo pipelineConfig{};
     LvePipeline::defaultPipeLineConfigInfo(pipelineConfig);
-    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.setRenderTarget(renderTarget);
     pipelineConfig.pipelineLayout = pipelineLayout;
-    lvePipeline =
-        std::make_unique<LvePipeline>(lveDevice,
-                                      "shaders/simple_shader.vert.spv",
-                                      "shaders/simple_shader.frag.spv",
-                                      pipelineConfig);
+    if (key & BACK_FACE_CULLING_BIT) {
+        pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    }
+    for (uint32_t i = 0; i < SHADER_OPTION_COUNT; i++) {
+        pipelineConfig.specializationConstants.push_back((key >> i) & 1u);
+    }
+
+    auto& variant = pipelineVariants[key];
+    variant = pipelineRegistry.getPipelineAsync(
+        VERT_SHADER_PATH, FRAG_SHADER_PATH, pipelineConfig);
+    return variant;
 }
 
-void SimpleRenderSystem::renderGameObjects(
+void SimpleRenderSystem::selectVariant(VariantKey key) {
+    if (key == activeVariant) return;
+
+    auto& requested = getPipelineVariant(key);
+    // keeps a fast-linked stand-in from the registry
+    if (!requested.isReady() && !requested.hasFallback()) {
+        requested.setFallback(pipelineVariants.at(activeVariant).get());
+    }
+    activeVariant = key;
+}
+
+void SimpleRenderSystem::setShaderOptions(uint32_t options) {
+    assert((options & ~SHADER_OPTIONS_MASK) == 0 && "Unknown shader option");
+    selectVariant((activeVariant & ~SHADER_OPTIONS_MASK) | options);
+}
+
+void SimpleRenderSystem::setBackFaceCulling(bool enabled) {
+    selectVariant(enabled ? activeVariant | BACK_FACE_CULLING_BIT
+                          : activeVariant & ~BACK_FACE_CULLING_BIT);
+}
+
+void SimpleRenderSystem::reloadShaders(
+    const std::vector<std::string>& changedShaders) {
+    bool affected = false;
+    for (auto& path : changedShaders) {
+        affected |= path == VERT_SHADER_PATH || path == FRAG_SHADER_PATH;
+    }
+    if (!affected) return;
+
+    auto current = lvePipeline != nullptr
+                       ? lvePipeline
+                       : pipelineVariants.at(activeVariant).get();
+    pipelineVariants.clear();
+    auto& reloaded = getPipelineVariant(activeVariant);
+    if (!reloaded.hasFallback()) {
+        reloaded.setFallback(current);
+    }
+}
+
+void SimpleRenderSystem::selectPipeline() {
+    // A replaced pipeline was last used by frames that are already
+    // submitted, so it can go once the latest submission has completed.
+    auto& timeline = lveDevice.timeline();
+    retiredPipelines.erase(
+        std::remove_if(retiredPipelines.begin(),
+                       retiredPipelines.end(),
+                       [&timeline](const auto& retired) {
+                           return timeline.isComplete(retired.second);
+                       }),
+        retiredPipelines.end());
+
+    // Blocks only on the very first frame, when no variant has a fallback.
+    auto pipeline = pipelineVariants.at(activeVariant).get();
+    if (lvePipeline != nullptr && pipeline != lvePipeline) {
+        retiredPipelines.emplace_back(std::move(lvePipeline),
+                                      timeline.getSubmittedValue());
+    }
+    lvePipeline = std::move(pipeline);
+}
+
+void SimpleRenderSystem::updateTransforms(
+    std::vector<LveGameObject>& gameObjects) {
+    // Only transforms changed since their last rebuild are recomputed, all
+    // of them in one SIMD batch; static scenery costs a flag check.
+    transformBatch.clear();
+    dirtyObjects.clear();
+    for (auto& obj : gameObjects) {
+        if (obj.transform.isDirty()) {
+            transformBatch.push_back(obj.transform.getTranslation(),
+                                     obj.transform.getRotation(),
+                                     obj.transform.getScale());
+            dirtyObjects.push_back(&obj);
+        }
+    }
+    if (dirtyObjects.empty()) {
+        return;
+    }
+
+    worldMatrices.resize(dirtyObjects.size());
+    transformBatch.computeWorldMatrices(worldMatrices.data());
+    for (size_t i = 0; i < dirtyObjects.size(); i++) {
+        dirtyObjects[i]->transform.updateCache(worldMatrices[i]);
+    }
+}
+
+void SimpleRenderSystem::uploadObjects(
+    FrameInfo& frameInfo, std::vector<LveGameObject>& gameObjects) {
+    // Model and normal matrices go to the frame's storage buffer; the
+    // shader picks its entry through gl_InstanceIndex, so each draw passes
+    // its slot as firstInstance instead of pushing a matrix. Every frame in
+    // flight has its own buffer, so each remembers what it holds and only
+    // stale slots are rewritten.
+    const size_t frameIndex = static_cast<size_t>(frameInfo.frameIndex);
+    if (uploadedObjects.size() <= frameIndex) {
+        uploadedObjects.resize(frameIndex + 1);
+    }
+    auto& uploaded = uploadedObjects[frameIndex];
+    uploaded.resize(gameObjects.size());
+
+    bool written = false;
+    for (uint32_t i = 0; i < gameObjects.size(); i++) {
+        auto& obj = gameObjects[i];
+        auto& slot = uploaded[i];
+        if (slot.valid && slot.id == obj.getId() &&
+            slot.version == obj.transform.getVersion() &&
+            slot.color == obj.color) {
+            continue;
+        }
+
+        ObjectData data{};
+        data.modelMatrix = obj.transform.mat4();
+        const glm::mat3& normalMatrix = obj.transform.normalMatrix();
+        for (int column = 0; column < 3; column++) {
+            data.normalMatrix[column] = glm::vec4(normalMatrix[column], 0.f);
+        }
+        data.color = glm::vec4(obj.color, 1.f);
+        frameInfo.objectBuffer.writeToIndex(&data, i);
+
+        slot.valid = true;
+        slot.id = obj.getId();
+        slot.version = obj.transform.getVersion();
+        slot.color = obj.color;
+        written = true;
+    }
+
+    if (written) {
+        frameInfo.objectBuffer.flush();
+    }
+}
+
+void SimpleRenderSystem::cullGameObjects(
+    FrameInfo& frameInfo, std::vector<LveGameObject>& gameObjects) {
+    // Bounding spheres are moved to world space here; the plane tests run
+    // several objects at a time in CullingBatch. Culled objects keep their
+    // object buffer slot, they are just not drawn.
+    cullingBatch.clear();
+    cullingBatch.reserve(gameObjects.size());
+    for (auto& obj : gameObjects) {
+        const auto& sphere = obj.model->getBoundingSphere();
+        const glm::mat4& world = obj.transform.mat4();
+        const glm::vec3 axisX{world[0]};
+        const glm::vec3 axisY{world[1]};
+        const glm::vec3 axisZ{world[2]};
+        const float maxScaleSquared =
+            glm::max(glm::dot(axisX, axisX),
+                     glm::max(glm::dot(axisY, axisY), glm::dot(axisZ, axisZ)));
+        cullingBatch.push_back(glm::vec3{world * glm::vec4{sphere.center, 1.f}},
+                               sphere.radius * glm::sqrt(maxScaleSquared));
+    }
+
+    cullingBatch.cull(frameInfo.camera.getFrustum(), visibleObjects);
+    cullingStats.visible = static_cast<uint32_t>(visibleObjects.size());
+    cullingStats.culled =
+        static_cast<uint32_t>(gameObjects.size() - visibleObjects.size());
+}
+
+void SimpleRenderSystem::drawGameObjects(
     VkCommandBuffer commandBuffer,
-    std::vector<LveGameObject>& gameObjects,
-    const LveCamera& camera) {
+    VkDescriptorSet globalDescriptorSet,
+    std::vector<LveGameObject>& gameObjects) {
     lvePipeline->bind(commandBuffer);
-    auto projectionView = camera.getProjectionMatrix() * camera.getViewMatrix();
 
-    for (auto& obj : gameObjects) {
-        SimplePushConstantData push{};
-        push.color = obj.color;
-        push.transform = projectionView * obj.transform.mat4();
-
-        vkCmdPushConstants(
-            commandBuffer,
-            pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            0,
-            sizeof(SimplePushConstantData),
-            &push);
+    lveDevice.counters().add(LveCounters::DESCRIPTOR_SET_BINDS);
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout,
+                            0,
+                            1,
+                            &globalDescriptorSet,
+                            0,
+                            nullptr);
+
+    for (uint32_t i : visibleObjects) {
+        auto& obj = gameObjects[i];
         obj.model->bind(commandBuffer);
-        obj.model->draw(commandBuffer);
+        obj.model->draw(commandBuffer, 1, i);
+    }
+}
+
+void SimpleRenderSystem::renderGameObjects(
+    FrameInfo& frameInfo, std::vector<LveGameObject>& gameObjects) {
+    assert(gameObjects.size() <= frameInfo.objectBuffer.getInstanceCount() &&
+           "Object storage buffer is too small for the scene");
+
+    selectPipeline();
+    updateTransforms(gameObjects);
+    uploadObjects(frameInfo, gameObjects);
+    cullGameObjects(frameInfo, gameObjects);
+    drawGameObjects(
+        frameInfo.commandBuffer, frameInfo.globalDescriptorSet, gameObjects);
+}
+
+bool SimpleRenderSystem::isRecordingCurrent(
+    const RecordedCommands& recorded,
+    FrameInfo& frameInfo,
+    std::vector<LveGameObject>& gameObjects,
+    VkRenderPass renderPass,
+    VkExtent2D extent) const {
+    if (!recorded.valid || !isSameOwner(recorded.pipeline, lvePipeline) ||
+        recorded.renderPass != renderPass ||
+        recorded.extent.width != extent.width ||
+        recorded.extent.height != extent.height ||
+        recorded.descriptorSet != frameInfo.globalDescriptorSet ||
+        recorded.objects.size() != gameObjects.size() ||
+        recorded.visibleObjects != visibleObjects) {
+        return false;
+    }
+    for (size_t i = 0; i < gameObjects.size(); i++) {
+        if (recorded.objects[i].first != gameObjects[i].getId() ||
+            !isSameOwner(recorded.objects[i].second, gameObjects[i].model)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SimpleRenderSystem::recordGameObjects(
+    RecordedCommands& recorded,
+    FrameInfo& frameInfo,
+    std::vector<LveGameObject>& gameObjects,
+    VkRenderPass renderPass,
+    VkExtent2D extent) {
+    if (recorded.commandBuffer == VK_NULL_HANDLE) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = lveDevice.getCommandPool();
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(lveDevice.device(),
+                                     &allocInfo,
+                                     &recorded.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error(
+                "Could not allocate secondary command buffer");
+        }
+    }
+
+    // The framebuffer is left unspecified so the same recording works for
+    // every swapchain image.
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+    // counted by the query LveGpuProfiler keeps active over the frame
+    if (lveDevice.hasPipelineStatistics()) {
+        inheritanceInfo.pipelineStatistics =
+            LveGpuProfiler::PIPELINE_STATISTICS;
+    }
+
+    // Without a render pass the attachment formats are inherited instead
+    VkCommandBufferInheritanceRenderingInfoKHR renderingInheritance{};
+    if (renderPass == VK_NULL_HANDLE) {
+        renderingInheritance.sType =
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+        renderingInheritance.colorAttachmentCount =
+            static_cast<uint32_t>(renderTarget.colorFormats.size());
+        renderingInheritance.pColorAttachmentFormats =
+            renderTarget.colorFormats.data();
+        renderingInheritance.depthAttachmentFormat = renderTarget.depthFormat;
+        renderingInheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        inheritanceInfo.pNext = &renderingInheritance;
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    // The pool is created with RESET_COMMAND_BUFFER_BIT, so beginning again
+    // implicitly resets the previous recording. The primary that last
+    // executed it belonged to this frame index and has already completed.
+    if (vkBeginCommandBuffer(recorded.commandBuffer, &beginInfo) !=
+        VK_SUCCESS) {
+        throw std::runtime_error(
+            "Failed to begin recording secondary command buffer");
+    }
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, extent};
+    vkCmdSetViewport(recorded.commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(recorded.commandBuffer, 0, 1, &scissor);
+
+    drawGameObjects(
+        recorded.commandBuffer, frameInfo.globalDescriptorSet, gameObjects);
+
+    if (vkEndCommandBuffer(recorded.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record secondary command buffer");
+    }
+
+    recorded.valid = true;
+    recorded.pipeline = lvePipeline;
+    recorded.renderPass = renderPass;
+    recorded.extent = extent;
+    recorded.descriptorSet = frameInfo.globalDescriptorSet;
+    recorded.objects.clear();
+    for (auto& obj : gameObjects) {
+        recorded.objects.emplace_back(obj.getId(), obj.model);
+    }
+    recorded.visibleObjects = visibleObjects;
+}
+
+void SimpleRenderSystem::renderGameObjectsRecorded(
+    FrameInfo& frameInfo,
+    std::vector<LveGameObject>& gameObjects,
+    VkRenderPass renderPass,
+    VkExtent2D extent) {
+    assert(gameObjects.size() <= frameInfo.objectBuffer.getInstanceCount() &&
+           "Object storage buffer is too small for the scene");
+
+    selectPipeline();
+    updateTransforms(gameObjects);
+    uploadObjects(frameInfo, gameObjects);
+    cullGameObjects(frameInfo, gameObjects);
+
+    const size_t frameIndex = static_cast<size_t>(frameInfo.frameIndex);
+    if (recordedCommands.size() <= frameIndex) {
+        recordedCommands.resize(frameIndex + 1);
+    }
+    auto& recorded = recordedCommands[frameIndex];
+    if (!isRecordingCurrent(
+            recorded, frameInfo, gameObjects, renderPass, extent)) {
+        recordGameObjects(
+            recorded, frameInfo, gameObjects, renderPass, extent);
+    }
+
+    vkCmdExecuteCommands(frameInfo.commandBuffer, 1, &recorded.commandBuffer);
+}
+
+void SimpleRenderSystem::prepareOcclusionCulling(
+    FrameInfo& frameInfo,
+    std::vector<LveGameObject>& gameObjects,
+    LveOcclusionCuller& occlusionCuller) {
+    assert(gameObjects.size() <= frameInfo.objectBuffer.getInstanceCount() &&
+           "Object storage buffer is too small for the scene");
+
+    selectPipeline();
+    updateTransforms(gameObjects);
+    uploadObjects(frameInfo, gameObjects);
+    cullGameObjects(frameInfo, gameObjects);
+
+    // only objects in the frustum are worth an occlusion test
+    for (uint32_t i : visibleObjects) {
+        occlusionCuller.addCandidate(i,
+                                     glm::vec3{cullingBatch.centerX[i],
+                                               cullingBatch.centerY[i],
+                                               cullingBatch.centerZ[i]},
+                                     cullingBatch.radius[i],
+                                     *gameObjects[i].model);
+    }
+    occlusionCuller.cullEarly(frameInfo.commandBuffer,
+                              frameInfo.camera.getProjectionMatrix() *
+                                  frameInfo.camera.getViewMatrix());
+}
+
+void SimpleRenderSystem::renderOcclusionCulled(
+    FrameInfo& frameInfo,
+    std::vector<LveGameObject>& gameObjects,
+    VkBuffer drawBuffer) {
+    lvePipeline->bind(frameInfo.commandBuffer);
+
+    lveDevice.counters().add(LveCounters::DESCRIPTOR_SET_BINDS);
+    vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout,
+                            0,
+                            1,
+                            &frameInfo.globalDescriptorSet,
+                            0,
+                            nullptr);
+
+    // Occluded objects still get a draw call, the GPU reads an
+    // instanceCount of 0 for them.
+    for (uint32_t i : visibleObjects) {
+        auto& obj = gameObjects[i];
+        obj.model->bind(frameInfo.commandBuffer);
+        obj.model->drawIndirect(frameInfo.commandBuffer,
+                                drawBuffer,
+                                LveOcclusionCuller::getDrawOffset(i));
+    }
+}
+
+void SimpleRenderSystem::invalidateRecordedCommands() {
+    for (auto& recorded : recordedCommands) {
+        recorded.valid = false;
     }
 }
 }  // namespace lve
@@ -1,32 +1,188 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "lve_camera.hpp"
 #include "lve_device.hpp"
+#include "lve_frame_info.hpp"
+#include "lve_frustum_culling.hpp"
 #include "lve_game_object.hpp"
+#include "lve_occlusion_culler.hpp"
 #include "lve_pipeline.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_transform_batch.hpp"
 
 namespace lve {
 class SimpleRenderSystem {
    public:
-    SimpleRenderSystem(LveDevice& device, VkRenderPass renderPass);
+    static constexpr const char* VERT_SHADER_PATH =
+        "shaders/simple_shader.vert.spv";
+    static constexpr const char* FRAG_SHADER_PATH =
+        "shaders/simple_shader.frag.spv";
+
+    // Specialization constants of simple_shader.vert; bit i is constant_id
+    // i.
+    enum ShaderOption : uint32_t {
+        // ObjectData color instead of the vertex color
+        SHADER_OPTION_OBJECT_COLOR = 1u << 0,
+        // directional light from the vertex normal
+        SHADER_OPTION_LIGHTING = 1u << 1,
+    };
+    static constexpr uint32_t SHADER_OPTION_COUNT = 2;
+
+    // Result of the last frame's frustum culling
+    struct CullingStats {
+        uint32_t visible = 0;
+        uint32_t culled = 0;
+    };
+
+    SimpleRenderSystem(LveDevice& device,
+                       LvePipelineRegistry& pipelineRegistry,
+                       const RenderTargetInfo& renderTarget,
+                       VkDescriptorSetLayout globalSetLayout);
     ~SimpleRenderSystem();
     SimpleRenderSystem(const SimpleRenderSystem&) = delete;
     SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
-    void renderGameObjects(VkCommandBuffer commandBuffer,
-                           std::vector<LveGameObject>& gameObjects,
-                           const LveCamera& camera);
+    void renderGameObjects(FrameInfo& frameInfo,
+                           std::vector<LveGameObject>& gameObjects);
+
+    // Replays draw commands recorded once into a secondary command buffer
+    // per frame in flight. Must be called inside a render pass begun with
+    // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. The commands are
+    // re-recorded only when the object list, the set of objects passing
+    // frustum culling, pipeline, render pass or extent changed; transforms
+    // still reach the GPU through the object buffer, so moving objects do
+    // not need a re-record while they stay in view.
+    void renderGameObjectsRecorded(FrameInfo& frameInfo,
+                                   std::vector<LveGameObject>& gameObjects,
+                                   VkRenderPass renderPass,
+                                   VkExtent2D extent);
+    // Two-phase occlusion culling, see LveOcclusionCuller. Call
+    // prepareOcclusionCulling after occlusionCuller.beginFrame and before
+    // the render pass, then renderOcclusionCulled once per phase with the
+    // culler's early and late draw buffer.
+    void prepareOcclusionCulling(FrameInfo& frameInfo,
+                                 std::vector<LveGameObject>& gameObjects,
+                                 LveOcclusionCuller& occlusionCuller);
+    void renderOcclusionCulled(FrameInfo& frameInfo,
+                               std::vector<LveGameObject>& gameObjects,
+                               VkBuffer drawBuffer);
+
+    // Forces every recorded command buffer to be re-recorded on next use.
+    void invalidateRecordedCommands();
+
+    // Switches to the pipeline built for the given ShaderOption bits.
+    // Variants are compiled on first use and cached; until the requested
+    // one is ready, the current one keeps being used.
+    void setShaderOptions(uint32_t options);
+    uint32_t getShaderOptions() const {
+        return activeVariant & SHADER_OPTIONS_MASK;
+    }
+    // The variants with back-face culling on and off are compiled in
+    // parallel at construction.
+    void setBackFaceCulling(bool enabled);
+    bool isBackFaceCulling() const {
+        return (activeVariant & BACK_FACE_CULLING_BIT) != 0;
+    }
+    // True while the selected variant is still compiling
+    bool isUsingFallbackPipeline() const {
+        return !pipelineVariants.at(activeVariant).isReady();
+    }
+
+    const CullingStats& getCullingStats() const { return cullingStats; }
+
+    // Rebuilds the pipelines if one of changedShaders is ours. The current
+    // pipeline is used until the active variant has been recompiled; the
+    // others are rebuilt when next selected. Call between frames; the
+    // shader library must already have dropped the old code.
+    void reloadShaders(const std::vector<std::string>& changedShaders);
 
    private:
-    void createPipelineLayout();
-    void createPipeline(VkRenderPass renderPass);
+    // ShaderOption bits, with back-face culling above them
+    using VariantKey = uint32_t;
+    static constexpr VariantKey SHADER_OPTIONS_MASK =
+        (1u << SHADER_OPTION_COUNT) - 1;
+    static constexpr VariantKey BACK_FACE_CULLING_BIT =
+        1u << SHADER_OPTION_COUNT;
+
+    // What one slot of a frame's object buffer currently holds
+    struct UploadedObject {
+        bool valid = false;
+        LveGameObject::id_t id = 0;
+        uint32_t version = 0;
+        glm::vec3 color{};
+    };
+
+    // Inputs a recorded command buffer depends on. Pipelines and models
+    // are compared by owner: a replacement can be allocated at the address
+    // of a destroyed one, whose handles the recording still holds.
+    struct RecordedCommands {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        bool valid = false;
+        std::weak_ptr<LvePipeline> pipeline{};
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkExtent2D extent{};
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        std::vector<std::pair<LveGameObject::id_t, std::weak_ptr<LveModel>>>
+            objects{};
+        std::vector<uint32_t> visibleObjects{};
+    };
+
+    bool isRecordingCurrent(const RecordedCommands& recorded,
+                            FrameInfo& frameInfo,
+                            std::vector<LveGameObject>& gameObjects,
+                            VkRenderPass renderPass,
+                            VkExtent2D extent) const;
+    void recordGameObjects(RecordedCommands& recorded,
+                           FrameInfo& frameInfo,
+                           std::vector<LveGameObject>& gameObjects,
+                           VkRenderPass renderPass,
+                           VkExtent2D extent);
+    void cullGameObjects(FrameInfo& frameInfo,
+                         std::vector<LveGameObject>& gameObjects);
+    void drawGameObjects(VkCommandBuffer commandBuffer,
+                         VkDescriptorSet globalDescriptorSet,
+                         std::vector<LveGameObject>& gameObjects);
+    void updateTransforms(std::vector<LveGameObject>& gameObjects);
+    void uploadObjects(FrameInfo& frameInfo,
+                       std::vector<LveGameObject>& gameObjects);
+    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+    LveAsyncPipeline& getPipelineVariant(VariantKey key);
+    void selectVariant(VariantKey key);
+    // Picks the pipeline used for this frame's draws
+    void selectPipeline();
 
     LveDevice& lveDevice;
+    LvePipelineRegistry& pipelineRegistry;
+    RenderTargetInfo renderTarget;
 
-    std::unique_ptr<LvePipeline> lvePipeline;
+    std::unordered_map<VariantKey, LveAsyncPipeline> pipelineVariants{};
+    VariantKey activeVariant = 0;
+    std::shared_ptr<LvePipeline> lvePipeline;
+    // Pipelines replaced by selectPipeline, with the timeline value of
+    // the last submission that may still use them
+    std::vector<std::pair<std::shared_ptr<LvePipeline>, uint64_t>>
+        retiredPipelines{};
     VkPipelineLayout pipelineLayout;
+
+    TransformBatch transformBatch{};
+    std::vector<LveGameObject*> dirtyObjects{};
+    std::vector<glm::mat4> worldMatrices{};
+
+    CullingBatch cullingBatch{};
+    // indices into the game object list that passed culling this frame
+    std::vector<uint32_t> visibleObjects{};
+    CullingStats cullingStats{};
+
+    // indexed by frame index, then by object slot
+    std::vector<std::vector<UploadedObject>> uploadedObjects{};
+
+    // indexed by frame index
+    std::vector<RecordedCommands> recordedCommands{};
 };
-}  // namespace lve
\ No newline at end of file
+}  // namespace lve
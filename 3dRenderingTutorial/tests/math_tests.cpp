@@ -0,0 +1,262 @@
+// Checks of the SIMD math kernels against their scalar reference paths.
+// They only need GLM, so `make check` runs them without a GPU or display.
+
+#include "lve_camera.hpp"
+#include "lve_frustum_culling.hpp"
+#include "lve_transform_batch.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << '\n';
+        failures++;
+    }
+}
+
+// Largest difference of two matrices, relative to the magnitude of the
+// reference so large scales and translations are not held to an absolute
+// error meant for unit vectors
+float matrixError(const glm::mat4& value, const glm::mat4& reference) {
+    float error = 0.f;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            const float difference = value[col][row] - reference[col][row];
+            const float magnitude =
+                std::max(1.f, std::abs(reference[col][row]));
+            if (std::isnan(difference)) return INFINITY;
+            error = std::max(error, std::abs(difference) / magnitude);
+        }
+    }
+    return error;
+}
+
+// Compares both SIMD entry points of batch with the scalar ones and
+// returns the largest relative error
+float compareTransforms(const lve::TransformBatch& batch,
+                        const std::string& name) {
+    // premultiplied by a perspective projection * view of the kind
+    // LveCamera builds
+    const glm::mat4 projectionView{
+        {1.2f, 0.f, 0.1f, 0.1f},
+        {0.f, -1.7f, 0.3f, 0.3f},
+        {0.2f, 0.f, 0.95f, 0.95f},
+        {-0.5f, 1.f, 2.4f, 2.5f}};
+
+    std::vector<glm::mat4> simd(batch.size());
+    std::vector<glm::mat4> scalar(batch.size());
+    float maxError = 0.f;
+
+    batch.computeWorldMatrices(simd.data());
+    batch.computeWorldMatricesScalar(scalar.data());
+    for (size_t i = 0; i < batch.size(); i++) {
+        maxError = std::max(maxError, matrixError(simd[i], scalar[i]));
+    }
+
+    batch.computeWorldMatrices(projectionView, simd.data());
+    batch.computeWorldMatricesScalar(projectionView, scalar.data());
+    for (size_t i = 0; i < batch.size(); i++) {
+        maxError = std::max(maxError, matrixError(simd[i], scalar[i]));
+    }
+
+    check(maxError <= 2e-5f,
+          name + ": max relative error " + std::to_string(maxError));
+    return maxError;
+}
+
+lve::TransformBatch randomBatch(size_t count,
+                                float maxAngle,
+                                float minScale,
+                                float maxScale,
+                                std::mt19937& random) {
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> angle{-maxAngle, maxAngle};
+    std::uniform_real_distribution<float> scale{minScale, maxScale};
+
+    lve::TransformBatch batch{};
+    batch.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        batch.push_back({position(random), position(random), position(random)},
+                        {angle(random), angle(random), angle(random)},
+                        {scale(random), scale(random), scale(random)});
+    }
+    return batch;
+}
+
+void testTransformBatch() {
+    const size_t width = lve::TransformBatch::simdWidth();
+    std::mt19937 random{27};
+
+    // every remainder length, so the scalar tail meets the SIMD blocks
+    const size_t counts[] = {
+        0, 1, width - 1, width, width + 1, 2 * width + 3, 10007};
+    for (size_t count : counts) {
+        compareTransforms(randomBatch(count, 6.3f, 0.1f, 10.f, random),
+                          "transforms, count " + std::to_string(count));
+    }
+
+    compareTransforms(randomBatch(1001, 8000.f, 0.1f, 10.f, random),
+                      "transforms, angles up to 8000 rad");
+
+    // exact multiples of pi/4 land on the octant boundaries of the range
+    // reduction
+    lve::TransformBatch octants{};
+    for (int k = -64; k <= 64; k++) {
+        const float angle = k * 0.785398163f;
+        octants.push_back({}, {angle, -angle, angle * 0.5f}, {1.f, 1.f, 1.f});
+    }
+    compareTransforms(octants, "transforms, multiples of pi/4");
+
+    lve::TransformBatch degenerate{};
+    for (int i = 0; i < 37; i++) {
+        const float angle = i * 0.37f - 7.f;
+        degenerate.push_back({1.f, -2.f, 3.f},
+                             {angle, angle * 2.f, -angle},
+                             {i % 3 == 0 ? 0.f : 1.f,
+                              i % 5 == 0 ? 0.f : -2.f,
+                              i % 2 == 0 ? -0.5f : 0.f});
+    }
+    compareTransforms(degenerate, "transforms, zero and negative scale");
+
+    compareTransforms(randomBatch(999, 6.3f, -10.f, -0.1f, random),
+                      "transforms, negative scale");
+}
+
+void testFrustumPlanes() {
+    const float aspect = 1.5f;
+    const float fovy = 0.87f;
+    const float near = 0.1f;
+    const float far = 100.f;
+    const glm::vec3 position{3.f, -2.f, 5.f};
+    lve::LveCamera camera{};
+    camera.setPerspectiveProjection(fovy, aspect, near, far);
+    camera.setViewDirection(position, {0.4f, 0.2f, -1.f});
+    const lve::Frustum frustum = camera.getFrustum();
+
+    for (int p = 0; p < lve::Frustum::PLANE_COUNT; p++) {
+        const float normalLength = glm::length(glm::vec3{frustum.planes[p]});
+        check(std::abs(normalLength - 1.f) < 1e-5f,
+              "plane " + std::to_string(p) + " is normalized");
+    }
+
+    // view space axes in world space, the rows of the view rotation
+    const glm::mat4& view = camera.getViewMatrix();
+    auto toWorld = [&](const glm::vec3& viewPoint) {
+        glm::vec3 world = position;
+        for (int axis = 0; axis < 3; axis++) {
+            const glm::vec3 axisInWorld{
+                view[0][axis], view[1][axis], view[2][axis]};
+            world += viewPoint[axis] * axisInWorld;
+        }
+        return world;
+    };
+
+    // the middle of each face in view space, where the camera looks along
+    // +z and clip x = w and clip y = w bound the sides, with the direction
+    // pointing out of the frustum there
+    const float depth = 10.f;
+    const float halfHeight = depth * std::tan(fovy / 2.f);
+    const float halfWidth = halfHeight * aspect;
+    struct Face {
+        lve::Frustum::Plane plane;
+        glm::vec3 point;
+        glm::vec3 outward;
+    };
+    const std::array<Face, lve::Frustum::PLANE_COUNT> faces{{
+        {lve::Frustum::PLANE_LEFT, {-halfWidth, 0.f, depth}, {-1.f, 0.f, 0.f}},
+        {lve::Frustum::PLANE_RIGHT, {halfWidth, 0.f, depth}, {1.f, 0.f, 0.f}},
+        {lve::Frustum::PLANE_BOTTOM,
+         {0.f, -halfHeight, depth},
+         {0.f, -1.f, 0.f}},
+        {lve::Frustum::PLANE_TOP, {0.f, halfHeight, depth}, {0.f, 1.f, 0.f}},
+        {lve::Frustum::PLANE_NEAR, {0.f, 0.f, near}, {0.f, 0.f, -1.f}},
+        {lve::Frustum::PLANE_FAR, {0.f, 0.f, far}, {0.f, 0.f, 1.f}},
+    }};
+
+    const float step = 1e-2f;
+    for (const Face& face : faces) {
+        const std::string name = "plane " + std::to_string(face.plane);
+        const glm::vec3 inside = toWorld(face.point - step * face.outward);
+        const glm::vec3 outside = toWorld(face.point + step * face.outward);
+        const glm::vec4& plane = frustum.planes[face.plane];
+
+        check(glm::dot(glm::vec3{plane}, inside) + plane.w > 0.f,
+              name + ": point just inside has a positive distance");
+        check(glm::dot(glm::vec3{plane}, outside) + plane.w < 0.f,
+              name + ": point just outside has a negative distance");
+        check(frustum.intersectsSphere(inside, 0.f),
+              name + ": point just inside is visible");
+        check(!frustum.intersectsSphere(outside, 0.f),
+              name + ": point just outside is culled");
+        check(frustum.intersectsSphere(outside, 2.f * step),
+              name + ": sphere reaching inside is visible");
+    }
+}
+
+// Compares the SIMD and scalar culling of count random spheres in and
+// around the frustum of testCullingBatch, about half of them visible
+void compareCulling(const lve::Frustum& frustum,
+                    size_t count,
+                    std::mt19937& random) {
+    std::uniform_real_distribution<float> side{-15.f, 15.f};
+    std::uniform_real_distribution<float> forward{-25.f, 35.f};
+    std::uniform_real_distribution<float> radius{0.f, 2.f};
+    lve::CullingBatch batch{};
+    batch.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        batch.push_back({side(random), side(random), forward(random)},
+                        radius(random));
+    }
+
+    std::vector<uint32_t> simd{};
+    std::vector<uint32_t> scalar{};
+    const size_t simdCount = batch.cull(frustum, simd);
+    const size_t scalarCount = batch.cullScalar(frustum, scalar);
+
+    const std::string name = "culling, count " + std::to_string(count);
+    check(simdCount == simd.size() && scalarCount == scalar.size(),
+          name + ": returned counts match the lists");
+    check(simd == scalar, name + ": SIMD and scalar visible lists match");
+}
+
+void testCullingBatch() {
+    lve::LveCamera camera{};
+    camera.setPerspectiveProjection(0.87f, 1.5f, 0.1f, 50.f);
+    camera.setViewDirection({1.f, 2.f, -20.f}, {0.1f, -0.1f, 1.f});
+    const lve::Frustum frustum = camera.getFrustum();
+
+    const size_t width = lve::CullingBatch::simdWidth();
+    std::mt19937 random{30};
+    const size_t counts[] = {0, 1, width - 1, width, width + 1, 10007};
+    for (size_t count : counts) {
+        compareCulling(frustum, count, random);
+    }
+}
+
+}  // namespace
+
+int main() {
+    testTransformBatch();
+    testFrustumPlanes();
+    testCullingBatch();
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "all checks passed (SIMD width "
+              << lve::TransformBatch::simdWidth() << ")\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+// Checks of the render graph's pass culling and transient placement, the
+// part of LveRenderGraph that needs no device (`make check`).
+
+#include "lve_render_graph_plan.hpp"
+
+// std
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << '\n';
+        failures++;
+    }
+}
+
+lve::GraphPassUse pass(std::vector<lve::GraphPassAccess> accesses,
+                       bool sideEffects = false) {
+    lve::GraphPassUse use{};
+    use.accesses = std::move(accesses);
+    use.sideEffects = sideEffects;
+    return use;
+}
+
+lve::GraphPassAccess reads(uint32_t resource) {
+    return {resource, true, false};
+}
+
+lve::GraphPassAccess writes(uint32_t resource) {
+    return {resource, false, true};
+}
+
+void testCulling() {
+    // 0 is the preserved swapchain image, 1-4 transients
+    const std::vector<bool> preserved{true, false, false, false, false};
+    const std::vector<lve::GraphPassUse> passes{
+        pass({writes(1)}),              // 0: read by 1, kept
+        pass({reads(1), writes(0)}),    // 1: writes the swapchain, kept
+        pass({writes(2)}),              // 2: only read by culled 3
+        pass({reads(2), writes(3)}),    // 3: nothing reads 3
+        pass({}, true),                 // 4: side effects, kept
+        pass({reads(1), writes(4)}),    // 5: nothing reads 4
+        pass({writes(1)}),              // 6: overwrites 1 after its reads
+    };
+    const std::vector<size_t> expected{0, 1, 4};
+    check(lve::cullGraphPasses(passes, preserved) == expected,
+          "culling keeps the passes leading to preserved writes");
+
+    // an attachment that is loaded counts as read: the clearing pass
+    // before it is kept
+    const std::vector<lve::GraphPassUse> loads{
+        pass({writes(1)}),
+        pass({{1, true, true}, reads(1), writes(0)}),
+    };
+    check(lve::cullGraphPasses(loads, preserved).size() == 2,
+          "culling keeps writes a loading pass reads");
+
+    check(lve::cullGraphPasses({}, preserved).empty(),
+          "culling an empty frame");
+}
+
+lve::TransientPlacement transient(uint32_t resource,
+                                  uint64_t size,
+                                  uint64_t alignment,
+                                  int firstUse,
+                                  int lastUse,
+                                  uint32_t heap = 0) {
+    lve::TransientPlacement placement{};
+    placement.resource = resource;
+    placement.size = size;
+    placement.alignment = alignment;
+    placement.heap = heap;
+    placement.firstUse = firstUse;
+    placement.lastUse = lastUse;
+    return placement;
+}
+
+const lve::TransientPlacement& find(
+    const std::vector<lve::TransientPlacement>& placements,
+    uint32_t resource) {
+    for (const auto& placement : placements) {
+        if (placement.resource == resource) return placement;
+    }
+    std::cerr << "no placement of resource " << resource << '\n';
+    std::exit(EXIT_FAILURE);
+}
+
+void testPlacement() {
+    // a chain of passes, each reading what the one before wrote: the first
+    // and third transient never live together
+    std::vector<lve::TransientPlacement> chain{
+        transient(0, 4096, 256, 0, 1),
+        transient(1, 1000, 256, 1, 2),
+        transient(2, 2048, 256, 2, 3),
+    };
+    auto heapSizes = lve::placeTransients(chain);
+    const auto& first = find(chain, 0);
+    const auto& second = find(chain, 1);
+    const auto& third = find(chain, 2);
+    check(first.offset == 0, "chain: largest at offset 0");
+    check(third.offset == 0, "chain: third aliases the first");
+    check(second.offset == 4096, "chain: second after the first");
+    check(heapSizes.size() == 1 && heapSizes[0] == 5096,
+          "chain: heap as large as the highest placement");
+    check(lve::reusesMemory(first, third), "chain: third reuses the first");
+    check(!lve::reusesMemory(third, first) &&
+              !lve::reusesMemory(first, second),
+          "chain: no reuse of live or later memory");
+
+    // alignment pushes a placement past the end of the one before
+    std::vector<lve::TransientPlacement> aligned{
+        transient(0, 1000, 4, 0, 2),
+        transient(1, 500, 256, 0, 2),
+    };
+    lve::placeTransients(aligned);
+    check(find(aligned, 1).offset == 1024, "aligned: rounded up to 256");
+
+    // different heaps never share memory, whatever the lifetimes
+    std::vector<lve::TransientPlacement> heaps{
+        transient(0, 4096, 256, 0, 0, 0),
+        transient(1, 4096, 256, 1, 1, 1),
+    };
+    heapSizes = lve::placeTransients(heaps);
+    check(heapSizes.size() == 2 && heapSizes[0] == 4096 &&
+              heapSizes[1] == 4096,
+          "heaps: one allocation each");
+    check(!lve::reusesMemory(find(heaps, 0), find(heaps, 1)),
+          "heaps: no reuse across heaps");
+}
+
+void testRandomPlacement() {
+    std::mt19937 random{46};
+    std::uniform_int_distribution<uint64_t> size{1, 1 << 20};
+    std::uniform_int_distribution<int> alignmentShift{0, 12};
+    std::uniform_int_distribution<int> use{0, 15};
+    std::uniform_int_distribution<uint32_t> heap{0, 2};
+
+    for (int round = 0; round < 200; round++) {
+        std::vector<lve::TransientPlacement> placements;
+        for (uint32_t i = 0; i < 24; i++) {
+            const int a = use(random);
+            const int b = use(random);
+            placements.push_back(transient(i,
+                                           size(random),
+                                           1ull << alignmentShift(random),
+                                           std::min(a, b),
+                                           std::max(a, b),
+                                           heap(random)));
+        }
+        const auto heapSizes = lve::placeTransients(placements);
+
+        const std::string name = "random round " + std::to_string(round);
+        std::vector<uint64_t> highest(heapSizes.size());
+        for (size_t i = 0; i < placements.size(); i++) {
+            const auto& a = placements[i];
+            check(a.offset % a.alignment == 0, name + ": aligned offset");
+            check(a.heap < heapSizes.size(), name + ": heap has a size");
+            if (a.heap >= heapSizes.size()) continue;
+            highest[a.heap] = std::max(highest[a.heap], a.offset + a.size);
+            for (size_t j = i + 1; j < placements.size(); j++) {
+                const auto& b = placements[j];
+                const bool live =
+                    a.firstUse <= b.lastUse && b.firstUse <= a.lastUse;
+                const bool shared = a.heap == b.heap &&
+                                    a.offset < b.offset + b.size &&
+                                    b.offset < a.offset + a.size;
+                check(!(live && shared),
+                      name + ": resources alive together do not overlap");
+                check(lve::reusesMemory(a, b) ==
+                          (shared && a.lastUse < b.firstUse),
+                      name + ": reuse means shared memory, used after");
+            }
+        }
+        check(highest == heapSizes,
+              name + ": heaps as large as their highest placement");
+    }
+}
+
+}  // namespace
+
+int main() {
+    testCulling();
+    testPlacement();
+    testRandomPlacement();
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "all render graph checks passed\n";
+    return EXIT_SUCCESS;
+}
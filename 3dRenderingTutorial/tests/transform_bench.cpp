@@ -0,0 +1,100 @@
+// Objects per millisecond of the world matrix paths, built with the same
+// flags as the app (`make bench`, `make bench AVX2=1`). Needs no GPU.
+
+#include "lve_game_object.hpp"
+#include "lve_transform_batch.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t OBJECT_COUNT = 10007;
+constexpr int ROUNDS = 200;
+
+// Best objects/ms of ROUNDS runs of work over OBJECT_COUNT objects
+template <typename Work>
+double objectsPerMillisecond(Work work) {
+    double best = 0.0;
+    for (int round = 0; round < ROUNDS; round++) {
+        const auto begin = std::chrono::steady_clock::now();
+        work(round);
+        const auto end = std::chrono::steady_clock::now();
+        const double milliseconds =
+            std::chrono::duration<double, std::milli>(end - begin).count();
+        best = std::max(best, OBJECT_COUNT / milliseconds);
+    }
+    return best;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 random{27};
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> angle{-6.3f, 6.3f};
+    std::uniform_real_distribution<float> scale{0.1f, 10.f};
+
+    std::vector<lve::LveGameObject> objects;
+    lve::TransformBatch batch{};
+    objects.reserve(OBJECT_COUNT);
+    batch.reserve(OBJECT_COUNT);
+    for (size_t i = 0; i < OBJECT_COUNT; i++) {
+        const glm::vec3 translation{
+            position(random), position(random), position(random)};
+        const glm::vec3 rotation{angle(random), angle(random), angle(random)};
+        const glm::vec3 objectScale{
+            scale(random), scale(random), scale(random)};
+        auto object = lve::LveGameObject::createGameObject();
+        object.transform.setTranslation(translation);
+        object.transform.setRotation(rotation);
+        object.transform.setScale(objectScale);
+        objects.push_back(std::move(object));
+        batch.push_back(translation, rotation, objectScale);
+    }
+
+    const glm::mat4 projectionView{
+        {1.2f, 0.f, 0.1f, 0.1f},
+        {0.f, -1.7f, 0.3f, 0.3f},
+        {0.2f, 0.f, 0.95f, 0.95f},
+        {-0.5f, 1.f, 2.4f, 2.5f}};
+    std::vector<glm::mat4> out(OBJECT_COUNT);
+    float sink = 0.f;
+
+    // every object moved since the last frame, so mat4() rebuilds its
+    // cached matrices each round
+    const double perObject = objectsPerMillisecond([&](int round) {
+        const float offset = (round & 1) ? 1e-3f : -1e-3f;
+        for (size_t i = 0; i < OBJECT_COUNT; i++) {
+            auto& transform = objects[i].transform;
+            glm::vec3 rotation = transform.getRotation();
+            rotation.y += offset;
+            transform.setRotation(rotation);
+            out[i] = projectionView * transform.mat4();
+        }
+        sink += out[OBJECT_COUNT - 1][3][0];
+    });
+    const double scalar = objectsPerMillisecond([&](int) {
+        batch.computeWorldMatricesScalar(projectionView, out.data());
+        sink += out[OBJECT_COUNT - 1][3][0];
+    });
+    const double simd = objectsPerMillisecond([&](int) {
+        batch.computeWorldMatrices(projectionView, out.data());
+        sink += out[OBJECT_COUNT - 1][3][0];
+    });
+
+    std::printf("projectionView * world of %zu objects, objects/ms:\n",
+                OBJECT_COUNT);
+    std::printf("  per-object mat4():            %8.0f\n", perObject);
+    std::printf("  TransformBatch scalar:        %8.0f\n", scalar);
+    std::printf("  TransformBatch SIMD width %d:  %8.0f (%.1fx per-object)\n",
+                lve::TransformBatch::simdWidth(),
+                simd,
+                simd / perObject);
+    // keeps the results from being optimized away
+    return sink == 12345.f ? 1 : 0;
+}